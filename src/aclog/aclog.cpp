@@ -0,0 +1,84 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <util/log.h>
+#include <httpd/access_log.h>
+
+using namespace minerva;
+
+static void print_usage()
+{
+    fprintf(stderr,
+            "usage: aclog [--format text|json|csv] FILE...\n"
+            "Decodes binary access logs written by httpd::access_log_file().\n"
+            "Files are printed in the order given; pass rotated files oldest\n"
+            "first (access.bin.2 access.bin.1 access.bin) for time order.\n");
+}
+
+int main(int argc, char ** argv)
+{
+    access_log::FORMAT fmt = access_log::TEXT;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+        {
+            const char * f = argv[++i];
+            if (std::strcmp(f, "text") == 0)
+            {
+                fmt = access_log::TEXT;
+            }
+            else if (std::strcmp(f, "json") == 0)
+            {
+                fmt = access_log::JSON;
+            }
+            else if (std::strcmp(f, "csv") == 0)
+            {
+                fmt = access_log::CSV;
+            }
+            else
+            {
+                print_usage();
+                return 1;
+            }
+        }
+        else if (argv[i][0] == '-')
+        {
+            print_usage();
+            return 1;
+        }
+        else
+        {
+            files.push_back(argv[i]);
+        }
+    }
+
+    if (files.empty())
+    {
+        print_usage();
+        return 1;
+    }
+
+    int rc = 0;
+    for (auto & file : files)
+    {
+        std::ifstream is(file, std::ios::binary);
+        if (!is)
+        {
+            LOG_ERROR("cannot open " << file);
+            rc = 1;
+            continue;
+        }
+        if (!access_log::decode(is, std::cout, fmt))
+        {
+            LOG_ERROR("failed to decode " << file);
+            rc = 1;
+        }
+    }
+    return rc;
+}
@@ -1,9 +1,17 @@
 #include <stdio.h>
+#include <algorithm>
+#include <vector>
 #include <cerrno>
 #include <cctype>
 #include <fstream>
 #include <sstream>
+#include <system_error>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <openssl/crypto.h>
+#include <util/file_lock.h>
 #include <util/safe_ofstream.h>
 #include <util/log.h>
 #include "auth_db.h"
@@ -27,12 +35,116 @@ namespace minerva
         s.clear();
     }
 
-    bool auth_db::initialize()
+    static bool is_hex(const std::string & s)
+    {
+        for (char c : s)
+        {
+            if (!std::isxdigit(static_cast<unsigned char>(c)))
+                return false;
+        }
+        return !s.empty();
+    }
+
+    static bool fsync_dir_of(const std::string & path)
+    {
+        const auto slash = path.find_last_of('/');
+        const std::string dir = slash == std::string::npos ? "." :
+                                slash == 0 ? "/" : path.substr(0, slash);
+        const int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return false;
+        }
+        const bool ok = ::fsync(fd) == 0;
+        ::close(fd);
+        return ok;
+    }
+
+    // One journal line: "+" and the webpass format for a set, "-user" for
+    // a delete.
+    static std::string journal_set_record(const minerva::http_auth_user & u)
+    {
+        return "+" + u.user() + ":" + u.realm() + ":" + u.hash_md5() + ":" +
+               u.hash_sha256() + "\n";
+    }
+
+    bool auth_db::parse_user(const std::string & line,
+                             const std::string & file, size_t lineno,
+                             minerva::http_auth_user & entry) const
+    {
+        // Supported on-disk formats:
+        //   user:realm:md5hex                 (legacy, MD5 only)
+        //   user:realm:md5hex:sha256hex       (current; either hash may
+        //                                      be empty, but not both)
+        std::stringstream ss(line);
+        std::string user;
+        std::string realm;
+        std::string md5_hash;
+        std::string sha256_hash;
+        if (!std::getline(ss, user, ':') ||
+            !std::getline(ss, realm, ':') ||
+            !std::getline(ss, md5_hash, ':'))
+        {
+            LOG_ERROR("invalid webpass db " << file
+                      << " at line " << lineno);
+            return false;
+        }
+        // Optional 4th column: SHA-256 hash.
+        std::getline(ss, sha256_hash);
+
+        if (user.empty() || realm.empty())
+        {
+            LOG_ERROR("empty user/realm in webpass db " << file
+                      << " at line " << lineno);
+            return false;
+        }
+        if (md5_hash.empty() && sha256_hash.empty())
+        {
+            LOG_ERROR("user '" << user
+                      << "' has no hash in webpass db " << file
+                      << " at line " << lineno);
+            return false;
+        }
+        if (!md5_hash.empty() && !is_hex(md5_hash))
+        {
+            LOG_ERROR("non-hex MD5 hash in webpass db " << file
+                      << " at line " << lineno);
+            return false;
+        }
+        if (!sha256_hash.empty() && !is_hex(sha256_hash))
+        {
+            LOG_ERROR("non-hex SHA-256 hash in webpass db " << file
+                      << " at line " << lineno);
+            return false;
+        }
+        // Sanity: enforce expected hash lengths if present.
+        if (!md5_hash.empty() && md5_hash.size() != 32)
+        {
+            LOG_ERROR("MD5 hash wrong length in webpass db " << file
+                      << " at line " << lineno);
+            return false;
+        }
+        if (!sha256_hash.empty() && sha256_hash.size() != 64)
+        {
+            LOG_ERROR("SHA-256 hash wrong length in webpass db "
+                      << file << " at line " << lineno);
+            return false;
+        }
+        if (realm != http_auth_db::realm())
+        {
+            LOG_WARN("user '" << user << "' has realm '" << realm
+                     << "' which differs from db realm '"
+                     << http_auth_db::realm()
+                     << "'; this user will not authenticate via digest");
+        }
+
+        entry = minerva::http_auth_user(user, realm, md5_hash, sha256_hash);
+        return true;
+    }
+
+    bool auth_db::load(user_table & table, size_t & journal_records) const
     {
-        // Load into a temporary map first; only swap into m_user_map on
-        // full success so a partial/corrupt file does not destroy the live
-        // credential database.
-        std::map<std::string, minerva::http_auth_user> staged;
+        journal_records = 0;
 
         std::ifstream is(m_webpass);
         if (!is.is_open())
@@ -41,29 +153,16 @@ namespace minerva
             // (e.g. the shield CLI) can bootstrap the very first user
             // without having to pre-create the file.  Any other open
             // failure (permissions, EIO, ...) is still fatal.
-            if (errno == ENOENT)
+            if (errno != ENOENT)
             {
-                LOG_INFO("auth db " << m_webpass
-                         << " does not exist; starting empty");
-                m_initialized.store(true, std::memory_order_release);
-                return true;
+                LOG_WARN("failed to open auth db " << m_webpass);
+                return false;
             }
-            LOG_WARN("failed to open auth db " << m_webpass);
-            return false;
         }
 
-        auto is_hex = [](const std::string & s) {
-            for (char c : s)
-            {
-                if (!std::isxdigit(static_cast<unsigned char>(c)))
-                    return false;
-            }
-            return !s.empty();
-        };
-
         std::string line;
         size_t lineno = 0;
-        while (std::getline(is, line))
+        while (is.is_open() && std::getline(is, line))
         {
             ++lineno;
 
@@ -77,80 +176,100 @@ namespace minerva
                 continue;
             }
 
-            // Supported on-disk formats:
-            //   user:realm:md5hex                 (legacy, MD5 only)
-            //   user:realm:md5hex:sha256hex       (current; either hash may
-            //                                      be empty, but not both)
-            std::stringstream ss(line);
-            std::string user;
-            std::string realm;
-            std::string md5_hash;
-            std::string sha256_hash;
-            if (!std::getline(ss, user, ':') ||
-                !std::getline(ss, realm, ':') ||
-                !std::getline(ss, md5_hash, ':'))
+            minerva::http_auth_user entry;
+            if (!parse_user(line, m_webpass, lineno, entry))
             {
-                LOG_ERROR("invalid webpass db " << m_webpass
-                          << " at line " << lineno);
                 return false;
             }
-            // Optional 4th column: SHA-256 hash.
-            std::getline(ss, sha256_hash);
+            table[entry.user()] = entry;
+        }
 
-            if (user.empty() || realm.empty())
-            {
-                LOG_ERROR("empty user/realm in webpass db " << m_webpass
-                          << " at line " << lineno);
-                return false;
-            }
-            if (md5_hash.empty() && sha256_hash.empty())
+        // Replay the journal over the file.  Its records are complete
+        // lines: a final line without a newline is a write torn by a
+        // crash, and writers start a fresh line after one, so a bad record
+        // is skipped rather than failing the whole load.
+        std::ifstream js(m_journal);
+        lineno = 0;
+        while (js.is_open() && std::getline(js, line))
+        {
+            ++lineno;
+            ++journal_records;
+            if (js.eof())
             {
-                LOG_ERROR("user '" << user
-                          << "' has no hash in webpass db " << m_webpass
-                          << " at line " << lineno);
-                return false;
+                LOG_WARN("ignoring incomplete record at line " << lineno
+                         << " of auth db journal " << m_journal);
+                break;
             }
-            if (!md5_hash.empty() && !is_hex(md5_hash))
+
+            minerva::http_auth_user entry;
+            if (line.size() > 1 && line[0] == '+' &&
+                parse_user(line.substr(1), m_journal, lineno, entry))
             {
-                LOG_ERROR("non-hex MD5 hash in webpass db " << m_webpass
-                          << " at line " << lineno);
-                return false;
+                table[entry.user()] = entry;
             }
-            if (!sha256_hash.empty() && !is_hex(sha256_hash))
+            else if (line.size() > 1 && line[0] == '-')
             {
-                LOG_ERROR("non-hex SHA-256 hash in webpass db " << m_webpass
-                          << " at line " << lineno);
-                return false;
+                table.erase(line.substr(1));
             }
-            // Sanity: enforce expected hash lengths if present.
-            if (!md5_hash.empty() && md5_hash.size() != 32)
+            else
             {
-                LOG_ERROR("MD5 hash wrong length in webpass db " << m_webpass
-                          << " at line " << lineno);
-                return false;
+                LOG_WARN("ignoring bad record at line " << lineno
+                         << " of auth db journal " << m_journal);
             }
-            if (!sha256_hash.empty() && sha256_hash.size() != 64)
+        }
+        secure_zero(line);
+
+        if (!is.is_open() && journal_records == 0)
+        {
+            LOG_INFO("auth db " << m_webpass
+                     << " does not exist; starting empty");
+        }
+        return true;
+    }
+
+    bool auth_db::initialize()
+    {
+        // Load into a new table first; only publish it on full success so
+        // a partial/corrupt file does not destroy the live credential
+        // database.
+        auto staged = std::make_shared<user_table>();
+        size_t journal_records = 0;
+
+        // Another process compacting between the reads of the file and
+        // the journal would hand us the old file and an empty journal;
+        // the journal lock keeps the pair consistent.
+        std::unique_ptr<minerva::file_lock> journal_lock;
+        try
+        {
+            journal_lock.reset(new minerva::file_lock(m_journal,
+                                                      O_RDONLY | O_CLOEXEC, 0));
+            journal_lock->lock();
+        }
+        catch (const std::system_error & e)
+        {
+            if (e.code().value() != ENOENT)
             {
-                LOG_ERROR("SHA-256 hash wrong length in webpass db "
-                          << m_webpass << " at line " << lineno);
+                LOG_ERROR("failed to lock auth db journal: " << e.what());
                 return false;
             }
-            if (realm != http_auth_db::realm())
-            {
-                LOG_WARN("user '" << user << "' has realm '" << realm
-                         << "' which differs from db realm '"
-                         << http_auth_db::realm()
-                         << "'; this user will not authenticate via digest");
-            }
+            journal_lock.reset();
+        }
 
-            staged[user] = minerva::http_auth_user(user, realm,
-                                                   md5_hash, sha256_hash);
+        const bool ok = load(*staged, journal_records);
+        if (journal_lock)
+        {
+            journal_lock->unlock();
+        }
+        if (!ok)
+        {
+            return false;
         }
 
-        // Atomically swap in the new map.
+        // Publish the new table; lookups in flight finish on the old one.
         {
-            std::unique_lock<std::mutex> lk(m_lock);
-            m_user_map.swap(staged);
+            std::unique_lock<minerva::instrumented_mutex> lk(m_lock);
+            m_journal_records = journal_records;
+            publish_locked(std::move(staged));
         }
         m_initialized.store(true, std::memory_order_release);
 
@@ -166,10 +285,9 @@ namespace minerva
             return false;
         }
 
-        std::unique_lock<std::mutex> lk(m_lock);
-
-        auto it = m_user_map.find(username);
-        if (it != m_user_map.end())
+        const auto table = users();
+        auto it = table->find(username);
+        if (it != table->end())
         {
             user = it->second;
             return true;
@@ -177,7 +295,33 @@ namespace minerva
         return false;
     }
 
-    bool auth_db::write_map_locked() const
+    std::shared_ptr<const minerva::http_auth_user>
+    auth_db::lookup_user(const std::string & username)
+    {
+        if (!m_initialized.load(std::memory_order_acquire))
+        {
+            LOG_WARN("auth_db::lookup_user called before initialize()");
+            return nullptr;
+        }
+
+        auto table = users();
+        auto it = table->find(username);
+        if (it == table->end())
+        {
+            return nullptr;
+        }
+        return std::shared_ptr<const minerva::http_auth_user>(std::move(table),
+                                                              &it->second);
+    }
+
+    void auth_db::publish_locked(std::shared_ptr<const user_table> users)
+    {
+        std::atomic_store_explicit(&m_users, std::move(users),
+                                   std::memory_order_release);
+        bump_generation();
+    }
+
+    bool auth_db::write_map_locked(const user_table & users) const
     {
         minerva::safe_ofstream os(m_webpass);
 
@@ -187,8 +331,21 @@ namespace minerva
             return false;
         }
 
-        for (auto & x : m_user_map)
+        // Keep the file sorted by user, as it was when the table was a
+        // std::map.
+        std::vector<const user_table::value_type *> sorted;
+        sorted.reserve(users.size());
+        for (auto & x : users)
+        {
+            sorted.push_back(&x);
+        }
+        std::sort(sorted.begin(), sorted.end(), [](auto * a, auto * b) {
+            return a->first < b->first;
+        });
+
+        for (auto * entry : sorted)
         {
+            auto & x = *entry;
             // Defense in depth: refuse to serialize entries that would
             // corrupt the on-disk colon-delimited format.
             if (contains_separator(x.second.user()) ||
@@ -205,7 +362,7 @@ namespace minerva
             // both -- initialize() rejects that on read.
             os << x.second.user() << ":" << x.second.realm() << ":"
                << x.second.hash_md5() << ":" << x.second.hash_sha256()
-               << std::endl;
+               << '\n';
         }
 
         if (!os.commit())
@@ -217,6 +374,171 @@ namespace minerva
         return true;
     }
 
+    bool auth_db::append_journal_locked(std::string & records)
+    {
+        struct stat st;
+        const bool created = ::stat(m_journal.c_str(), &st) != 0;
+
+        bool ok = false;
+        try
+        {
+            minerva::file_lock journal_lock(m_journal,
+                                            O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+            minerva::file_lock_guard<minerva::file_lock> guard(journal_lock);
+
+            const int fd = ::open(m_journal.c_str(),
+                                  O_RDWR | O_APPEND | O_CLOEXEC);
+            if (fd < 0)
+            {
+                LOG_ERROR_ERRNO("failed to open auth db journal " << m_journal,
+                                errno);
+                secure_zero(records);
+                return false;
+            }
+
+            // A crash mid-append leaves a partial last line; start after it
+            // so the reader drops only that fragment.
+            char last = '\n';
+            off_t start = -1;
+            if (::fstat(fd, &st) == 0)
+            {
+                start = st.st_size;
+            }
+            if (start > 0 &&
+                ::pread(fd, &last, 1, start - 1) == 1 && last != '\n')
+            {
+                records.insert(0, 1, '\n');
+            }
+
+            ok = true;
+            size_t done = 0;
+            while (done < records.size())
+            {
+                const ssize_t n = ::write(fd, records.data() + done,
+                                          records.size() - done);
+                if (n < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (n <= 0)
+                {
+                    LOG_ERROR_ERRNO("failed to append to auth db journal "
+                                    << m_journal, errno);
+                    ok = false;
+                    break;
+                }
+                done += static_cast<size_t>(n);
+            }
+            // One fsync for the whole batch.
+            if (ok && ::fsync(fd) != 0)
+            {
+                LOG_ERROR_ERRNO("failed to sync auth db journal " << m_journal,
+                                errno);
+                ok = false;
+            }
+            // The caller reports failure and keeps the old table, so whole
+            // records that did reach the file must not replay on restart.
+            if (!ok && start >= 0 && ::ftruncate(fd, start) != 0)
+            {
+                LOG_ERROR_ERRNO("failed to roll back auth db journal "
+                                << m_journal, errno);
+            }
+            ::close(fd);
+            if (ok && created && !fsync_dir_of(m_journal))
+            {
+                LOG_WARN("failed to sync the directory of " << m_journal);
+            }
+        }
+        catch (const std::system_error & e)
+        {
+            LOG_ERROR("auth db journal: " << e.what());
+            ok = false;
+        }
+        secure_zero(records);
+        return ok;
+    }
+
+    bool auth_db::compact_locked(std::shared_ptr<const user_table> table)
+    {
+        try
+        {
+            minerva::file_lock journal_lock(m_journal,
+                                            O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+            minerva::file_lock_guard<minerva::file_lock> guard(journal_lock);
+
+            // Fold in what is on disk, not what this process holds: another
+            // process may have appended since we loaded.
+            const bool reloaded = !table;
+            if (reloaded)
+            {
+                auto loaded = std::make_shared<user_table>();
+                size_t records = 0;
+                if (!load(*loaded, records))
+                {
+                    return false;
+                }
+                table = std::move(loaded);
+            }
+
+            // The file is replaced before the journal is emptied, so a crash
+            // in between only replays changes the file already holds.
+            if (!write_map_locked(*table))
+            {
+                return false;
+            }
+            if (::truncate(m_journal.c_str(), 0) != 0)
+            {
+                LOG_ERROR_ERRNO("failed to truncate auth db journal "
+                                << m_journal, errno);
+                return false;
+            }
+            m_journal_records = 0;
+            if (reloaded)
+            {
+                publish_locked(std::move(table));
+            }
+        }
+        catch (const std::system_error & e)
+        {
+            LOG_ERROR("auth db journal: " << e.what());
+            return false;
+        }
+        return true;
+    }
+
+    bool auth_db::commit_locked(std::string & records, size_t count,
+                                std::shared_ptr<const user_table> next)
+    {
+        // Publish only what the journal holds: a change served from memory
+        // but lost on restart would silently revert.
+        if (!append_journal_locked(records))
+        {
+            return false;
+        }
+        publish_locked(std::move(next));
+
+        m_journal_records += count;
+        if (m_journal_records >= COMPACT_RECORDS && !compact_locked(nullptr))
+        {
+            // The changes are durable in the journal; compaction is retried
+            // on the next write.
+            LOG_WARN("failed to compact auth db " << m_webpass);
+        }
+        return true;
+    }
+
+    bool auth_db::compact()
+    {
+        if (!m_initialized.load(std::memory_order_acquire))
+        {
+            LOG_ERROR("auth_db::compact called before initialize()");
+            return false;
+        }
+
+        std::unique_lock<minerva::instrumented_mutex> lk(m_lock);
+        return compact_locked(nullptr);
+    }
+
     bool auth_db::set_user(const std::string & username,
                            const std::string & realm,
                            const std::string & password)
@@ -254,18 +576,115 @@ namespace minerva
             minerva::digest_hash_md5(username, realm, password);
         std::string sha256_hash =
             minerva::digest_hash_sha256(username, realm, password);
+        const minerva::http_auth_user entry(username, realm,
+                                            md5_hash, sha256_hash);
+        // The credential-equivalent hashes should not linger in memory.
+        secure_zero(md5_hash);
+        secure_zero(sha256_hash);
+
+        std::string record = journal_set_record(entry);
 
         bool ok = false;
         {
-            std::unique_lock<std::mutex> lk(m_lock);
-            m_user_map[username] = minerva::http_auth_user(username, realm,
-                                                           md5_hash,
-                                                           sha256_hash);
-            ok = write_map_locked();
+            std::unique_lock<minerva::instrumented_mutex> lk(m_lock);
+            auto next = std::make_shared<user_table>(*users());
+            (*next)[username] = entry;
+            ok = commit_locked(record, 1, std::move(next));
+        }
+
+        if (!ok)
+        {
+            LOG_ERROR("failed to write web user db");
+            return false;
+        }
+        return true;
+    }
+
+    bool auth_db::set_users(const std::vector<credentials> & batch,
+                            const std::string & realm,
+                            unsigned threads)
+    {
+        if (!m_initialized.load(std::memory_order_acquire))
+        {
+            LOG_ERROR("auth_db::set_users called before initialize()");
+            return false;
+        }
+
+        if (realm.empty() || contains_separator(realm))
+        {
+            LOG_ERROR("auth_db::set_users requires a non-empty realm "
+                      "without colon/CR/LF/NUL");
+            return false;
+        }
+        for (const auto & c : batch)
+        {
+            if (c.username.empty() || contains_separator(c.username))
+            {
+                LOG_ERROR("auth_db::set_users rejected empty username or "
+                          "colon/CR/LF/NUL in username '" << c.username << "'");
+                return false;
+            }
+        }
+        if (batch.empty())
+        {
+            return true;
+        }
+        if (realm != http_auth_db::realm())
+        {
+            LOG_WARN("auth_db::set_users realm '" << realm
+                     << "' differs from db realm '" << http_auth_db::realm()
+                     << "'; these users will not authenticate via digest");
+        }
+
+        // Hashing dominates a bulk import; spread it over the cores.
+        // Each worker claims the next index until the batch runs out.
+        std::vector<minerva::http_auth_user> entries(batch.size());
+        std::atomic<size_t> next_index{0};
+        auto hash_users = [&]() {
+            for (size_t i = next_index++; i < batch.size(); i = next_index++)
+            {
+                std::string md5_hash = minerva::digest_hash_md5(
+                    batch[i].username, realm, batch[i].password);
+                std::string sha256_hash = minerva::digest_hash_sha256(
+                    batch[i].username, realm, batch[i].password);
+                entries[i] = minerva::http_auth_user(batch[i].username, realm,
+                                                     md5_hash, sha256_hash);
+                secure_zero(md5_hash);
+                secure_zero(sha256_hash);
+            }
+        };
+        if (threads == 0)
+        {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        threads = static_cast<unsigned>(std::min<size_t>(threads, batch.size()));
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; ++t)
+        {
+            workers.emplace_back(hash_users);
+        }
+        hash_users();
+        for (auto & w : workers)
+        {
+            w.join();
+        }
+
+        std::string records;
+        for (const auto & entry : entries)
+        {
+            records += journal_set_record(entry);
+        }
+
+        bool ok = false;
+        {
+            std::unique_lock<minerva::instrumented_mutex> lk(m_lock);
+            auto next = std::make_shared<user_table>(*users());
+            for (auto & entry : entries)
+            {
+                (*next)[entry.user()] = std::move(entry);
+            }
+            ok = commit_locked(records, batch.size(), std::move(next));
         }
-        // The credential-equivalent hashes should not linger in memory.
-        secure_zero(md5_hash);
-        secure_zero(sha256_hash);
 
         if (!ok)
         {
@@ -283,17 +702,19 @@ namespace minerva
             return false;
         }
 
-        std::unique_lock<std::mutex> lk(m_lock);
+        std::unique_lock<minerva::instrumented_mutex> lk(m_lock);
 
-        auto it = m_user_map.find(username);
-        if (it == m_user_map.end())
+        const auto current = users();
+        if (current->find(username) == current->end())
         {
             return true;
         }
 
-        m_user_map.erase(it);
+        auto next = std::make_shared<user_table>(*current);
+        next->erase(username);
+        std::string record = "-" + username + "\n";
 
-        if (!write_map_locked())
+        if (!commit_locked(record, 1, std::move(next)))
         {
             LOG_ERROR("failed to write web user db");
             return false;
@@ -310,15 +731,15 @@ namespace minerva
             return false;
         }
 
-        std::unique_lock<std::mutex> lk(m_lock);
-
-        m_user_map.clear();
+        std::unique_lock<minerva::instrumented_mutex> lk(m_lock);
 
-        if (!write_map_locked())
+        auto next = std::make_shared<const user_table>();
+        if (!compact_locked(next))
         {
             LOG_ERROR("failed to write web user db");
             return false;
         }
+        publish_locked(std::move(next));
 
         return true;
     }
@@ -3,18 +3,39 @@
 #include <string>
 #include <mutex>
 #include <atomic>
-#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <util/instrumented_mutex.h>
 #include <httpd/http_auth.h>
 
 namespace minerva
 {
+    // User table kept in a webpass file plus an append-only journal of
+    // later changes (<webpass>.journal).  Each write appends its records
+    // and fsyncs the journal once; after COMPACT_RECORDS records (and on
+    // clear()) the journal is folded into a rewritten webpass file.
+    // initialize() reads the file and replays the journal.  A flock on
+    // the journal keeps processes sharing the files consistent.
     class auth_db : public minerva::http_auth_db
     {
     public:
+        static constexpr size_t COMPACT_RECORDS = 256;
+
+        struct credentials
+        {
+            std::string username;
+            std::string password;
+        };
+
         auth_db(const std::string & realm,
                 const std::string & webpass) :
-            minerva::http_auth_db(realm), m_webpass(webpass)
+            minerva::http_auth_db(realm),
+            m_users(std::make_shared<const user_table>()),
+            m_webpass(webpass),
+            m_journal(webpass + ".journal")
         {
+            minerva::name_lock(m_lock, "auth_db");
         }
         
         ~auth_db() = default;
@@ -25,20 +46,82 @@ namespace minerva
                       const std::string & realm,
                       const std::string & password);
 
+        // Adds or replaces every user in batch as a single journal append.
+        // The hashes are computed on up to threads threads (0: one per
+        // core).  Nothing is written if any username is invalid.
+        bool set_users(const std::vector<credentials> & batch,
+                       const std::string & realm,
+                       unsigned threads = 0);
+
         bool delete_user(const std::string & username);
 
         bool clear();
 
+        // Folds the journal into the webpass file now.
+        bool compact();
+
+        const std::string & journal_path() const
+        {
+            return m_journal;
+        }
+
         bool find_user(const std::string & username,
                        minerva::http_auth_user & user) override;
 
+        // Aliases the entry in the current snapshot, which stays alive for
+        // as long as the returned pointer does.
+        std::shared_ptr<const minerva::http_auth_user>
+        lookup_user(const std::string & username) override;
+
     private:
-        std::map<std::string, minerva::http_auth_user> m_user_map;
-        mutable std::mutex m_lock;
+        typedef std::unordered_map<std::string, minerva::http_auth_user> user_table;
+
+        // The published user table. It is never modified once published:
+        // readers take a reference with std::atomic_load, writers copy it,
+        // change the copy and std::atomic_store it. libstdc++ guards those
+        // two calls with a striped mutex held only for the pointer and
+        // refcount update, so a reload or a writer never holds readers up
+        // for longer than that.
+        std::shared_ptr<const user_table> m_users;
+        // Serializes writers (and the webpass file) only.
+        mutable minerva::instrumented_mutex m_lock;
         std::atomic<bool> m_initialized{false};
         std::string m_webpass;
+        std::string m_journal;
+        // Journal records since the last compaction, as far as this
+        // process knows.  Guarded by m_lock.
+        size_t m_journal_records = 0;
+
+        std::shared_ptr<const user_table> users() const
+        {
+            return std::atomic_load_explicit(&m_users, std::memory_order_acquire);
+        }
+
+        // Caller must hold m_lock.
+        void publish_locked(std::shared_ptr<const user_table> users);
+
+        // Reads the webpass file and replays the journal over it.  The
+        // caller holds the journal lock if the journal exists.
+        bool load(user_table & table, size_t & journal_records) const;
+
+        bool parse_user(const std::string & line, const std::string & file,
+                        size_t lineno, minerva::http_auth_user & entry) const;
+
+        // Caller must hold m_lock.  Appends records (zeroed afterwards),
+        // then publishes next and compacts if the journal has grown
+        // enough.  On a failed append nothing is published.
+        bool commit_locked(std::string & records, size_t count,
+                           std::shared_ptr<const user_table> next);
+
+        // Caller must hold m_lock.
+        bool append_journal_locked(std::string & records);
+
+        // Caller must hold m_lock.  Rewrites the webpass file from table,
+        // or from the files themselves if table is null, and empties the
+        // journal.
+        bool compact_locked(std::shared_ptr<const user_table> table);
 
         // Caller must hold m_lock.
-        bool write_map_locked() const;
+        bool write_map_locked(const user_table & users) const;
     };
 }
@@ -31,6 +31,10 @@ namespace
         double keepalive_rate = 0.5;
         int timeout_ms = 30000;
         bool use_tls = false;
+        std::string mix = "default";
+        std::string user;
+        std::string password;
+        std::string digest_algorithm = "MD5";
     };
 
     double uniform01(std::mt19937_64 & rng)
@@ -47,6 +51,10 @@ namespace
         cfg.host = opt.host;
         cfg.max_size = opt.max_size;
         cfg.fault_rate = opt.fault_rate;
+        cfg.mix = opt.mix;
+        cfg.user = opt.user;
+        cfg.password = opt.password;
+        cfg.digest_algorithm = opt.digest_algorithm;
 
         std::mt19937_64 rng(opt.seed +
                             static_cast<uint64_t>(id) * 0x9e3779b97f4a7c15ULL + 1);
@@ -151,6 +159,7 @@ namespace
 
             stats.bytes_recv.fetch_add(resp.body.size());
             stats.record_status(resp.status_code);
+            gen.observe(spec, resp);
 
             if (spec.is_fault)
             {
@@ -220,7 +229,14 @@ namespace
                 "  --max-size N        max body size in bytes (default 65536)\n"
                 "  --keepalive-rate F  probability 0..1 of connection reuse (default 0.5)\n"
                 "  --timeout N         per-request socket timeout ms (default 30000)\n"
-                "  --https             use TLS (certificate verification disabled)\n");
+                "  --https             use TLS (certificate verification disabled)\n"
+                "  --mix M             request mix: default, small (tiny bodyless\n"
+                "                      requests; small-response throughput benchmark)\n"
+                "                      or digest (small requests to /secure with Digest\n"
+                "                      auth; needs httptest --webpass and --user)\n"
+                "  --user U            digest mix user name\n"
+                "  --password P        digest mix password\n"
+                "  --digest-algorithm A  MD5 (default) or SHA-256\n");
     }
 }
 
@@ -251,6 +267,10 @@ int main(int argc, char ** argv)
         else if (std::strcmp(argv[i], "--keepalive-rate") == 0) opt.keepalive_rate = std::atof(need("--keepalive-rate"));
         else if (std::strcmp(argv[i], "--timeout") == 0) opt.timeout_ms = std::atoi(need("--timeout"));
         else if (std::strcmp(argv[i], "--https") == 0) opt.use_tls = true;
+        else if (std::strcmp(argv[i], "--mix") == 0) opt.mix = need("--mix");
+        else if (std::strcmp(argv[i], "--user") == 0) opt.user = need("--user");
+        else if (std::strcmp(argv[i], "--password") == 0) opt.password = need("--password");
+        else if (std::strcmp(argv[i], "--digest-algorithm") == 0) opt.digest_algorithm = need("--digest-algorithm");
         else
         {
             print_usage();
@@ -259,6 +279,13 @@ int main(int argc, char ** argv)
     }
 
     if (opt.threads < 1) opt.threads = 1;
+    if ((opt.mix != "default" && opt.mix != "small" && opt.mix != "digest") ||
+        (opt.mix == "digest" && opt.user.empty()) ||
+        (opt.digest_algorithm != "MD5" && opt.digest_algorithm != "SHA-256"))
+    {
+        print_usage();
+        return 1;
+    }
 
     if (opt.use_tls && !http_client::tls_init())
     {
@@ -268,10 +295,11 @@ int main(int argc, char ** argv)
 
     fprintf(stderr,
             "basher: host=%s port=%d threads=%d count=%llu fault-rate=%.3f "
-            "max-size=%zu keepalive-rate=%.3f tls=%s\n",
+            "max-size=%zu keepalive-rate=%.3f tls=%s mix=%s\n",
             opt.host.c_str(), opt.port, opt.threads,
             static_cast<unsigned long long>(opt.count), opt.fault_rate,
-            opt.max_size, opt.keepalive_rate, opt.use_tls ? "yes" : "no");
+            opt.max_size, opt.keepalive_rate, opt.use_tls ? "yes" : "no",
+            opt.mix.c_str());
 
     basher_stats stats;
     std::atomic<uint64_t> remaining{opt.count};
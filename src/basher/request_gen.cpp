@@ -5,6 +5,8 @@
 #include <string>
 #include <vector>
 
+#include <openssl/evp.h>
+
 #include <httptest/test_payload.h>
 
 #include "request_gen.h"
@@ -38,12 +40,14 @@ namespace minerva
                                      bool has_body,
                                      bool chunked,
                                      bool keep_alive,
-                                     std::mt19937_64 & rng)
+                                     std::mt19937_64 & rng,
+                                     const std::string & extra_headers = "")
     {
         std::ostringstream os;
         os << method << " " << path << " HTTP/1.1\r\n";
         os << "Host: " << host << "\r\n";
         os << "Connection: " << (keep_alive ? "keep-alive" : "close") << "\r\n";
+        os << extra_headers;
 
         if (!has_body)
         {
@@ -292,8 +296,8 @@ namespace minerva
             wire << "--" << boundary << "--\r\n";
             std::string mpbody = wire.str();
 
-            const char * modes[] = {"full", "stream", "partial"};
-            std::string rmode = modes[rng() % 3];
+            const char * modes[] = {"full", "stream", "partial", "view"};
+            std::string rmode = modes[rng() % 4];
             size_t consumed = (rmode == "partial")
                 ? static_cast<size_t>(1)
                 : ps.size();
@@ -436,6 +440,140 @@ namespace minerva
         return spec;
     }
 
+    request_spec request_gen::gen_small(std::mt19937_64 & rng, bool keep_alive)
+    {
+        request_spec spec;
+        if ((rng() & 3) == 0)
+        {
+            spec.k = request_spec::SINK;
+            spec.description = "GET /echo/sink";
+            spec.raw_request = build_request("GET", "/echo/sink", m_cfg.host,
+                                             "", false, false, keep_alive, rng);
+            spec.expected_status = 204;
+            return spec;
+        }
+
+        size_t n = static_cast<size_t>(rng() % 129);
+        uint32_t seed = static_cast<uint32_t>(rng());
+        std::ostringstream path;
+        path << "/echo/stream?size=" << n << "&seed=" << seed << "&mode=cl";
+        spec.k = request_spec::STREAM;
+        spec.description = "GET /echo/stream (small)";
+        spec.raw_request = build_request("GET", path.str(), m_cfg.host,
+                                         "", false, false, keep_alive, rng);
+        spec.expected_status = 200;
+        spec.check_body = true;
+        spec.expected_body = test_payload::generate(seed, n);
+        return spec;
+    }
+
+    static std::string hex_hash(const EVP_MD * md, const std::string & s)
+    {
+        unsigned char bin[EVP_MAX_MD_SIZE];
+        unsigned int len = 0;
+        EVP_Digest(s.data(), s.size(), bin, &len, md, nullptr);
+        static const char digits[] = "0123456789abcdef";
+        std::string hex;
+        for (unsigned int i = 0; i < len; ++i)
+        {
+            hex += digits[bin[i] >> 4];
+            hex += digits[bin[i] & 0x0f];
+        }
+        return hex;
+    }
+
+    // Value of a param in a WWW-Authenticate challenge, quoted or not.
+    static std::string challenge_param(const std::string & hdr,
+                                       const std::string & key)
+    {
+        size_t p = hdr.find(key + "=");
+        if (p == std::string::npos)
+        {
+            return std::string();
+        }
+        p += key.size() + 1;
+        if (p < hdr.size() && hdr[p] == '"')
+        {
+            size_t e = hdr.find('"', p + 1);
+            return e == std::string::npos ? std::string()
+                                          : hdr.substr(p + 1, e - p - 1);
+        }
+        size_t e = hdr.find_first_of(", ", p);
+        return hdr.substr(p, e == std::string::npos ? std::string::npos : e - p);
+    }
+
+    request_spec request_gen::gen_digest(std::mt19937_64 & rng, bool keep_alive)
+    {
+        request_spec spec;
+        spec.k = request_spec::DIGEST;
+
+        // Without a nonce, ask for a challenge.
+        if (m_nonce.empty())
+        {
+            spec.description = "GET /secure/sink (challenge)";
+            spec.raw_request = build_request("GET", "/secure/sink", m_cfg.host,
+                                             "", false, false, keep_alive, rng);
+            spec.expected_status = 401;
+            return spec;
+        }
+
+        size_t n = static_cast<size_t>(rng() % 129);
+        uint32_t seed = static_cast<uint32_t>(rng());
+        std::ostringstream path;
+        path << "/secure/stream?size=" << n << "&seed=" << seed << "&mode=cl";
+        const std::string uri = path.str();
+
+        char nc[9];
+        std::snprintf(nc, sizeof(nc), "%08x", ++m_nc);
+        char cnonce[17];
+        std::snprintf(cnonce, sizeof(cnonce), "%016llx",
+                      static_cast<unsigned long long>(rng()));
+
+        const EVP_MD * md = m_cfg.digest_algorithm == "SHA-256" ? EVP_sha256()
+                                                                 : EVP_md5();
+        const std::string ha1 = hex_hash(md, m_cfg.user + ":" + m_realm + ":" +
+                                             m_cfg.password);
+        const std::string ha2 = hex_hash(md, "GET:" + uri);
+        const std::string response =
+            hex_hash(md, ha1 + ":" + m_nonce + ":" + nc + ":" + cnonce +
+                         ":auth:" + ha2);
+
+        std::ostringstream auth;
+        auth << "Authorization: Digest username=\"" << m_cfg.user
+             << "\", realm=\"" << m_realm
+             << "\", nonce=\"" << m_nonce
+             << "\", uri=\"" << uri
+             << "\", algorithm=" << m_cfg.digest_algorithm
+             << ", qop=auth, nc=" << nc
+             << ", cnonce=\"" << cnonce
+             << "\", response=\"" << response << "\"\r\n";
+
+        spec.description = "GET /secure/stream (digest)";
+        spec.raw_request = build_request("GET", uri, m_cfg.host, "", false,
+                                         false, keep_alive, rng, auth.str());
+        spec.expected_status = 200;
+        spec.check_body = true;
+        spec.expected_body = test_payload::generate(seed, n);
+        return spec;
+    }
+
+    void request_gen::observe(const request_spec & spec,
+                              const http_client::response & r)
+    {
+        if (spec.k != request_spec::DIGEST || r.status_code != 401)
+        {
+            return;
+        }
+        auto it = r.headers.find("www-authenticate");
+        if (it == r.headers.end() || it->second.compare(0, 7, "Digest ") != 0)
+        {
+            return;
+        }
+        m_realm = challenge_param(it->second, "realm");
+        m_nonce = challenge_param(it->second, "nonce");
+        m_nc = 0;
+    }
+
     request_spec request_gen::next(std::mt19937_64 & rng, bool keep_alive)
     {
         if (m_cfg.fault_rate > 0.0)
@@ -446,6 +584,14 @@ namespace minerva
                 return gen_fault(rng);
             }
         }
+        if (m_cfg.mix == "small")
+        {
+            return gen_small(rng, keep_alive);
+        }
+        if (m_cfg.mix == "digest")
+        {
+            return gen_digest(rng, keep_alive);
+        }
         return gen_normal(rng, keep_alive);
     }
 
@@ -14,13 +14,22 @@ namespace minerva
         std::string host = "127.0.0.1";
         size_t max_size = 65536;
         double fault_rate = 0.0;
+        // Request mix: "default" exercises every endpoint; "small" only
+        // issues tiny bodyless requests with small responses, to benchmark
+        // per-request overhead (header parsing, dispatch, header writing).
+        std::string mix = "default";
+        // Credentials for the "digest" mix, which requests /secure/ with
+        // Digest auth and so needs httptest --webpass.
+        std::string user;
+        std::string password;
+        std::string digest_algorithm = "MD5";
     };
 
     // A single generated request: the raw bytes to send plus the information
     // needed to verify the response.
     struct request_spec
     {
-        enum kind { ECHO, CHECKSUM, SINK, STREAM, RAW, MULTIPART, FORMGEN, FAULT };
+        enum kind { ECHO, CHECKSUM, SINK, STREAM, RAW, MULTIPART, FORMGEN, DIGEST, FAULT };
 
         kind k = ECHO;
         std::string raw_request;   // bytes to send on the wire
@@ -64,12 +73,25 @@ namespace minerva
         // intends to reuse the connection (affects the Connection header).
         request_spec next(std::mt19937_64 & rng, bool keep_alive);
 
+        // Feed back each response; the digest mix takes its nonce from a
+        // 401 challenge.
+        void observe(const request_spec & spec, const http_client::response & r);
+
     private:
         request_spec gen_normal(std::mt19937_64 & rng, bool keep_alive);
         request_spec gen_fault(std::mt19937_64 & rng);
+        request_spec gen_small(std::mt19937_64 & rng, bool keep_alive);
+        request_spec gen_digest(std::mt19937_64 & rng, bool keep_alive);
         size_t pick_size(std::mt19937_64 & rng);
 
         basher_config m_cfg;
+
+        // Digest state: the current challenge and the last nc sent with
+        // its nonce. Each worker has its own generator, hence its own
+        // nonce.
+        std::string m_realm;
+        std::string m_nonce;
+        uint32_t m_nc = 0;
     };
 
     // Verify a response against a spec. Returns true if it matches. For fault
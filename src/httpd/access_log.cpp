@@ -0,0 +1,590 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <util/log.h>
+#include <util/time_utils.h>
+#include "access_log.h"
+#include "http_context.h"
+
+namespace minerva
+{
+    namespace
+    {
+        std::atomic<uint64_t> s_next_log_id{1};
+
+        struct file_header
+        {
+            char     magic[4];
+            uint32_t version;
+            uint32_t record_size;
+            uint32_t reserved;
+        };
+
+        // Copies src into a fixed NUL-padded field; returns false if it had
+        // to be cut short.
+        bool copy_field(char * dst, size_t size, std::string_view src)
+        {
+            const size_t n = std::min(src.size(), size);
+            std::memcpy(dst, src.data(), n);
+            std::memset(dst + n, 0, size - n);
+            return n == src.size();
+        }
+
+        std::string_view field_view(const char * field, size_t size)
+        {
+            return std::string_view(field, strnlen(field, size));
+        }
+
+        std::string format_ip(const uint8_t (&ip)[16])
+        {
+            char buf[INET6_ADDRSTRLEN] = {0};
+            static const uint8_t v4_prefix[12] =
+                { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff };
+            if (std::memcmp(ip, v4_prefix, sizeof(v4_prefix)) == 0)
+            {
+                inet_ntop(AF_INET, ip + 12, buf, sizeof(buf));
+            }
+            else
+            {
+                inet_ntop(AF_INET6, ip, buf, sizeof(buf));
+            }
+            return buf;
+        }
+
+        std::string format_timestamp(int64_t us)
+        {
+            const std::time_t secs = static_cast<std::time_t>(us / 1000000);
+            std::tm tm = minerva::gmtime(secs);
+            char buf[40];
+            size_t n = strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+            snprintf(buf + n, sizeof(buf) - n, ".%06dZ",
+                     static_cast<int>(us % 1000000));
+            return buf;
+        }
+
+        // Bytes outside printable ASCII are escaped one by one as \u00XX:
+        // a path or user name need not be UTF-8, and the output must stay
+        // valid JSON either way.
+        void json_escape(std::ostream & os, std::string_view s)
+        {
+            for (char c : s)
+            {
+                const unsigned char b = static_cast<unsigned char>(c);
+                switch (c)
+                {
+                case '"':  os << "\\\""; break;
+                case '\\': os << "\\\\"; break;
+                default:
+                    if (b < 0x20 || b >= 0x7f)
+                    {
+                        char buf[8];
+                        snprintf(buf, sizeof(buf), "\\u%04x", b);
+                        os << buf;
+                    }
+                    else
+                    {
+                        os << c;
+                    }
+                }
+            }
+        }
+
+        void csv_escape(std::ostream & os, std::string_view s)
+        {
+            if (s.find_first_of(",\"\r\n") == std::string_view::npos)
+            {
+                os << s;
+                return;
+            }
+            os << '"';
+            for (char c : s)
+            {
+                if (c == '"')
+                {
+                    os << '"';
+                }
+                os << c;
+            }
+            os << '"';
+        }
+    }
+
+    access_log::access_log(const std::string & path,
+                           size_t max_bytes,
+                           int max_files) :
+        m_path(path),
+        m_max_bytes(max_bytes),
+        m_max_files(max_files),
+        m_id(s_next_log_id++)
+    {
+    }
+
+    access_log::~access_log()
+    {
+        stop();
+    }
+
+    void access_log::start()
+    {
+        std::unique_lock<std::mutex> lk(m_queue_lock);
+        if (m_running)
+        {
+            return;
+        }
+        if (m_fd < 0 && !open_file())
+        {
+            return;
+        }
+        m_running = true;
+        m_writer = std::thread(&access_log::writer_thread_fn, this);
+    }
+
+    void access_log::stop()
+    {
+        {
+            std::unique_lock<std::mutex> lk(m_queue_lock);
+            m_running = false;
+        }
+        m_queue_cond.notify_all();
+        if (m_writer.joinable())
+        {
+            m_writer.join();
+        }
+
+        // The writer is gone; write whatever is left from this thread.
+        collect_partial();
+        std::vector<batch> batches;
+        {
+            std::unique_lock<std::mutex> lk(m_queue_lock);
+            batches.swap(m_queue);
+            m_flushed_seq = m_flush_seq;
+        }
+        m_flushed_cond.notify_all();
+        if (m_fd >= 0)
+        {
+            write_batches(batches);
+            ::close(m_fd);
+            m_fd = -1;
+        }
+    }
+
+    access_log::thread_buffer * access_log::local_buffer()
+    {
+        thread_local std::vector<std::pair<uint64_t,
+                                           std::shared_ptr<thread_buffer>>> buffers;
+        for (auto & b : buffers)
+        {
+            if (b.first == m_id)
+            {
+                return b.second.get();
+            }
+        }
+
+        auto tb = std::make_shared<thread_buffer>();
+        tb->records.reserve(BATCH_RECORDS);
+        {
+            std::unique_lock<std::mutex> lk(m_buffers_lock);
+            m_buffers.push_back(tb);
+        }
+        buffers.emplace_back(m_id, tb);
+        return tb.get();
+    }
+
+    void access_log::append(const access_record & rec)
+    {
+        thread_buffer * tb = local_buffer();
+        batch full;
+        {
+            std::unique_lock<std::mutex> lk(tb->mtx);
+            tb->records.push_back(rec);
+            if (tb->records.size() < BATCH_RECORDS)
+            {
+                return;
+            }
+            full.reserve(BATCH_RECORDS);
+            full.swap(tb->records);
+        }
+        submit(std::move(full));
+    }
+
+    void access_log::submit(batch && b)
+    {
+        {
+            std::unique_lock<std::mutex> lk(m_queue_lock);
+            if (m_queue.size() >= MAX_PENDING_BATCHES)
+            {
+                m_dropped += b.size();
+                return;
+            }
+            m_queue.push_back(std::move(b));
+        }
+        m_queue_cond.notify_one();
+    }
+
+    void access_log::collect_partial()
+    {
+        std::vector<std::shared_ptr<thread_buffer>> buffers;
+        {
+            std::unique_lock<std::mutex> lk(m_buffers_lock);
+            buffers = m_buffers;
+        }
+        for (auto & tb : buffers)
+        {
+            batch b;
+            {
+                std::unique_lock<std::mutex> lk(tb->mtx);
+                if (tb->records.empty())
+                {
+                    continue;
+                }
+                b.reserve(BATCH_RECORDS);
+                b.swap(tb->records);
+            }
+            submit(std::move(b));
+        }
+    }
+
+    void access_log::flush()
+    {
+        collect_partial();
+
+        std::unique_lock<std::mutex> lk(m_queue_lock);
+        if (!m_running)
+        {
+            return;
+        }
+        const unsigned long long target = ++m_flush_seq;
+        m_flush_requested = true;
+        m_queue_cond.notify_one();
+        m_flushed_cond.wait(lk, [&]() { return m_flushed_seq >= target; });
+    }
+
+    void access_log::writer_thread_fn()
+    {
+        std::unique_lock<std::mutex> lk(m_queue_lock);
+        while (m_running)
+        {
+            bool woken = m_queue_cond.wait_for(
+                lk, std::chrono::milliseconds(FLUSH_PERIOD_MS),
+                [this]() { return !m_running || !m_queue.empty() ||
+                                  m_flush_requested; });
+            if (!woken)
+            {
+                // Periodic sweep so quiet servers still reach the disk.
+                lk.unlock();
+                collect_partial();
+                lk.lock();
+            }
+
+            std::vector<batch> batches;
+            batches.swap(m_queue);
+            const unsigned long long seq = m_flush_seq;
+            m_flush_requested = false;
+            lk.unlock();
+
+            write_batches(batches);
+
+            lk.lock();
+            m_flushed_seq = seq;
+            m_flushed_cond.notify_all();
+        }
+    }
+
+    void access_log::write_batches(std::vector<batch> & batches)
+    {
+        for (auto & b : batches)
+        {
+            const size_t bytes = b.size() * sizeof(access_record);
+            // A batch larger than the limit goes into a fresh file rather
+            // than rotating one that holds no records yet.
+            if (m_max_bytes > 0 && m_file_size > sizeof(file_header) &&
+                m_file_size + bytes > m_max_bytes)
+            {
+                rotate();
+            }
+            if (m_fd < 0)
+            {
+                m_dropped += b.size();
+                continue;
+            }
+
+            const char * data = reinterpret_cast<const char *>(b.data());
+            size_t done = 0;
+            while (done < bytes)
+            {
+                ssize_t n = ::write(m_fd, data + done, bytes - done);
+                if (n < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (n <= 0)
+                {
+                    LOG_ERROR_ERRNO("access log write failed: " << m_path, errno);
+                    break;
+                }
+                done += n;
+            }
+            const size_t whole = done / sizeof(access_record);
+            const size_t kept = whole * sizeof(access_record);
+            // A short write leaves part of a record behind; cut it off so
+            // later records stay aligned.
+            if (kept != done &&
+                ::ftruncate(m_fd, m_file_size + kept) != 0)
+            {
+                // It cannot be cut off; start a new file instead.
+                LOG_ERROR_ERRNO("access log truncate failed: " << m_path, errno);
+                rotate();
+            }
+            else
+            {
+                m_file_size += kept;
+            }
+            m_written += whole;
+            m_dropped += b.size() - whole;
+        }
+    }
+
+    bool access_log::open_file()
+    {
+        m_fd = ::open(m_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                      0644);
+        if (m_fd < 0)
+        {
+            LOG_ERROR_ERRNO("failed to open access log: " << m_path, errno);
+            return false;
+        }
+
+        struct stat st;
+        m_file_size = ::fstat(m_fd, &st) == 0 ? st.st_size : 0;
+        if (m_file_size > 0)
+        {
+            file_header hdr;
+            if (::pread(m_fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+                std::memcmp(hdr.magic, FILE_MAGIC, sizeof(hdr.magic)) != 0 ||
+                hdr.version != FILE_VERSION ||
+                hdr.record_size != sizeof(access_record))
+            {
+                // Appending would mix record layouts; start a new file.
+                LOG_WARN("access log " << m_path
+                         << " has another format, rotating it");
+                rotate();
+                return m_fd >= 0;
+            }
+        }
+        if (m_file_size == 0)
+        {
+            file_header hdr;
+            std::memcpy(hdr.magic, FILE_MAGIC, sizeof(hdr.magic));
+            hdr.version     = FILE_VERSION;
+            hdr.record_size = sizeof(access_record);
+            hdr.reserved    = 0;
+            if (::write(m_fd, &hdr, sizeof(hdr)) != sizeof(hdr))
+            {
+                LOG_ERROR_ERRNO("failed to write access log header: " << m_path,
+                                errno);
+            }
+            m_file_size = sizeof(hdr);
+        }
+        return true;
+    }
+
+    void access_log::rotate()
+    {
+        if (m_fd >= 0)
+        {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+        for (int i = m_max_files - 1; i >= 1; --i)
+        {
+            std::string from = m_path + "." + std::to_string(i);
+            std::string to   = m_path + "." + std::to_string(i + 1);
+            ::rename(from.c_str(), to.c_str());
+        }
+        if (m_max_files > 0)
+        {
+            ::rename(m_path.c_str(), (m_path + ".1").c_str());
+        }
+        else
+        {
+            ::unlink(m_path.c_str());
+        }
+        open_file();
+    }
+
+    void access_log::make_record(http_context & ctx, access_record & rec)
+    {
+        std::memset(&rec, 0, sizeof(rec));
+
+        rec.timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        rec.duration_us = static_cast<uint32_t>(
+            std::min<long long>(ctx.get_elapsed_microseconds(), UINT32_MAX));
+        rec.status    = static_cast<uint16_t>(ctx.response().status_code());
+        rec.method    = static_cast<uint8_t>(ctx.request().method());
+        rec.bytes_in  = ctx.request().bytes_received();
+        rec.bytes_out = ctx.response().bytes_sent();
+
+        if (ctx.conn() && ctx.conn()->is_secure())
+        {
+            rec.flags |= access_record::FLAG_SECURE;
+        }
+
+        const sockaddr_storage & addr = ctx.client_addr();
+        if (addr.ss_family == AF_INET6)
+        {
+            const auto * in6 = reinterpret_cast<const sockaddr_in6 *>(&addr);
+            std::memcpy(rec.client_ip, &in6->sin6_addr, 16);
+        }
+        else if (addr.ss_family == AF_INET)
+        {
+            const auto * in4 = reinterpret_cast<const sockaddr_in *>(&addr);
+            rec.client_ip[10] = 0xff;
+            rec.client_ip[11] = 0xff;
+            std::memcpy(rec.client_ip + 12, &in4->sin_addr, 4);
+        }
+
+        copy_field(rec.user, sizeof(rec.user), ctx.username());
+
+        const std::string & path  = ctx.request().path();
+        const std::string & query = ctx.request().query_string();
+        bool whole = copy_field(rec.path, sizeof(rec.path), path);
+        if (whole && !query.empty())
+        {
+            const size_t used = path.size();
+            if (used + 1 + query.size() <= sizeof(rec.path))
+            {
+                rec.path[used] = '?';
+                std::memcpy(rec.path + used + 1, query.data(), query.size());
+            }
+            else
+            {
+                whole = false;
+            }
+        }
+        if (!whole)
+        {
+            rec.flags |= access_record::FLAG_TRUNCATED;
+        }
+
+        const long long cpu = ctx.cpu_us();
+        rec.cpu_us = cpu < 0 ? access_record::CPU_UNKNOWN
+                             : static_cast<uint32_t>(std::min<long long>(
+                                   cpu, access_record::CPU_UNKNOWN - 1));
+        rec.reads  = static_cast<uint32_t>(ctx.request().read_syscalls());
+        rec.writes = static_cast<uint32_t>(ctx.response().write_syscalls());
+        rec.polls  = static_cast<uint32_t>(ctx.request().poll_syscalls() +
+                                           ctx.response().poll_syscalls());
+    }
+
+    void access_log::format_record(const access_record & rec,
+                                   std::ostream & os, FORMAT fmt)
+    {
+        const char * method = http_request::method_as_string(
+            static_cast<http_request::METHOD>(rec.method));
+        const std::string ts = format_timestamp(rec.timestamp_us);
+        const std::string ip = format_ip(rec.client_ip);
+        const std::string_view user = field_view(rec.user, sizeof(rec.user));
+        const std::string_view path = field_view(rec.path, sizeof(rec.path));
+        const bool secure = rec.flags & access_record::FLAG_SECURE;
+        const bool aborted = rec.flags & access_record::FLAG_ABORTED;
+        const bool has_cpu = rec.cpu_us != access_record::CPU_UNKNOWN;
+
+        switch (fmt)
+        {
+        case TEXT:
+            os << ts << ' ' << ip << ' ' << (user.empty() ? "-" : user) << ' '
+               << method << ' ' << path
+               << ((rec.flags & access_record::FLAG_TRUNCATED) ? "..." : "")
+               << ' ' << rec.status
+               << " in=" << rec.bytes_in << " out=" << rec.bytes_out
+               << " duration=" << rec.duration_us << "us";
+            if (has_cpu)
+            {
+                os << " cpu=" << rec.cpu_us << "us";
+            }
+            os << " calls=" << rec.reads << '/' << rec.writes << '/' << rec.polls
+               << (secure ? " tls" : "") << (aborted ? " aborted" : "") << '\n';
+            break;
+        case JSON:
+            os << "{\"time\":\"" << ts << "\",\"client\":\"" << ip
+               << "\",\"user\":\"";
+            json_escape(os, user);
+            os << "\",\"method\":\"" << method << "\",\"path\":\"";
+            json_escape(os, path);
+            os << "\",\"status\":" << rec.status
+               << ",\"bytes_in\":" << rec.bytes_in
+               << ",\"bytes_out\":" << rec.bytes_out
+               << ",\"duration_us\":" << rec.duration_us;
+            if (has_cpu)
+            {
+                os << ",\"cpu_us\":" << rec.cpu_us;
+            }
+            os << ",\"reads\":" << rec.reads
+               << ",\"writes\":" << rec.writes
+               << ",\"polls\":" << rec.polls
+               << ",\"tls\":" << (secure ? "true" : "false")
+               << ",\"truncated\":"
+               << ((rec.flags & access_record::FLAG_TRUNCATED) ? "true" : "false")
+               << ",\"aborted\":" << (aborted ? "true" : "false")
+               << "}\n";
+            break;
+        case CSV:
+            os << ts << ',' << ip << ',';
+            csv_escape(os, user);
+            os << ',' << method << ',';
+            csv_escape(os, path);
+            os << ',' << rec.status << ',' << rec.bytes_in << ','
+               << rec.bytes_out << ',' << rec.duration_us << ',';
+            if (has_cpu)
+            {
+                os << rec.cpu_us;
+            }
+            os << ',' << rec.reads << ',' << rec.writes << ',' << rec.polls
+               << ',' << (secure ? 1 : 0) << ',' << (aborted ? 1 : 0) << '\n';
+            break;
+        }
+    }
+
+    bool access_log::decode(std::istream & is, std::ostream & os, FORMAT fmt)
+    {
+        file_header hdr;
+        if (!is.read(reinterpret_cast<char *>(&hdr), sizeof(hdr)) ||
+            std::memcmp(hdr.magic, FILE_MAGIC, sizeof(hdr.magic)) != 0)
+        {
+            LOG_ERROR("not an access log file");
+            return false;
+        }
+        const bool v1 = hdr.version == 1 &&
+                        hdr.record_size == access_record::V1_SIZE;
+        if (!v1 && (hdr.version != FILE_VERSION ||
+                    hdr.record_size != sizeof(access_record)))
+        {
+            LOG_ERROR("unsupported access log version " << hdr.version
+                      << " record size " << hdr.record_size);
+            return false;
+        }
+
+        if (fmt == CSV)
+        {
+            os << "time,client,user,method,path,status,bytes_in,bytes_out,"
+                  "duration_us,cpu_us,reads,writes,polls,tls,aborted\n";
+        }
+
+        access_record rec;
+        std::memset(&rec, 0, sizeof(rec));
+        rec.cpu_us = access_record::CPU_UNKNOWN;
+        while (is.read(reinterpret_cast<char *>(&rec), hdr.record_size))
+        {
+            format_record(rec, os, fmt);
+        }
+        return true;
+    }
+}
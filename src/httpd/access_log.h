@@ -0,0 +1,161 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace minerva
+{
+    class http_context;
+
+    /*
+     * One completed request, written to disk verbatim (host byte order).
+     * Strings are truncated and NUL padded; the client address is IPv6
+     * with IPv4 clients in v4-mapped form.
+     */
+    struct access_record
+    {
+        int64_t  timestamp_us;   // completion time, microseconds since epoch
+        uint32_t duration_us;
+        uint16_t status;
+        uint8_t  method;         // http_request::METHOD
+        uint8_t  flags;
+        uint64_t bytes_in;       // bytes read from the transport
+        uint64_t bytes_out;      // bytes written to the transport
+        uint8_t  client_ip[16];
+        char     user[32];
+        char     path[128];      // path, then '?' and the query if it fits
+        // Version 2 fields. Version 1 records are the prefix above and
+        // decode with these zeroed.
+        uint32_t cpu_us;         // handler thread CPU; CPU_UNKNOWN if not accounted
+        uint32_t reads;          // transport read() calls
+        uint32_t writes;         // transport write() calls
+        uint32_t polls;          // transport poll() calls
+
+        static constexpr uint8_t  FLAG_SECURE    = 0x01;
+        static constexpr uint8_t  FLAG_TRUNCATED = 0x02;
+        static constexpr uint8_t  FLAG_ABORTED   = 0x04;   // response incomplete
+        static constexpr uint32_t CPU_UNKNOWN    = UINT32_MAX;
+        static constexpr size_t   V1_SIZE        = 208;
+    };
+
+    static_assert(sizeof(access_record) == 224,
+                  "access_record layout is part of the file format");
+
+    /*
+     * Binary access log. Request threads append records to a per-thread
+     * batch without contention; full batches (and, periodically, partial
+     * ones) are handed to a writer thread that appends them to the log
+     * file and rotates it by size. If the writer falls behind by more
+     * than MAX_PENDING_BATCHES, batches are dropped and counted.
+     *
+     * Each file starts with a header of FILE_MAGIC, FILE_VERSION and the
+     * record size, followed by back-to-back access_record values. An
+     * existing file written with another version is rotated away on open.
+     */
+    class access_log
+    {
+    public:
+        static constexpr char     FILE_MAGIC[4]        = { 'M', 'A', 'C', 'L' };
+        static constexpr uint32_t FILE_VERSION         = 2;
+        static constexpr size_t   BATCH_RECORDS        = 256;
+        static constexpr size_t   MAX_PENDING_BATCHES  = 64;
+        static constexpr int      FLUSH_PERIOD_MS      = 1000;
+
+        enum FORMAT
+        {
+            TEXT,
+            JSON,
+            CSV
+        };
+
+        // path is the active file; rotated files get .1 .. .max_files
+        // suffixes, .1 being the newest.
+        access_log(const std::string & path,
+                   size_t max_bytes = 64 * 1024 * 1024,
+                   int max_files = 4);
+        ~access_log();
+
+        access_log(const access_log &)             = delete;
+        access_log & operator=(const access_log &) = delete;
+
+        void start();
+        void stop();
+
+        void append(const access_record & rec);
+
+        // Fills rec from a finished request: status and bytes are those
+        // reached, which for an aborted request may be partial.
+        static void make_record(http_context & ctx, access_record & rec);
+
+        // Hands every thread's partial batch to the writer and waits until
+        // all of it is on disk.
+        void flush();
+
+        unsigned long long written_count() const
+        {
+            return m_written;
+        }
+
+        unsigned long long dropped_count() const
+        {
+            return m_dropped;
+        }
+
+        // Decoder side. decode() reads a log file from is and prints every
+        // record to os; returns false if the header is missing or invalid.
+        static bool decode(std::istream & is, std::ostream & os, FORMAT fmt);
+
+        static void format_record(const access_record & rec,
+                                  std::ostream & os, FORMAT fmt);
+
+    private:
+        typedef std::vector<access_record> batch;
+
+        struct thread_buffer
+        {
+            std::mutex mtx;
+            batch      records;
+        };
+
+        thread_buffer * local_buffer();
+        void submit(batch && b);
+        void collect_partial();
+        void writer_thread_fn();
+        void write_batches(std::vector<batch> & batches);
+        bool open_file();
+        void rotate();
+
+        const std::string m_path;
+        const size_t      m_max_bytes;
+        const int         m_max_files;
+        const uint64_t    m_id;
+
+        std::mutex                                  m_buffers_lock;
+        std::vector<std::shared_ptr<thread_buffer>> m_buffers;
+
+        std::mutex              m_queue_lock;
+        std::condition_variable m_queue_cond;
+        std::condition_variable m_flushed_cond;
+        std::vector<batch>      m_queue;
+        bool                    m_running = false;
+        bool                    m_flush_requested = false;
+        unsigned long long      m_flush_seq = 0;
+        unsigned long long      m_flushed_seq = 0;
+        std::thread             m_writer;
+
+        int    m_fd = -1;
+        size_t m_file_size = 0;
+
+        std::atomic<unsigned long long> m_written{0};
+        std::atomic<unsigned long long> m_dropped{0};
+    };
+}
@@ -0,0 +1,82 @@
+#include <algorithm>
+#include "admission_control.h"
+
+namespace minerva
+{
+    admission_control::admission_control()
+    {
+        retry_after_seconds(DEFAULT_RETRY_AFTER);
+    }
+
+    void admission_control::retry_after_seconds(int seconds)
+    {
+        static const char body[] = "Service Unavailable\n";
+        auto r = std::make_shared<std::string>();
+        *r += "HTTP/1.1 503 Service Unavailable\r\n";
+        *r += "Content-Type: text/plain\r\n";
+        *r += "Content-Length: " + std::to_string(sizeof(body) - 1) + "\r\n";
+        *r += "Retry-After: " + std::to_string(std::max(seconds, 0)) + "\r\n";
+        *r += "Connection: close\r\n\r\n";
+        *r += body;
+        std::atomic_store_explicit(&m_response,
+                                   std::shared_ptr<const std::string>(std::move(r)),
+                                   std::memory_order_release);
+    }
+
+    admission_control::verdict admission_control::admit()
+    {
+        const size_t depth = m_queued.load(std::memory_order_relaxed);
+        const size_t limit = m_max_queue.load(std::memory_order_relaxed);
+        if (limit && depth >= limit)
+        {
+            m_shed_queue.fetch_add(1, std::memory_order_relaxed);
+            return verdict::SHED_QUEUE;
+        }
+
+        if (m_shedding.load(std::memory_order_relaxed) &&
+            m_target_ns.load(std::memory_order_relaxed) > 0)
+        {
+            if (depth != 0)
+            {
+                m_shed_latency.fetch_add(1, std::memory_order_relaxed);
+                return verdict::SHED_LATENCY;
+            }
+            // Drained: nothing is left to wait behind.
+            m_shedding.store(false, std::memory_order_relaxed);
+            m_above_until_ns.store(0, std::memory_order_relaxed);
+        }
+
+        m_queued.fetch_add(1, std::memory_order_relaxed);
+        return verdict::ADMIT;
+    }
+
+    void admission_control::dequeued(int64_t queued_ns, int64_t now_ns)
+    {
+        m_queued.fetch_sub(1, std::memory_order_relaxed);
+
+        const int64_t target = m_target_ns.load(std::memory_order_relaxed);
+        if (target <= 0)
+        {
+            return;
+        }
+
+        if (now_ns - queued_ns < target)
+        {
+            m_above_until_ns.store(0, std::memory_order_relaxed);
+            m_shedding.store(false, std::memory_order_relaxed);
+            return;
+        }
+
+        int64_t until = m_above_until_ns.load(std::memory_order_relaxed);
+        if (until == 0)
+        {
+            m_above_until_ns.compare_exchange_strong(
+                until, now_ns + m_interval_ns.load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+        }
+        else if (now_ns >= until)
+        {
+            m_shedding.store(true, std::memory_order_relaxed);
+        }
+    }
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace minerva
+{
+    /*
+     * Admission control for the handler thread pool.
+     *
+     * A connection with a request to serve is admitted unless
+     *   - max_queue() connections are already waiting for a handler
+     *     thread, or
+     *   - queueing delay has stayed at or above target_ms() for a whole
+     *     interval_ms(), CoDel's test for a standing queue rather than a
+     *     burst. Shedding then continues until a connection is dequeued
+     *     within the target or the queue drains.
+     *
+     * A shed connection gets response(), a pre-rendered 503 with
+     * Retry-After, written by the accepting or polling thread; it never
+     * reaches a handler thread. 0 disables either limit; both are off by
+     * default. admit() and dequeued() take no locks.
+     */
+    class admission_control
+    {
+    public:
+        enum class verdict
+        {
+            ADMIT,
+            SHED_QUEUE,     // queue at max_queue()
+            SHED_LATENCY    // standing queue above target_ms()
+        };
+
+        static constexpr int DEFAULT_INTERVAL_MS = 100;
+        static constexpr int DEFAULT_RETRY_AFTER = 1;
+
+        admission_control();
+
+        void max_queue(size_t n)
+        {
+            m_max_queue = n;
+        }
+
+        size_t max_queue() const
+        {
+            return m_max_queue;
+        }
+
+        void target_ms(int ms)
+        {
+            m_target_ns = static_cast<int64_t>(ms) * 1000000;
+        }
+
+        void interval_ms(int ms)
+        {
+            m_interval_ns = static_cast<int64_t>(ms) * 1000000;
+        }
+
+        // Re-renders response().
+        void retry_after_seconds(int seconds);
+
+        // Call before queueing a connection for a handler thread. An
+        // admitted connection counts as queued until dequeued().
+        verdict admit();
+
+        // Call from the handler thread as it picks up an admitted
+        // connection queued at queued_ns (http_context::now_ns()).
+        void dequeued(int64_t queued_ns, int64_t now_ns);
+
+        // The complete 503 response, Connection: close.
+        std::shared_ptr<const std::string> response() const
+        {
+            return std::atomic_load_explicit(&m_response,
+                                             std::memory_order_acquire);
+        }
+
+        size_t queued() const
+        {
+            return m_queued.load(std::memory_order_relaxed);
+        }
+
+        uint64_t shed_queue_count() const
+        {
+            return m_shed_queue.load(std::memory_order_relaxed);
+        }
+
+        uint64_t shed_latency_count() const
+        {
+            return m_shed_latency.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<size_t>   m_max_queue{0};
+        std::atomic<int64_t>  m_target_ns{0};
+        std::atomic<int64_t>  m_interval_ns{
+            static_cast<int64_t>(DEFAULT_INTERVAL_MS) * 1000000};
+
+        std::atomic<size_t>   m_queued{0};
+        // When the delay first reached the target, plus the interval; 0
+        // while below it.
+        std::atomic<int64_t>  m_above_until_ns{0};
+        std::atomic<bool>     m_shedding{false};
+
+        std::atomic<uint64_t> m_shed_queue{0};
+        std::atomic<uint64_t> m_shed_latency{0};
+
+        std::shared_ptr<const std::string> m_response;
+    };
+}
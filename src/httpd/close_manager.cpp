@@ -0,0 +1,204 @@
+#include <chrono>
+#include <iterator>
+#include <util/log.h>
+#include "close_manager.h"
+
+namespace minerva
+{
+    namespace
+    {
+        int64_t now_ns()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+    }
+
+    void close_manager::close(std::shared_ptr<connection> conn, int linger_ms)
+    {
+        entry e;
+        e.conn       = std::move(conn);
+        e.started_ns = now_ns();
+        e.notify     = e.conn->is_secure();
+        if (!e.notify)
+        {
+            e.conn->shutdown_write();
+        }
+        if (step(e))
+        {
+            return;
+        }
+
+        if (linger_ms < 0)
+        {
+            linger_ms = DEFAULT_LINGER_MS;
+        }
+        e.deadline_ns = e.started_ns + static_cast<int64_t>(linger_ms) * 1000000;
+
+        {
+            std::unique_lock<std::mutex> lk(m_lock);
+            if (!m_stopped &&
+                m_closing.load(std::memory_order_relaxed) <
+                m_max_closing.load(std::memory_order_relaxed))
+            {
+                m_closing.fetch_add(1, std::memory_order_relaxed);
+                m_incoming.push_back(std::move(e));
+                m_cond.notify_one();
+                return;
+            }
+        }
+
+        LOG_WARN_RATELIMITED(1000, "too many connections closing; "
+                             "closing without linger");
+        m_forced.fetch_add(1, std::memory_order_relaxed);
+        e.conn->shutdown_write();
+        e.conn->shutdown_read();
+    }
+
+    bool close_manager::step(entry & e)
+    {
+        connection & c = *e.conn;
+        e.want_write = false;
+
+        if (e.notify)
+        {
+            switch (c.shutdown())
+            {
+            case connection::CONNECTION_WANTS_WRITE:
+                e.want_write = true;
+                return false;
+            case connection::CONNECTION_WANTS_READ:
+                // close_notify is out; the client's may follow.
+                e.notify = false;
+                c.shutdown_write();
+                break;
+            default:
+                // Both close_notifys exchanged, or the client is gone.
+                c.shutdown_write();
+                return true;
+            }
+        }
+
+        if (c.is_secure())
+        {
+            // Completes once the client's close_notify arrives; OpenSSL
+            // discards application data ahead of it.
+            switch (c.shutdown())
+            {
+            case connection::CONNECTION_WANTS_READ:
+                return false;
+            case connection::CONNECTION_WANTS_WRITE:
+                e.want_write = true;
+                return false;
+            default:
+                return true;
+            }
+        }
+
+        char buf[4096];
+        for (int i = 0; i < 16; ++i)
+        {
+            ssize_t n = 0;
+            switch (c.read(buf, sizeof(buf), n))
+            {
+            case connection::CONNECTION_OK:
+                break;
+            case connection::CONNECTION_WANTS_READ:
+                return false;
+            default:
+                return true;
+            }
+        }
+        // Still sending; look again on the next poll.
+        return false;
+    }
+
+    void close_manager::finish(const entry & e, int64_t now_ns, bool timed_out)
+    {
+        m_closing.fetch_sub(1, std::memory_order_relaxed);
+        if (timed_out)
+        {
+            m_timeouts.fetch_add(1, std::memory_order_relaxed);
+        }
+        m_close_time.record(static_cast<uint64_t>(now_ns - e.started_ns) / 1000);
+    }
+
+    void close_manager::run()
+    {
+        std::vector<entry> entries;
+        std::vector<connection::shared_poll_fd> fds;
+
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lk(m_lock);
+                while (!m_stopped && entries.empty() && m_incoming.empty())
+                {
+                    m_cond.wait(lk);
+                }
+                entries.insert(entries.end(),
+                               std::make_move_iterator(m_incoming.begin()),
+                               std::make_move_iterator(m_incoming.end()));
+                m_incoming.clear();
+                if (m_stopped)
+                {
+                    break;
+                }
+            }
+
+            fds.clear();
+            for (const entry & e : entries)
+            {
+                fds.emplace_back(e.conn->get_socket(), !e.want_write,
+                                 e.want_write, true);
+            }
+            int err = 0;
+            if (connection::poll(fds, POLL_MS, err) < 0)
+            {
+                // Deadlines still apply; retry on the next pass.
+                for (auto & fd : fds)
+                {
+                    fd.read = fd.write = fd.error = false;
+                }
+            }
+
+            const int64_t now = now_ns();
+            size_t kept = 0;
+            for (size_t i = 0; i < entries.size(); ++i)
+            {
+                entry & e = entries[i];
+                const bool ready = fds[i].read || fds[i].write || fds[i].error;
+                if (ready && step(e))
+                {
+                    finish(e, now, false);
+                    continue;
+                }
+                if (now >= e.deadline_ns)
+                {
+                    finish(e, now, true);
+                    continue;
+                }
+                if (kept != i)
+                {
+                    entries[kept] = std::move(e);
+                }
+                ++kept;
+            }
+            entries.resize(kept);
+        }
+
+        for (entry & e : entries)
+        {
+            e.conn->shutdown_write();
+            e.conn->shutdown_read();
+            m_closing.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    void close_manager::stop()
+    {
+        std::unique_lock<std::mutex> lk(m_lock);
+        m_stopped = true;
+        m_cond.notify_all();
+    }
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <util/connection.h>
+#include <util/histogram.h>
+
+namespace minerva
+{
+    /*
+     * Graceful connection close without blocking a thread per socket.
+     *
+     * close() sends the TLS close_notify if there is one, half-closes the
+     * socket and then reads and discards whatever the client still sends
+     * until it closes its side, so a response in flight is not lost to a
+     * reset. Each step is non-blocking: close() takes the first one on the
+     * caller's thread and hands the connection to run(), which polls every
+     * closing socket from one thread until it finishes or its linger time
+     * runs out.
+     *
+     * At most max_closing() sockets linger at once; past that close() shuts
+     * both directions at once and releases the socket.
+     */
+    class close_manager
+    {
+    public:
+        static constexpr size_t DEFAULT_MAX_CLOSING = 4096;
+        static constexpr int    DEFAULT_LINGER_MS   = 2000;
+
+        close_manager() = default;
+
+        close_manager(const close_manager &)             = delete;
+        close_manager & operator=(const close_manager &) = delete;
+
+        void max_closing(size_t n)
+        {
+            m_max_closing = n;
+        }
+
+        size_t max_closing() const
+        {
+            return m_max_closing;
+        }
+
+        // linger_ms bounds the whole close, close_notify included; < 0
+        // takes DEFAULT_LINGER_MS.
+        void close(std::shared_ptr<connection> conn, int linger_ms = -1);
+
+        // The polling loop; returns after stop(), releasing every socket
+        // still closing.
+        void run();
+        void stop();
+
+        size_t closing() const
+        {
+            return m_closing.load(std::memory_order_relaxed);
+        }
+
+        // Closes cut short by the cap, and those that hit their linger
+        // time, cumulative.
+        uint64_t forced_count() const
+        {
+            return m_forced.load(std::memory_order_relaxed);
+        }
+
+        uint64_t timeout_count() const
+        {
+            return m_timeouts.load(std::memory_order_relaxed);
+        }
+
+        // Time from close() to release of lingering closes, in us.
+        const latency_histogram & close_time() const
+        {
+            return m_close_time;
+        }
+
+    private:
+        // Longest poll() while sockets are closing, so deadlines and new
+        // arrivals are seen promptly.
+        static constexpr int POLL_MS = 50;
+
+        struct entry
+        {
+            std::shared_ptr<connection> conn;
+            int64_t started_ns  = 0;
+            int64_t deadline_ns = 0;
+            bool    notify      = false;   // TLS close_notify not yet sent
+            bool    want_write  = false;
+        };
+
+        // Advances e as far as it goes without blocking; true once done.
+        static bool step(entry & e);
+        void finish(const entry & e, int64_t now_ns, bool timed_out);
+
+        std::atomic<size_t>   m_max_closing{DEFAULT_MAX_CLOSING};
+        std::atomic<size_t>   m_closing{0};
+        std::atomic<uint64_t> m_forced{0};
+        std::atomic<uint64_t> m_timeouts{0};
+        latency_histogram     m_close_time;
+
+        std::mutex              m_lock;
+        std::condition_variable m_cond;
+        std::vector<entry>      m_incoming;
+        bool                    m_stopped = false;
+    };
+}
@@ -1,4 +1,5 @@
 #include <string>
+#include <string_view>
 #include <istream>
 #include <fstream>
 #include <cstdio>
@@ -64,6 +65,11 @@ namespace minerva
     void controller::handle_request(http_context & ctx,
                                     const std::string & operation)
     {
+        if (ctx.routed_operation() == &operation && ctx.routed_handler())
+        {
+            (*ctx.routed_handler())(ctx);
+            return;
+        }
         auto it = m_handlers.find(operation);
         if (it == m_handlers.end())
         {
@@ -134,26 +140,36 @@ namespace minerva
 
         try
         {
-            char buf[128 * 1024];
-            size_t read = 0;
-            do
+            // Pass 0 to defer to the per-context aggregate timeout
+            // (http_context::timed_out()), preventing slow-loris uploads
+            // from holding a worker thread indefinitely.
+            if (ctx.request().can_splice())
             {
-                // Pass 0 to defer to the per-context aggregate timeout
-                // (http_context::timed_out()), preventing slow-loris uploads
-                // from holding a worker thread indefinitely.
-                read = ctx.request().read(buf, sizeof(buf), 0);
-                if (read > 0)
-                {
-                    os.stream().write(buf, read);
-                    if (os.fail())
+                // Plain-HTTP content-length upload: reserve the space and
+                // move the bytes socket -> pipe -> file in the kernel.
+                os.preallocate(ctx.request().content_length());
+                ctx.request().splice_to_fd(os.native_handle(), 0);
+            }
+            else
+            {
+                // TLS or chunked: each slice is written straight from the
+                // request's receive buffer.
+                ctx.request().consume(
+                    [&](std::string_view v)
                     {
-                        LOG_ERROR("Failed to write to file: " << filename);
-                        success = false;
-                        break;
-                    }
-                }
+                        if (!success)
+                        {
+                            return;
+                        }
+                        os.stream().write(v.data(), v.size());
+                        if (os.fail())
+                        {
+                            LOG_ERROR("Failed to write to file: " << filename);
+                            success = false;
+                        }
+                    },
+                    0);
             }
-            while (read > 0);
         }
         catch (const std::exception & e)
         {
@@ -7,6 +7,7 @@
 #include <util/string_utils.h>
 #include "http_request.h"
 #include "http_response.h"
+#include "rate_limiter.h"
 
 namespace minerva
 {
@@ -25,6 +26,9 @@ namespace minerva
         controller(controller &&)                  = delete;
         controller & operator=(controller &&)      = delete;
 
+        // Runs the handler registered for operation. When httpd has already
+        // resolved it (ctx.routed_operation() is &operation) the handler
+        // map is not searched again.
         virtual void handle_request(http_context & ctx,
                                     const std::string & operation);
     
@@ -41,6 +45,31 @@ namespace minerva
             m_require_authorization = require;
         }
 
+        // Token buckets httpd applies before running a handler, answering
+        // 429 when one is empty: per client address, checked before
+        // authentication or reading the body, and per authenticated user.
+        // Off by default. Set at startup; not synchronized for concurrent
+        // updates.
+        const rate_limiter::limit & client_rate_limit() const
+        {
+            return m_client_rate_limit;
+        }
+
+        void client_rate_limit(double per_second, double burst)
+        {
+            m_client_rate_limit = rate_limiter::limit(per_second, burst);
+        }
+
+        const rate_limiter::limit & user_rate_limit() const
+        {
+            return m_user_rate_limit;
+        }
+
+        void user_rate_limit(double per_second, double burst)
+        {
+            m_user_rate_limit = rate_limiter::limit(per_second, burst);
+        }
+
         /**
          * Authorization hook. Returns true if `user` is permitted to invoke
          * `op` on this controller.
@@ -76,6 +105,11 @@ namespace minerva
          * during construction / before httpd::start(); registering after
          * the server has started serving requests is a data race.
          *
+         * httpd compiles the names into its route_table. A name may have
+         * several '/' separated segments, and a segment written {param}
+         * matches any value, read back with http_request::path_param().
+         * The operation passed for such a route is the registered name.
+         *
          * If `name` is already registered, the new handler replaces the
          * old one and a warning is logged.
          */
@@ -165,8 +199,11 @@ namespace minerva
         }
 
     private:
+        friend class route_table;
 
         bool m_require_authorization = true;
+        rate_limiter::limit m_client_rate_limit;
+        rate_limiter::limit m_user_rate_limit;
         std::map<std::string, std::function<void(http_context & ctx)>, minerva::ci_less> m_handlers;
 
         static size_t s_max_send_file_size;
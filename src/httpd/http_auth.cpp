@@ -1,12 +1,12 @@
 #define OPENSSL_API_COMPAT 0x10100000L
 
+#include <algorithm>
 #include <sstream>
 #include <cstring>
 #include <regex>
 #include <set>
 #include <cassert>
 #include <vector>
-#include <vector>
 #include <fstream>
 #include <random>
 #include <climits>
@@ -14,6 +14,7 @@
 #include <openssl/md5.h>
 #include <openssl/rand.h>
 #include <openssl/crypto.h>
+#include <openssl/evp.h>
 #include <openssl/hmac.h>
 #include <time.h>
 #include <stdlib.h>
@@ -59,20 +60,6 @@ namespace minerva
 
     static const char hex_chars_lc[] = "0123456789abcdef";
 
-    // Constant-time comparison to prevent timing attacks
-    static bool secure_compare(const std::vector<char>& a, const std::vector<char>& b)
-    {
-        if (a.size() != b.size()) {
-            return false;
-        }
-        
-        volatile unsigned char result = 0;
-        for (size_t i = 0; i < a.size(); i++) {
-            result |= (a[i] ^ b[i]);
-        }
-        return result == 0;
-    }
-
     // Constant-time string comparison to prevent timing attacks
     static bool secure_compare_strings(const std::string& a, const std::string& b)
     {
@@ -129,213 +116,6 @@ namespace minerva
         memcpy(buf, str, p_buf_end - str);
     }
 
-    // Helper function to parse digest key-value pairs
-    static bool parse_digest_keyvalue(const std::string& digest_str, std::map<std::string, std::string>& params) {
-        std::stringstream ss(digest_str);
-        std::string part;
-        
-        // Skip the initial part (should be eaten by caller)
-        while (std::getline(ss, part, ',')) {
-            // Trim whitespace
-            part.erase(0, part.find_first_not_of(" \t"));
-            part.erase(part.find_last_not_of(" \t") + 1);
-            
-            if (part.empty()) continue;
-            
-            // Find the '=' separator
-            size_t pos = part.find('=');
-            if (pos == std::string::npos || pos == 0 || pos == part.size() - 1) {
-                continue; // Skip malformed parts
-            }
-            
-            std::string key = part.substr(0, pos);
-            std::string value = part.substr(pos + 1);
-            
-            // Trim key and value
-            key.erase(0, key.find_first_not_of(" \t"));
-            key.erase(key.find_last_not_of(" \t") + 1);
-            value.erase(0, value.find_first_not_of(" \t"));
-            value.erase(value.find_last_not_of(" \t") + 1);
-            
-            // Remove quotes from value if present
-            if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
-                value = value.substr(1, value.size() - 2);
-            }
-            
-            params[key] = value;
-        }
-        
-        return true;
-    }
-
-    static void buffer_append_uint_hex(std::stringstream & str,
-                                       unsigned int value) {
-        unsigned int shift = 0;
-
-        {
-            unsigned int copy = value;
-            do {
-                copy >>= 8;
-                shift += 8; /* counting bits */
-            } while (0 != copy);
-        }
-
-        while (shift > 0) {
-            shift -= 4;
-            str << hex_chars_lc[(value >> shift) & 0x0F];
-        }
-    }
-
-    static bool digest_mutate_sha256(http_auth_digest_type algo,
-                                     const std::string & digest,
-                                     const std::string & method,
-                                     const std::string & uri,
-                                     const std::string & nonce,
-                                     const std::string & cnonce,
-                                     const std::string & nc,
-                                     const std::string & qop,
-                                     std::vector<char> & dig)
-    {
-        SHA256_CTX ctx;
-        char a1[HTTP_AUTH_DIGEST_SHA256_BINLEN*2+1];
-        char a2[HTTP_AUTH_DIGEST_SHA256_BINLEN*2+1];
-        char digest_a[HTTP_AUTH_DIGEST_SHA256_BINLEN];
-
-        if (digest.size() != HTTP_AUTH_DIGEST_SHA256_BINLEN*2)
-        {
-            LOG_WARN("invalid sha256 digest length: " << digest.size());
-            return false;
-        }
-        std::memcpy(a1, digest.data(), HTTP_AUTH_DIGEST_SHA256_BINLEN*2);
-        a1[HTTP_AUTH_DIGEST_SHA256_BINLEN*2] = '\0';
-
-        /* calculate H(A2) */
-        SHA256_Init(&ctx);
-        SHA256_Update(&ctx, (unsigned char *)method.c_str(), method.size());
-        SHA256_Update(&ctx, CONST_STR_LEN(":"));
-        SHA256_Update(&ctx, (unsigned char *)uri.c_str(), uri.size());
-        SHA256_Final((unsigned char *)digest_a, &ctx);
-        tohex(a2, sizeof(a2), (const char *)digest_a, sizeof(digest_a));
-
-        /* calculate response */
-        SHA256_Init(&ctx);
-        SHA256_Update(&ctx, (unsigned char *)a1, sizeof(a1)-1);
-        SHA256_Update(&ctx, CONST_STR_LEN(":"));
-        SHA256_Update(&ctx, (unsigned char *)nonce.c_str(), nonce.size());
-        SHA256_Update(&ctx, CONST_STR_LEN(":"));
-        if (!qop.empty()) {
-            SHA256_Update(&ctx, (unsigned char *)nc.c_str(), nc.size());
-            SHA256_Update(&ctx, CONST_STR_LEN(":"));
-            SHA256_Update(&ctx, (unsigned char *)cnonce.c_str(), cnonce.size());
-            SHA256_Update(&ctx, CONST_STR_LEN(":"));
-            SHA256_Update(&ctx, (unsigned char *)qop.c_str(), qop.size());
-            SHA256_Update(&ctx, CONST_STR_LEN(":"));
-        }
-        SHA256_Update(&ctx, (unsigned char *)a2, sizeof(a2)-1);
-        SHA256_Final((unsigned char *)digest_a, &ctx);
-
-        std::copy(&digest_a[0], &digest_a[0] + HTTP_AUTH_DIGEST_SHA256_BINLEN,
-                  std::back_inserter(dig));
-        return true;
-    }
-
-    static void digest_mutate_sha256(http_auth_digest_type algo,
-                                     const std::string & username,
-                                     const std::string & realm,
-                                     const std::string & password,
-                                     const std::string & method,
-                                     const std::string & uri,
-                                     const std::string & nonce,
-                                     const std::string & cnonce,
-                                     const std::string & nc,
-                                     const std::string & qop,
-                                     std::vector<char> & dig)
-    {
-        SHA256_CTX ctx;
-        char a1[HTTP_AUTH_DIGEST_SHA256_BINLEN*2+1];
-
-        char digest[HTTP_AUTH_DIGEST_SHA256_BINLEN];
-
-        SHA256_Init(&ctx);
-        SHA256_Update(&ctx, username.c_str(), username.size());
-        SHA256_Update(&ctx, CONST_STR_LEN(":"));
-        SHA256_Update(&ctx, realm.c_str(), realm.size());
-        SHA256_Update(&ctx, CONST_STR_LEN(":"));
-        SHA256_Update(&ctx, password.c_str(), password.size());
-        SHA256_Final((unsigned char *)digest, &ctx);
-
-        if (algo & HTTP_AUTH_DIGEST_SESS)
-        {
-            SHA256_Init(&ctx);
-            tohex(a1, sizeof(a1), (const char *)digest, sizeof(digest));
-            SHA256_Update(&ctx, (unsigned char *)a1, sizeof(a1)-1);
-            SHA256_Update(&ctx, CONST_STR_LEN(":"));
-            SHA256_Update(&ctx, (unsigned char *)nonce.c_str(), nonce.size());
-            SHA256_Update(&ctx, CONST_STR_LEN(":"));
-            SHA256_Update(&ctx, (unsigned char *)cnonce.c_str(), cnonce.size());
-            SHA256_Final((unsigned char *)digest, &ctx);
-        }
-    
-        tohex(a1, sizeof(a1), digest, sizeof(digest));
-
-        (void)digest_mutate_sha256(algo, std::string(a1), method, uri,
-                                   nonce, cnonce, nc, qop, dig);
-    }
-
-    static bool digest_mutate_md5(http_auth_digest_type algo,
-                                  const std::string & digest,
-                                  const std::string & method,
-                                  const std::string & uri,
-                                  const std::string & nonce,
-                                  const std::string & cnonce,
-                                  const std::string & nc,
-                                  const std::string & qop,
-                                  std::vector<char> & dig)
-    {
-        MD5_CTX ctx;
-        char a1[HTTP_AUTH_DIGEST_MD5_BINLEN*2+1];
-        char a2[HTTP_AUTH_DIGEST_MD5_BINLEN*2+1];
-        char digest_a[HTTP_AUTH_DIGEST_MD5_BINLEN];
-
-        if (digest.size() != HTTP_AUTH_DIGEST_MD5_BINLEN*2)
-        {
-            LOG_WARN("invalid md5 digest length: " << digest.size());
-            return false;
-        }
-        std::memcpy(a1, digest.data(), HTTP_AUTH_DIGEST_MD5_BINLEN*2);
-        a1[HTTP_AUTH_DIGEST_MD5_BINLEN*2] = '\0';
-
-        /* calculate H(A2) */
-        MD5_Init(&ctx);
-        MD5_Update(&ctx, (unsigned char *)method.c_str(), method.size());
-        MD5_Update(&ctx, CONST_STR_LEN(":"));
-        MD5_Update(&ctx, (unsigned char *)uri.c_str(), uri.size());
-        MD5_Final((unsigned char *)digest_a, &ctx);
-        tohex(a2, sizeof(a2), digest_a, sizeof(digest_a));
-
-        /* calculate response */
-        MD5_Init(&ctx);
-        MD5_Update(&ctx, (unsigned char *)a1, sizeof(a1)-1);
-        MD5_Update(&ctx, CONST_STR_LEN(":"));
-        MD5_Update(&ctx, (unsigned char *)nonce.c_str(), nonce.size());
-        MD5_Update(&ctx, CONST_STR_LEN(":"));
-        if (!qop.empty())
-        {
-            MD5_Update(&ctx, (unsigned char *)nc.c_str(), nc.size());
-            MD5_Update(&ctx, CONST_STR_LEN(":"));
-            MD5_Update(&ctx, (unsigned char *)cnonce.c_str(), cnonce.size());
-            MD5_Update(&ctx, CONST_STR_LEN(":"));
-            MD5_Update(&ctx, (unsigned char *)qop.c_str(), qop.size());
-            MD5_Update(&ctx, CONST_STR_LEN(":"));
-        }
-        MD5_Update(&ctx, (unsigned char *)a2, sizeof(a2)-1);
-        MD5_Final((unsigned char *)digest_a, &ctx);
-
-        std::copy(&digest_a[0], &digest_a[0] + HTTP_AUTH_DIGEST_MD5_BINLEN,
-                  std::back_inserter(dig));
-        return true;
-    }
-
     std::string digest_hash_md5(const std::string & username,
                                 const std::string & realm,
                                 const std::string & password)
@@ -380,85 +160,7 @@ namespace minerva
         return std::string(a1);
     }
 
-    static void digest_mutate_md5(http_auth_digest_type algo,
-                                  const std::string & username,
-                                  const std::string & realm,
-                                  const std::string & password,
-                                  const std::string & method,
-                                  const std::string & uri,
-                                  const std::string & nonce,
-                                  const std::string & cnonce,
-                                  const std::string & nc,
-                                  const std::string & qop,
-                                  std::vector<char> & dig)
-    {
-        MD5_CTX ctx;
-        char a1[HTTP_AUTH_DIGEST_MD5_BINLEN*2+1];
-        char a2[HTTP_AUTH_DIGEST_MD5_BINLEN*2+1];
-
-        char digest[HTTP_AUTH_DIGEST_MD5_BINLEN];
-
-        MD5_Init(&ctx);
-        MD5_Update(&ctx, username.c_str(), username.size());
-        MD5_Update(&ctx, CONST_STR_LEN(":"));
-        MD5_Update(&ctx, realm.c_str(), realm.size());
-        MD5_Update(&ctx, CONST_STR_LEN(":"));
-        MD5_Update(&ctx, password.c_str(), password.size());
-        MD5_Final((unsigned char *)digest, &ctx);
-
-        if (algo & HTTP_AUTH_DIGEST_SESS) {
-            MD5_Init(&ctx);
-            /* http://www.rfc-editor.org/errata_search.php?rfc=2617
-             * Errata ID: 1649 */
-            tohex(a1, sizeof(a1), digest, sizeof(digest));
-            MD5_Update(&ctx, (unsigned char *)a1, sizeof(a1)-1);
-            MD5_Update(&ctx, CONST_STR_LEN(":"));
-            MD5_Update(&ctx, (unsigned char *)nonce.c_str(), nonce.size());
-            MD5_Update(&ctx, CONST_STR_LEN(":"));
-            MD5_Update(&ctx, (unsigned char *)cnonce.c_str(), cnonce.size());
-            MD5_Final((unsigned char *)digest, &ctx);
-        }
-
-        tohex(a1, sizeof(a1), digest, sizeof(digest));
-
-        (void)digest_mutate_md5(algo, std::string(a1), 
-                                method, uri, nonce, cnonce, nc, qop, dig);
-    }
-
-    static bool digest_hex2bin(const std::string & hexstr, std::vector<char> & bin)
-    {
-        // Require exact length: 32 hex chars -> 16 bytes (MD5),
-        // or 64 hex chars -> 32 bytes (SHA-256). Odd-length is invalid.
-        if ((hexstr.size() & 1u) != 0u)
-        {
-            return false;
-        }
-        if (hexstr.size() != (bin.size() << 1))
-        {
-            return false;
-        }
-
-        for (int i = 0, ilen = (int)hexstr.size(); i < ilen; i+=2) {
-            int hi = (unsigned char)hexstr[i];
-            int lo = (unsigned char)hexstr[i+1];
-            if ('0' <= hi && hi <= '9')
-                hi -= '0';
-            else if ((hi |= 0x20), 'a' <= hi && hi <= 'f')
-                hi += -'a' + 10;
-            else
-                return false;
-            if ('0' <= lo && lo <= '9')
-                lo -= '0';
-            else if ((lo |= 0x20), 'a' <= lo && lo <= 'f')
-                lo += -'a' + 10;
-            else
-                return false;
-            bin[(i >> 1)] = (unsigned char)((hi << 4) | lo);
-        }
-        return true;
-    }
-
-    static bool digest_algorithm_parse(const std::string & s,
+    static bool digest_algorithm_parse(std::string_view s,
                                        http_auth_digest_type & dalgo,
                                        int & dlen) {
         if (s.empty()) {
@@ -506,6 +208,207 @@ namespace minerva
         return false;
     }
 
+    // The Digest Authorization fields we use, as views into the header.
+    // Quoted values lose their quotes; backslash escapes are skipped over
+    // but left in place, as no field we check can contain one.
+    struct digest_fields
+    {
+        std::string_view username;
+        std::string_view realm;
+        std::string_view nonce;
+        std::string_view uri;
+        std::string_view qop;
+        std::string_view cnonce;
+        std::string_view nc;
+        std::string_view response;
+        std::string_view algorithm;
+    };
+
+    static bool equals_nocase(std::string_view a, const char * b)
+    {
+        size_t i = 0;
+        for (; i < a.size() && b[i]; ++i)
+        {
+            if ((a[i] | 0x20) != b[i])
+            {
+                return false;
+            }
+        }
+        return i == a.size() && !b[i];
+    }
+
+    // Single pass over the comma-separated auth-params after "Digest".
+    // Unknown and malformed params are skipped; only an unterminated
+    // quoted string fails the parse.
+    static bool parse_digest_fields(std::string_view s, digest_fields & f)
+    {
+        static const struct
+        {
+            const char * name;
+            std::string_view digest_fields::* field;
+        } known[] = {
+            {"username",  &digest_fields::username},
+            {"realm",     &digest_fields::realm},
+            {"nonce",     &digest_fields::nonce},
+            {"uri",       &digest_fields::uri},
+            {"qop",       &digest_fields::qop},
+            {"cnonce",    &digest_fields::cnonce},
+            {"nc",        &digest_fields::nc},
+            {"response",  &digest_fields::response},
+            {"algorithm", &digest_fields::algorithm},
+        };
+        auto is_space = [](char c) { return c == ' ' || c == '\t'; };
+
+        size_t i = 0;
+        const size_t n = s.size();
+        while (i < n)
+        {
+            while (i < n && (is_space(s[i]) || s[i] == ','))
+            {
+                ++i;
+            }
+            const size_t key_start = i;
+            while (i < n && s[i] != '=' && s[i] != ',' && !is_space(s[i]))
+            {
+                ++i;
+            }
+            const std::string_view key = s.substr(key_start, i - key_start);
+            while (i < n && is_space(s[i]))
+            {
+                ++i;
+            }
+            if (i >= n || s[i] != '=')
+            {
+                while (i < n && s[i] != ',')
+                {
+                    ++i;
+                }
+                continue;
+            }
+            ++i;
+            while (i < n && is_space(s[i]))
+            {
+                ++i;
+            }
+
+            std::string_view value;
+            if (i < n && s[i] == '"')
+            {
+                const size_t start = ++i;
+                while (i < n && s[i] != '"')
+                {
+                    i += (s[i] == '\\' && i + 1 < n) ? 2 : 1;
+                }
+                if (i >= n)
+                {
+                    return false;
+                }
+                value = s.substr(start, i - start);
+                ++i;
+            }
+            else
+            {
+                const size_t start = i;
+                while (i < n && s[i] != ',')
+                {
+                    ++i;
+                }
+                size_t end = i;
+                while (end > start && is_space(s[end - 1]))
+                {
+                    --end;
+                }
+                value = s.substr(start, end - start);
+            }
+
+            for (const auto & k : known)
+            {
+                if (equals_nocase(key, k.name))
+                {
+                    f.*k.field = value;
+                    break;
+                }
+            }
+        }
+        return true;
+    }
+
+    // One reusable digest context per thread.
+    struct thread_md_ctx
+    {
+        EVP_MD_CTX * ctx = EVP_MD_CTX_new();
+
+        ~thread_md_ctx()
+        {
+            EVP_MD_CTX_free(ctx);
+        }
+    };
+
+    static thread_local thread_md_ctx t_md;
+
+    // Computes the expected response into out (EVP_MD_size(md) bytes) from
+    // the stored hex H(user:realm:password), feeding every piece straight
+    // into the digest.  With sess, H(A1) is first rehashed with the nonce
+    // and cnonce (RFC 7616 §3.4.2).
+    static bool digest_response(const EVP_MD * md, bool sess,
+                                std::string_view ha1_hex,
+                                std::string_view method,
+                                const digest_fields & f,
+                                unsigned char * out)
+    {
+        EVP_MD_CTX * ctx = t_md.ctx;
+        const size_t len = static_cast<size_t>(EVP_MD_size(md));
+        if (!ctx || ha1_hex.size() != len * 2)
+        {
+            return false;
+        }
+
+        auto update = [ctx](std::string_view v) {
+            return EVP_DigestUpdate(ctx, v.data(), v.size()) == 1;
+        };
+        unsigned char bin[EVP_MAX_MD_SIZE];
+        char ha1[EVP_MAX_MD_SIZE * 2 + 1];
+        char ha2[EVP_MAX_MD_SIZE * 2 + 1];
+
+        std::string_view a1 = ha1_hex;
+        if (sess)
+        {
+            if (EVP_DigestInit_ex(ctx, md, nullptr) != 1 ||
+                !update(ha1_hex) || !update(":") || !update(f.nonce) ||
+                !update(":") || !update(f.cnonce) ||
+                EVP_DigestFinal_ex(ctx, bin, nullptr) != 1)
+            {
+                return false;
+            }
+            tohex(ha1, sizeof(ha1), reinterpret_cast<const char *>(bin), len);
+            a1 = std::string_view(ha1, len * 2);
+        }
+
+        // H(A2) = H(method:uri)
+        if (EVP_DigestInit_ex(ctx, md, nullptr) != 1 ||
+            !update(method) || !update(":") || !update(f.uri) ||
+            EVP_DigestFinal_ex(ctx, bin, nullptr) != 1)
+        {
+            return false;
+        }
+        tohex(ha2, sizeof(ha2), reinterpret_cast<const char *>(bin), len);
+
+        // KD(H(A1), nonce[:nc:cnonce:qop]:H(A2))
+        if (EVP_DigestInit_ex(ctx, md, nullptr) != 1 ||
+            !update(a1) || !update(":") || !update(f.nonce) || !update(":"))
+        {
+            return false;
+        }
+        if (!f.qop.empty() &&
+            (!update(f.nc) || !update(":") || !update(f.cnonce) ||
+             !update(":") || !update(f.qop) || !update(":")))
+        {
+            return false;
+        }
+        return update(std::string_view(ha2, len * 2)) &&
+               EVP_DigestFinal_ex(ctx, out, nullptr) == 1;
+    }
+
     static void set_digest_auth_header(http_context & ctx,
                                        const std::string & realm,
                                        http_auth_nonce_store & store,
@@ -539,8 +442,101 @@ namespace minerva
 
     // ---- http_auth_nonce_store ------------------------------------------
 
-    http_auth_nonce_store::http_auth_nonce_store()
+    namespace
+    {
+        // Key IDs for nonce stores and Basic caches alike.
+        std::atomic<uint64_t> s_hmac_key_ids{0};
+
+        // One HMAC context per thread, keyed for whichever store used it
+        // last; re-keying only happens when a thread switches stores.
+        struct thread_hmac
+        {
+            HMAC_CTX * ctx    = HMAC_CTX_new();
+            uint64_t   key_id = 0;
+
+            ~thread_hmac()
+            {
+                HMAC_CTX_free(ctx);
+            }
+
+            // Readies ctx for a new MAC under the key key_id names.
+            bool begin(uint64_t id, const unsigned char * secret, size_t len)
+            {
+                if (!ctx)
+                {
+                    return false;
+                }
+                // With a null key and digest, HMAC_Init_ex() resets the
+                // context to the key it already holds.
+                const bool rekey = key_id != id;
+                if (HMAC_Init_ex(ctx,
+                                 rekey ? secret : nullptr,
+                                 rekey ? static_cast<int>(len) : 0,
+                                 rekey ? EVP_sha256() : nullptr,
+                                 nullptr) != 1)
+                {
+                    key_id = 0;
+                    return false;
+                }
+                key_id = id;
+                return true;
+            }
+        };
+
+        thread_local thread_hmac t_hmac;
+        // Separate from t_hmac so a thread serving both Digest and Basic
+        // requests does not re-key on every switch.
+        thread_local thread_hmac t_basic_hmac;
+
+        int hex_digit(char c)
+        {
+            if (c >= '0' && c <= '9') return c - '0';
+            if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+            return -1;
+        }
+
+        // Parses exactly n hex digits; false on any other character.
+        template<typename T>
+        bool parse_hex(const char * s, size_t n, T & value)
+        {
+            value = 0;
+            for (size_t i = 0; i < n; ++i)
+            {
+                const int d = hex_digit(s[i]);
+                if (d < 0)
+                {
+                    return false;
+                }
+                value = static_cast<T>((value << 4) | static_cast<T>(d));
+            }
+            return true;
+        }
+
+        void put_be(unsigned char * p, uint64_t v, int bytes)
+        {
+            for (int i = bytes - 1; i >= 0; --i)
+            {
+                p[i] = static_cast<unsigned char>(v);
+                v >>= 8;
+            }
+        }
+
+        constexpr size_t NONCE_TS_HEX  = 8;
+        constexpr size_t NONCE_SEQ_HEX = 16;
+        constexpr size_t NONCE_MAC_HEX = 64;
+        constexpr size_t NONCE_LEN = NONCE_TS_HEX + 1 + NONCE_SEQ_HEX + 1 +
+                                     NONCE_MAC_HEX;
+    }
+
+    http_auth_nonce_store::http_auth_nonce_store() :
+        m_key_id(++s_hmac_key_ids),
+        m_shards(new shard[SHARDS])
     {
+        for (size_t i = 0; i < SHARDS; ++i)
+        {
+            name_lock(m_shards[i].lock, "nonce_store");
+        }
         if (RAND_bytes(m_secret, sizeof(m_secret)) != 1)
         {
             // RAND_bytes failure is exceedingly unlikely but is fatal for
@@ -550,195 +546,179 @@ namespace minerva
         }
     }
 
-    std::string http_auth_nonce_store::compute_mac_hex(
-        const std::string & ts_hex,
-        const std::string & client_ip,
-        const std::string & realm) const
+    bool http_auth_nonce_store::compute_mac(uint32_t ts, uint64_t seq,
+                                            const std::string & client_ip,
+                                            const std::string & realm,
+                                            unsigned char mac[32]) const
     {
-        unsigned char mac[EVP_MAX_MD_SIZE];
-        unsigned int mac_len = 0;
-
-        std::string buf;
-        buf.reserve(ts_hex.size() + client_ip.size() + realm.size() + 2);
-        buf.append(ts_hex);
-        buf.push_back(':');
-        buf.append(client_ip);
-        buf.push_back(':');
-        buf.append(realm);
-
-        if (HMAC(EVP_sha256(), m_secret, sizeof(m_secret),
-                 reinterpret_cast<const unsigned char *>(buf.data()),
-                 buf.size(),
-                 mac, &mac_len) == nullptr || mac_len == 0)
+        thread_hmac & h = t_hmac;
+        if (!h.begin(m_key_id, m_secret, sizeof(m_secret)))
         {
-            return std::string();
+            return false;
         }
 
-        char hex[EVP_MAX_MD_SIZE * 2 + 1];
-        tohex(hex, sizeof(hex),
-              reinterpret_cast<const char *>(mac), mac_len);
-        return std::string(hex, mac_len * 2);
+        // ts, seq, then each string behind its length, so no choice of
+        // client_ip and realm can collide with another.
+        unsigned char fixed[4 + 8 + 4 + 4];
+        put_be(fixed, ts, 4);
+        put_be(fixed + 4, seq, 8);
+        put_be(fixed + 12, client_ip.size(), 4);
+        put_be(fixed + 16, realm.size(), 4);
+
+        unsigned int mac_len = 0;
+        return HMAC_Update(h.ctx, fixed, sizeof(fixed)) == 1 &&
+               HMAC_Update(h.ctx,
+                           reinterpret_cast<const unsigned char *>(client_ip.data()),
+                           client_ip.size()) == 1 &&
+               HMAC_Update(h.ctx,
+                           reinterpret_cast<const unsigned char *>(realm.data()),
+                           realm.size()) == 1 &&
+               HMAC_Final(h.ctx, mac, &mac_len) == 1 &&
+               mac_len == 32;
     }
 
-    void http_auth_nonce_store::prune_locked(std::time_t now)
+    void http_auth_nonce_store::prune_locked(shard & s, std::time_t now)
     {
-        // Drop any state at the front of the FIFO that has expired.
-        while (!m_order.empty())
+        // Whole buckets whose window has passed; every ID in them has
+        // expired.
+        while (!s.buckets.empty() && s.buckets.front().end <= now)
         {
-            auto it = m_state.find(m_order.front());
-            if (it == m_state.end())
-            {
-                m_order.pop_front();
-                continue;
-            }
-            if (it->second.second > now)
+            const bucket & b = s.buckets.front();
+            for (size_t i = b.head; i < b.ids.size(); ++i)
             {
-                break;
+                s.state.erase(b.ids[i]);
             }
-            m_state.erase(it);
-            m_order.pop_front();
+            s.buckets.pop_front();
         }
-        // Hard cap: drop oldest until under the limit.
-        while (m_order.size() > m_max_entries)
+
+        // Hard cap: drop oldest until under the shard's share.
+        const size_t cap = std::max<size_t>(m_max_entries / SHARDS, 1);
+        while (s.state.size() > cap && !s.buckets.empty())
         {
-            m_state.erase(m_order.front());
-            m_order.pop_front();
+            bucket & b = s.buckets.front();
+            if (b.head == b.ids.size())
+            {
+                s.buckets.pop_front();
+                continue;
+            }
+            s.state.erase(b.ids[b.head++]);
         }
     }
 
     std::string http_auth_nonce_store::issue(const std::string & client_ip,
                                              const std::string & realm)
     {
-        std::time_t now = std::time(nullptr);
+        const std::time_t now = std::time(nullptr);
+        const uint32_t ts = static_cast<uint32_t>(now);
+        const uint64_t seq = m_seq.fetch_add(1, std::memory_order_relaxed);
 
-        std::stringstream ts_ss;
-        buffer_append_uint_hex(ts_ss, static_cast<unsigned int>(now));
-        std::string ts_hex = ts_ss.str();
-
-        std::string mac_hex = compute_mac_hex(ts_hex, client_ip, realm);
-        if (mac_hex.empty())
+        unsigned char mac[32];
+        if (!compute_mac(ts, seq, client_ip, realm, mac))
         {
             return std::string();
         }
 
-        std::string nonce = ts_hex + ":" + mac_hex;
+        char buf[NONCE_LEN + 1];
+        snprintf(buf, sizeof(buf), "%08x:%016llx:", ts,
+                 static_cast<unsigned long long>(seq));
+        tohex(buf + NONCE_TS_HEX + 1 + NONCE_SEQ_HEX + 1, NONCE_MAC_HEX + 1,
+              reinterpret_cast<const char *>(mac), sizeof(mac));
+
+        nonce_id id;
+        memcpy(id.data(), mac, id.size());
+        const std::time_t expires = now + m_max_age;
+        const std::time_t end = (expires / BUCKET_SECONDS + 1) * BUCKET_SECONDS;
 
-        std::lock_guard<std::mutex> lk(m_lock);
-        prune_locked(now);
+        shard & s = shard_for(id);
+        std::lock_guard<instrumented_mutex> lk(s.lock);
+        prune_locked(s, now);
         // Track the nonce with no nc usage yet.
-        if (m_state.emplace(nonce,
-                            std::make_pair(0ul, now + m_max_age)).second)
+        if (s.state.emplace(id, nonce_state{0, expires}).second)
         {
-            m_order.push_back(nonce);
+            // A shortened max age can file an ID in a later bucket than
+            // its own; it is then pruned a little late, never early.
+            if (s.buckets.empty() || s.buckets.back().end < end)
+            {
+                s.buckets.push_back(bucket{end, {}, 0});
+            }
+            s.buckets.back().ids.push_back(id);
         }
-        return nonce;
+        return std::string(buf, NONCE_LEN);
     }
 
     http_auth_nonce_store::validate_result
-    http_auth_nonce_store::validate(const std::string & nonce,
-                                    const std::string & nc_hex,
+    http_auth_nonce_store::validate(std::string_view nonce,
+                                    std::string_view nc_hex,
                                     const std::string & client_ip,
                                     const std::string & realm)
     {
-        // Split nonce into ts:mac.
-        size_t colon = nonce.find(':');
-        if (colon == std::string::npos ||
-            colon == 0 ||
-            colon == nonce.size() - 1)
-        {
-            return validate_result::INVALID;
-        }
-        std::string ts_hex = nonce.substr(0, colon);
-        std::string mac_hex = nonce.substr(colon + 1);
-
-        // Sanity bounds before crypto.
-        if (ts_hex.size() > 16 || mac_hex.size() != 64)
+        // Fixed layout: ts:seq:mac.
+        const char * p = nonce.data();
+        uint32_t ts = 0;
+        uint64_t seq = 0;
+        unsigned char mac[32];
+        if (nonce.size() != NONCE_LEN ||
+            p[NONCE_TS_HEX] != ':' ||
+            p[NONCE_TS_HEX + 1 + NONCE_SEQ_HEX] != ':' ||
+            !parse_hex(p, NONCE_TS_HEX, ts) ||
+            !parse_hex(p + NONCE_TS_HEX + 1, NONCE_SEQ_HEX, seq))
         {
             return validate_result::INVALID;
         }
-        for (char c : ts_hex)
-        {
-            if (!std::isxdigit(static_cast<unsigned char>(c)))
-            {
-                return validate_result::INVALID;
-            }
-        }
-        for (char c : mac_hex)
+        const char * mac_hex = p + NONCE_TS_HEX + 1 + NONCE_SEQ_HEX + 1;
+        for (size_t i = 0; i < sizeof(mac); ++i)
         {
-            if (!std::isxdigit(static_cast<unsigned char>(c)))
+            if (!parse_hex(mac_hex + 2 * i, 2, mac[i]))
             {
                 return validate_result::INVALID;
             }
         }
 
         // Recompute and constant-time compare.
-        std::string expected_mac = compute_mac_hex(ts_hex, client_ip, realm);
-        if (expected_mac.size() != mac_hex.size() ||
-            !secure_compare_strings(expected_mac, mac_hex))
+        unsigned char expected[32];
+        if (!compute_mac(ts, seq, client_ip, realm, expected) ||
+            CRYPTO_memcmp(expected, mac, sizeof(mac)) != 0)
         {
             return validate_result::INVALID;
         }
 
-        // Parse timestamp and check window.
-        unsigned long long ts_val = 0;
-        try
-        {
-            ts_val = std::stoull(ts_hex, nullptr, 16);
-        }
-        catch (const std::exception &)
-        {
-            return validate_result::INVALID;
-        }
-        std::time_t ts = static_cast<std::time_t>(ts_val);
-        std::time_t now = std::time(nullptr);
-        if (now < ts || (now - ts) > m_max_age)
+        // Check the window.
+        const std::time_t issued = static_cast<std::time_t>(ts);
+        const std::time_t now = std::time(nullptr);
+        if (now < issued || (now - issued) > m_max_age)
         {
             return validate_result::STALE;
         }
 
         // Parse nc if provided.
         unsigned long nc = 0;
-        bool have_nc = !nc_hex.empty();
+        const bool have_nc = !nc_hex.empty();
         if (have_nc)
         {
-            if (nc_hex.size() > 8)
-            {
-                return validate_result::INVALID;
-            }
-            for (char c : nc_hex)
-            {
-                if (!std::isxdigit(static_cast<unsigned char>(c)))
-                {
-                    return validate_result::INVALID;
-                }
-            }
-            try
-            {
-                nc = std::stoul(nc_hex, nullptr, 16);
-            }
-            catch (const std::exception &)
-            {
-                return validate_result::INVALID;
-            }
-            if (nc == 0)
+            if (nc_hex.size() > 8 ||
+                !parse_hex(nc_hex.data(), nc_hex.size(), nc) ||
+                nc == 0)
             {
                 return validate_result::INVALID;
             }
         }
 
         // Replay check.
-        std::lock_guard<std::mutex> lk(m_lock);
-        prune_locked(now);
-
-        auto it = m_state.find(nonce);
-        if (it == m_state.end())
+        nonce_id id;
+        memcpy(id.data(), mac, id.size());
+        shard & s = shard_for(id);
+        std::lock_guard<instrumented_mutex> lk(s.lock);
+        prune_locked(s, now);
+
+        auto it = s.state.find(id);
+        if (it == s.state.end() || it->second.expires < now)
         {
             // Not a nonce we issued (or it was pruned). Treat as stale so the
             // client retries with a fresh challenge transparently.
             return validate_result::STALE;
         }
 
-        unsigned long & last_nc = it->second.first;
+        unsigned long & last_nc = it->second.last_nc;
         if (have_nc)
         {
             if (nc <= last_nc)
@@ -759,6 +739,140 @@ namespace minerva
         return validate_result::OK;
     }
 
+    // ---- http_auth_basic_cache ------------------------------------------
+
+    static int64_t monotonic_ns()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    http_auth_basic_cache::http_auth_basic_cache(size_t capacity) :
+        m_key_id(++s_hmac_key_ids),
+        m_sets(std::max<size_t>(capacity / (SHARDS * WAYS), 1)),
+        m_shards(new shard[SHARDS])
+    {
+        if (RAND_bytes(m_secret, sizeof(m_secret)) != 1)
+        {
+            FATAL("RAND_bytes failed when seeding HTTP basic auth cache secret");
+        }
+        for (size_t i = 0; i < SHARDS; ++i)
+        {
+            name_lock(m_shards[i].lock, "basic_auth_cache");
+            m_shards[i].entries.reset(new entry[m_sets * WAYS]);
+        }
+    }
+
+    bool http_auth_basic_cache::make_key(std::string_view realm,
+                                         std::string_view credentials,
+                                         key_type & key) const
+    {
+        thread_hmac & h = t_basic_hmac;
+        if (!h.begin(m_key_id, m_secret, sizeof(m_secret)))
+        {
+            return false;
+        }
+        unsigned int len = 0;
+        return
+            HMAC_Update(h.ctx, reinterpret_cast<const unsigned char *>(realm.data()),
+                        realm.size()) == 1 &&
+            HMAC_Update(h.ctx, reinterpret_cast<const unsigned char *>(":"), 1) == 1 &&
+            HMAC_Update(h.ctx, reinterpret_cast<const unsigned char *>(credentials.data()),
+                        credentials.size()) == 1 &&
+            HMAC_Final(h.ctx, key.data(), &len) == 1 &&
+            len == KEY_LEN;
+    }
+
+    http_auth_basic_cache::entry *
+    http_auth_basic_cache::set_for(const key_type & key, shard *& s) const
+    {
+        // The key is a keyed MAC, so its bytes are as good as a hash and
+        // reveal nothing about the credentials.
+        uint64_t h = 0;
+        memcpy(&h, key.data(), sizeof(h));
+        s = &m_shards[h % SHARDS];
+        return &s->entries[((h / SHARDS) % m_sets) * WAYS];
+    }
+
+    bool http_auth_basic_cache::find(const key_type & key, uint64_t generation,
+                                     std::string & user)
+    {
+        const int64_t now = monotonic_ns();
+        shard * s = nullptr;
+        entry * set = set_for(key, s);
+
+        const entry * found = nullptr;
+        {
+            std::lock_guard<instrumented_mutex> lk(s->lock);
+            // Every way is compared, in constant time, whether or not an
+            // earlier one matched.
+            for (size_t w = 0; w < WAYS; ++w)
+            {
+                const entry & e = set[w];
+                const bool match =
+                    CRYPTO_memcmp(e.key.data(), key.data(), KEY_LEN) == 0;
+                if (match && e.expires_ns > now && e.generation == generation)
+                {
+                    found = &e;
+                }
+            }
+            if (found)
+            {
+                user = found->user;
+            }
+        }
+
+        (found ? m_hits : m_misses).fetch_add(1, std::memory_order_relaxed);
+        return found != nullptr;
+    }
+
+    void http_auth_basic_cache::insert(const key_type & key, uint64_t generation,
+                                       const std::string & user)
+    {
+        const int64_t ttl = m_ttl_ns.load(std::memory_order_relaxed);
+        if (ttl == 0)
+        {
+            return;
+        }
+        const int64_t now = monotonic_ns();
+        shard * s = nullptr;
+        entry * set = set_for(key, s);
+
+        std::lock_guard<instrumented_mutex> lk(s->lock);
+        // Reuse the key's own slot if present, else the way closest to
+        // expiry (an empty or expired way is always closest).
+        entry * victim = &set[0];
+        for (size_t w = 0; w < WAYS; ++w)
+        {
+            if (CRYPTO_memcmp(set[w].key.data(), key.data(), KEY_LEN) == 0)
+            {
+                victim = &set[w];
+                break;
+            }
+            if (set[w].expires_ns < victim->expires_ns)
+            {
+                victim = &set[w];
+            }
+        }
+        victim->key        = key;
+        victim->generation = generation;
+        victim->expires_ns = now + ttl;
+        victim->user       = user;
+    }
+
+    void http_auth_basic_cache::clear()
+    {
+        for (size_t i = 0; i < SHARDS; ++i)
+        {
+            std::lock_guard<instrumented_mutex> lk(m_shards[i].lock);
+            for (size_t j = 0; j < m_sets * WAYS; ++j)
+            {
+                m_shards[i].entries[j] = entry();
+            }
+        }
+    }
+
     bool authenticate_digest(http_context & ctx,
                              const std::string & authHdr,
                              const std::string & in_realm,
@@ -766,81 +880,62 @@ namespace minerva
                              http_auth_nonce_store & nonce_store,
                              std::string & user)
     {
-        std::stringstream ss(authHdr);
-    
-        std::string part;
-    
+        std::string_view hdr(authHdr);
+        const size_t scheme_start = hdr.find_first_not_of(" \t");
+        hdr.remove_prefix(std::min(scheme_start, hdr.size()));
+
         // get digest header
-        ss >> part;
-        if (part != DIGEST_HDR)
+        const size_t scheme_len = strlen(DIGEST_HDR);
+        if (hdr.compare(0, scheme_len, DIGEST_HDR) != 0 ||
+            (hdr.size() > scheme_len && hdr[scheme_len] != ' ' &&
+             hdr[scheme_len] != '\t'))
         {
             LOG_DEBUG("Not a digest auth header");
             set_digest_auth_header(ctx, in_realm, nonce_store);
             return false;
         }
+        hdr.remove_prefix(scheme_len);
 
-        // Get remaining authorization header content for parsing
-        std::string digest_params_str;
-        std::getline(ss, digest_params_str);
-
-        // Parse digest parameters using helper function
-        std::map<std::string, std::string> digest_params;
-        if (!parse_digest_keyvalue(digest_params_str, digest_params))
+        digest_fields f;
+        if (!parse_digest_fields(hdr, f))
         {
             LOG_WARN("failed to parse digest parameters");
             set_digest_auth_header(ctx, in_realm, nonce_store);
             return false;
         }
 
-        // Extract required parameters
-        const std::string& username = digest_params["username"];
-        const std::string& realm = digest_params["realm"];
-        const std::string& nonce = digest_params["nonce"];
-        const std::string& uri = digest_params["uri"];
-        const std::string& qop = digest_params["qop"];
-        const std::string& cnonce = digest_params["cnonce"];
-        const std::string& nc = digest_params["nc"];
-        const std::string& response = digest_params["response"];
-        const std::string& algorithm = digest_params["algorithm"];
-
         // Parse algorithm if specified
         http_auth_digest_type algo = HTTP_AUTH_DIGEST_NONE;
         int algo_len = 0;
-        if (!algorithm.empty() && !digest_algorithm_parse(algorithm, algo, algo_len))
+        if (!f.algorithm.empty() && !digest_algorithm_parse(f.algorithm, algo, algo_len))
         {
-            LOG_WARN("unsupported algorithm: " << algorithm);
+            LOG_WARN("unsupported algorithm: " << f.algorithm);
             set_digest_auth_header(ctx, in_realm, nonce_store);
             return false;
         }
 
-        if (username.empty() ||
-            realm.empty() ||
-            nonce.empty() ||
-            uri.empty() ||
-            (!qop.empty() && (nc.empty() || cnonce.empty())) ||
-            response.empty())
+        if (f.username.empty() ||
+            f.realm.empty() ||
+            f.nonce.empty() ||
+            f.uri.empty() ||
+            (!f.qop.empty() && (f.nc.empty() || f.cnonce.empty())) ||
+            f.response.empty())
         {
             LOG_WARN("missing digest field");
             set_digest_auth_header(ctx, in_realm, nonce_store);
             return false;
         }
 
-        bool found_user = false;
-
-        http_auth_user entry;
-        if (db.find_user(username, entry))
-        {
-            found_user = true;
-        }
-
-        if (!found_user)
+        const std::string username(f.username);
+        const auto entry = db.lookup_user(username);
+        if (!entry)
         {
             LOG_WARN("invalid digest user: " << username);
             set_digest_auth_header(ctx, in_realm, nonce_store);
             return false;
         }
 
-        if (algorithm.empty())
+        if (f.algorithm.empty())
         {
             algo = HTTP_AUTH_DIGEST_MD5;
             algo_len = HTTP_AUTH_DIGEST_MD5_BINLEN;
@@ -849,110 +944,88 @@ namespace minerva
         if (!(algo & ~HTTP_AUTH_DIGEST_SESS))
         {
             LOG_WARN("missing digest algorithm");
-            set_digest_auth_header(ctx, entry.realm(), nonce_store);
+            set_digest_auth_header(ctx, entry->realm(), nonce_store);
             return false;
         }
 
-        if ((algo & HTTP_AUTH_DIGEST_SESS) && (nonce.empty() || cnonce.empty()))
+        if ((algo & HTTP_AUTH_DIGEST_SESS) && f.cnonce.empty())
         {
-            LOG_WARN("missing digest algorithm field: " << algorithm);
-            set_digest_auth_header(ctx, entry.realm(), nonce_store);
+            LOG_WARN("missing digest algorithm field: " << f.algorithm);
+            set_digest_auth_header(ctx, entry->realm(), nonce_store);
             return false;
         }
 
-        if (realm != entry.realm())
+        if (f.realm != entry->realm())
         {
-            LOG_WARN("invalid realm: " << realm << " expected: " << entry.realm());
-            set_digest_auth_header(ctx, entry.realm(), nonce_store);
+            LOG_WARN("invalid realm: " << f.realm << " expected: " << entry->realm());
+            set_digest_auth_header(ctx, entry->realm(), nonce_store);
             return false;
         }
 
-        std::vector<char> rdigest;
-        rdigest.resize(algo_len);
-
-        if (!digest_hex2bin(response, rdigest))
+        unsigned char rdigest[HTTP_AUTH_DIGEST_SHA256_BINLEN];
+        bool response_ok = f.response.size() == static_cast<size_t>(algo_len) * 2;
+        for (int i = 0; response_ok && i < algo_len; ++i)
         {
-            LOG_WARN("invalid digest response: " << response);
-            set_digest_auth_header(ctx, entry.realm(), nonce_store);
+            response_ok = parse_hex(f.response.data() + 2 * i, 2, rdigest[i]);
+        }
+        if (!response_ok)
+        {
+            LOG_WARN("invalid digest response: " << f.response);
+            set_digest_auth_header(ctx, entry->realm(), nonce_store);
             return false;
         }
 
-        if (!qop.empty() && qop == "auth-int")
+        if (f.qop == "auth-int")
         {
-            LOG_WARN("unsupported digest qop: " << qop);
-            set_digest_auth_header(ctx, entry.realm(), nonce_store);
+            LOG_WARN("unsupported digest qop: " << f.qop);
+            set_digest_auth_header(ctx, entry->realm(), nonce_store);
             return false;
         }
 
-        std::vector<char> digest;
-        bool digest_ok = false;
-
+        const EVP_MD * md = nullptr;
+        const std::string * user_hash = nullptr;
+        const char * algo_name = nullptr;
         if (algo & HTTP_AUTH_DIGEST_MD5)
         {
-            const std::string & user_hash = entry.hash_md5();
-            if (user_hash.empty())
-            {
-                LOG_WARN("user '" << username
-                         << "' has no MD5 credential for digest auth");
-                set_digest_auth_header(ctx, entry.realm(), nonce_store);
-                return false;
-            }
-            digest_ok = digest_mutate_md5(algo,
-                                          user_hash,
-                                          ctx.request().method_as_string(),
-                                          uri,
-                                          nonce,
-                                          cnonce,
-                                          nc,
-                                          qop,
-                                          digest);
+            md = EVP_md5();
+            user_hash = &entry->hash_md5();
+            algo_name = "MD5";
         }
         else if (algo & HTTP_AUTH_DIGEST_SHA256)
         {
-            const std::string & user_hash = entry.hash_sha256();
-            if (user_hash.empty())
-            {
-                LOG_WARN("user '" << username
-                         << "' has no SHA-256 credential for digest auth");
-                set_digest_auth_header(ctx, entry.realm(), nonce_store);
-                return false;
-            }
-            digest_ok = digest_mutate_sha256(algo,
-                                             user_hash,
-                                             ctx.request().method_as_string(),
-                                             uri,
-                                             nonce,
-                                             cnonce,
-                                             nc,
-                                             qop,
-                                             digest);
+            md = EVP_sha256();
+            user_hash = &entry->hash_sha256();
+            algo_name = "SHA-256";
         }
         else
         {
             LOG_WARN("unsupported digest algorithm: " << algo);
-            set_digest_auth_header(ctx, entry.realm(), nonce_store);
+            set_digest_auth_header(ctx, entry->realm(), nonce_store);
             return false;
         }
 
-        if (!digest_ok)
+        if (user_hash->empty())
         {
-            LOG_WARN("digest computation failed for user: " << username);
-            set_digest_auth_header(ctx, entry.realm(), nonce_store);
+            LOG_WARN("user '" << username << "' has no " << algo_name
+                     << " credential for digest auth");
+            set_digest_auth_header(ctx, entry->realm(), nonce_store);
             return false;
         }
 
-        if (rdigest.size() != digest.size())
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        if (!digest_response(md, (algo & HTTP_AUTH_DIGEST_SESS) != 0, *user_hash,
+                             ctx.request().method_as_string(), f, digest))
         {
-            LOG_WARN("invalid digest size: " << rdigest.size());
-            set_digest_auth_header(ctx, entry.realm(), nonce_store);
+            LOG_WARN("digest computation failed for user: " << username);
+            set_digest_auth_header(ctx, entry->realm(), nonce_store);
             return false;
         }
 
         // Use constant-time comparison to prevent timing attacks
-        if (!secure_compare(rdigest, digest))
+        if (CRYPTO_memcmp(rdigest, digest, algo_len) != 0)
         {
-            LOG_WARN("invalid digest password for user: " << username);
-            set_digest_auth_header(ctx, entry.realm(), nonce_store);
+            LOG_WARN_RATELIMITED(1000, "invalid digest password for user: " << username);
+            set_digest_auth_header(ctx, entry->realm(), nonce_store);
             return false;
         }
 
@@ -960,24 +1033,24 @@ namespace minerva
         // enforce nonce-count replay protection. Done after the password
         // check so an attacker cannot probe nonce state without knowing the
         // password.
-        auto nv = nonce_store.validate(nonce, nc, ctx.client_ip(),
-                                       entry.realm());
+        auto nv = nonce_store.validate(f.nonce, f.nc, ctx.client_ip(),
+                                       entry->realm());
         switch (nv)
         {
         case http_auth_nonce_store::validate_result::OK:
             break;
         case http_auth_nonce_store::validate_result::STALE:
             LOG_DEBUG("stale nonce for user: " << username);
-            set_digest_auth_header(ctx, entry.realm(), nonce_store, true);
+            set_digest_auth_header(ctx, entry->realm(), nonce_store, true);
             return false;
         case http_auth_nonce_store::validate_result::REPLAY:
-            LOG_WARN("replayed digest nonce for user: " << username);
-            set_digest_auth_header(ctx, entry.realm(), nonce_store);
+            LOG_WARN_RATELIMITED(1000, "replayed digest nonce for user: " << username);
+            set_digest_auth_header(ctx, entry->realm(), nonce_store);
             return false;
         case http_auth_nonce_store::validate_result::INVALID:
         default:
-            LOG_WARN("invalid digest nonce for user: " << username);
-            set_digest_auth_header(ctx, entry.realm(), nonce_store);
+            LOG_WARN_RATELIMITED(1000, "invalid digest nonce for user: " << username);
+            set_digest_auth_header(ctx, entry->realm(), nonce_store);
             return false;
         }
 
@@ -990,15 +1063,17 @@ namespace minerva
                             const std::string & authHdr,
                             const std::string & realm,
                             http_auth_db & db,
-                            std::string & user)
+                            std::string & user,
+                            http_auth_basic_cache * cache)
     {
-        std::stringstream ss(authHdr);
-    
-        std::string part;
-    
-        // get basic header
-        ss >> part;
-        if (part != BASIC_HDR)
+        // split "<scheme> <credentials>" in place rather than through a
+        // stringstream, which would allocate on every request
+        static const char WS[] = " \t\r\n";
+        std::string_view hdr(authHdr);
+        size_t begin = hdr.find_first_not_of(WS);
+        size_t end = hdr.find_first_of(WS, begin);
+        if (begin == std::string_view::npos ||
+            hdr.substr(begin, end - begin) != BASIC_HDR)
         {
             LOG_DEBUG("Not a basic auth header");
             ctx.response().add_header("WWW-Authenticate", "Basic");
@@ -1006,21 +1081,41 @@ namespace minerva
         }
     
         // get the encoded credentials
-        ss >> part;
+        begin = hdr.find_first_not_of(WS, end);
+        end = hdr.find_first_of(WS, begin);
+        std::string part;
+        if (begin != std::string_view::npos)
+        {
+            part.assign(hdr.substr(begin, end - begin));
+        }
     
         if (part.size() > MAX_BASIC_AUTH_HDR_LEN)
         {
-            LOG_WARN("Encoded basic credentials are longer than allowed");
+            LOG_WARN_RATELIMITED(1000, "Encoded basic credentials are longer than allowed");
             ctx.response().add_header("WWW-Authenticate", "Basic");
             return false;
         }
     
+        // Read the generation before the lookup: a change that lands
+        // after it leaves the entry stamped with a stale generation.
+        const uint64_t generation = db.generation();
+        http_auth_basic_cache::key_type key;
+        if (cache && !cache->make_key(realm, part, key))
+        {
+            cache = nullptr;
+        }
+        if (cache && cache->find(key, generation, user))
+        {
+            secure_zero_string(part);
+            return true;
+        }
+
         // base 64 decode the credentials
         std::string buf;
         // Base64 decode the basic auth string
         if (!from64tobits(part, buf))
         {
-            LOG_ERROR("Failed to base64 decode HTTP Basic auth header");
+            LOG_ERROR_RATELIMITED(1000, "Failed to base64 decode HTTP Basic auth header");
             secure_zero_string(part);
             secure_zero_string(buf);
             ctx.response().add_header("WWW-Authenticate", "Basic");
@@ -1033,7 +1128,7 @@ namespace minerva
         auto pos = buf.find(':');
         if (pos == std::string::npos)
         {
-            LOG_ERROR("Basic credentials not formatted correctly");
+            LOG_ERROR_RATELIMITED(1000, "Basic credentials not formatted correctly");
             secure_zero_string(buf);
             ctx.response().add_header("WWW-Authenticate", "Basic");
             return false;
@@ -1054,11 +1149,10 @@ namespace minerva
         secure_zero_string(pwd);
 
         bool result = false;
-        http_auth_user entry;
-        if (db.find_user(uname, entry))
+        if (const auto entry = db.lookup_user(uname))
         {
             // Use constant-time comparison to prevent timing attacks
-            result = secure_compare_strings(hash, entry.hash());
+            result = secure_compare_strings(hash, entry->hash());
         }
 
         // Clear hash from memory after use
@@ -1067,6 +1161,10 @@ namespace minerva
         if (!result) {
             ctx.response().add_header("WWW-Authenticate", "Basic");
         }
+        else if (cache)
+        {
+            cache->insert(key, generation, uname);
+        }
 
         return result;
     }
@@ -1,10 +1,18 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include <string_view>
+#include <memory>
 #include <mutex>
 #include <unordered_map>
+#include <vector>
 #include <deque>
 #include <ctime>
+#include <util/instrumented_mutex.h>
 #include "http_context.h"
 #include "http_request.h"
 
@@ -39,28 +47,28 @@ namespace minerva
         ~http_auth_user() = default;
         http_auth_user(const http_auth_user & user) = default;
 
-        std::string user() const
+        const std::string & user() const
         {
             return m_user;
         }
 
-        std::string realm() const
+        const std::string & realm() const
         {
             return m_realm;
         }
 
         // Backwards-compatible accessor; equivalent to hash_md5().
-        std::string hash() const
+        const std::string & hash() const
         {
             return m_hash_md5;
         }
 
-        std::string hash_md5() const
+        const std::string & hash_md5() const
         {
             return m_hash_md5;
         }
 
-        std::string hash_sha256() const
+        const std::string & hash_sha256() const
         {
             return m_hash_sha256;
         }
@@ -92,25 +100,152 @@ namespace minerva
         virtual bool find_user(const std::string & username,
                                http_auth_user & user) = 0;
 
+        // The user's entry without copying it where the implementation can
+        // share it; null if there is no such user.  The default wraps
+        // find_user().
+        virtual std::shared_ptr<const http_auth_user>
+        lookup_user(const std::string & username)
+        {
+            auto user = std::make_shared<http_auth_user>();
+            if (!find_user(username, *user))
+            {
+                return nullptr;
+            }
+            return user;
+        }
+
+        // Changes whenever a user is added, changed or removed, or the
+        // table is reloaded.  Anything verified against an older
+        // generation must be verified again.
+        uint64_t generation() const
+        {
+            return m_generation.load(std::memory_order_acquire);
+        }
+
+    protected:
+        // Implementations call this after each change to the user table.
+        void bump_generation()
+        {
+            m_generation.fetch_add(1, std::memory_order_acq_rel);
+        }
+
     private:
         std::string m_realm;
+        std::atomic<uint64_t> m_generation{0};
+    };
+
+    // Bounded cache of verified Basic credentials, so a client that sends
+    // the same Authorization header on every request skips the base64
+    // decode, the user lookup and the password hash.
+    //
+    // Entries are keyed by HMAC-SHA256(process secret, realm ":" encoded
+    // credentials); the credentials themselves are never stored.  An entry
+    // holds only for the auth db generation it was verified under and for
+    // ttl_seconds().  The table is split into shards, each a small
+    // set-associative array under its own lock; a full set evicts the
+    // entry closest to expiry.  Only successful verifications are cached,
+    // so a wrong password always pays the full check.
+    class http_auth_basic_cache
+    {
+    public:
+        static constexpr size_t KEY_LEN          = 32;
+        static constexpr size_t SHARDS           = 16;
+        static constexpr size_t WAYS             = 4;
+        static constexpr size_t DEFAULT_CAPACITY = 1024;
+        static constexpr int    DEFAULT_TTL      = 30;  // seconds
+
+        typedef std::array<unsigned char, KEY_LEN> key_type;
+
+        explicit http_auth_basic_cache(size_t capacity = DEFAULT_CAPACITY);
+
+        http_auth_basic_cache(const http_auth_basic_cache &)             = delete;
+        http_auth_basic_cache & operator=(const http_auth_basic_cache &) = delete;
+
+        // False only if the HMAC could not be computed.
+        bool make_key(std::string_view realm, std::string_view credentials,
+                      key_type & key) const;
+
+        bool find(const key_type & key, uint64_t generation, std::string & user);
+
+        void insert(const key_type & key, uint64_t generation,
+                    const std::string & user);
+
+        void clear();
+
+        // 0 disables the cache.
+        void ttl_seconds(int seconds)
+        {
+            m_ttl_ns.store(static_cast<int64_t>(seconds > 0 ? seconds : 0) *
+                           1000000000, std::memory_order_relaxed);
+        }
+
+        uint64_t hits() const
+        {
+            return m_hits.load(std::memory_order_relaxed);
+        }
+
+        uint64_t misses() const
+        {
+            return m_misses.load(std::memory_order_relaxed);
+        }
+
+    private:
+        struct entry
+        {
+            key_type    key{};
+            uint64_t    generation = 0;
+            int64_t     expires_ns = 0;   // 0: empty
+            std::string user;
+        };
+
+        struct shard
+        {
+            instrumented_mutex lock;
+            std::unique_ptr<entry[]> entries;
+        };
+
+        // First entry of the key's set within its shard.
+        entry * set_for(const key_type & key, shard *& s) const;
+
+        unsigned char             m_secret[32];
+        // Names m_secret to the keyed per-thread HMAC context, as in
+        // http_auth_nonce_store.
+        uint64_t                  m_key_id;
+        size_t                    m_sets;       // per shard
+        std::unique_ptr<shard[]>  m_shards;
+        std::atomic<int64_t>      m_ttl_ns{static_cast<int64_t>(DEFAULT_TTL) * 1000000000};
+        std::atomic<uint64_t>     m_hits{0};
+        std::atomic<uint64_t>     m_misses{0};
     };
 
     // Server-side store that issues opaque digest nonces and validates them
     // against the issuing server, including replay protection via the
     // RFC 7616 nonce-count (nc) value.
     //
-    // Nonce wire format:  "<ts_hex>:<hmac_sha256_hex>"
-    //   where hmac is HMAC-SHA256(server_secret, ts_hex || ":" || client_ip
-    //                                              || ":" || realm).
+    // Nonce wire format:  "<ts_hex>:<seq_hex>:<hmac_sha256_hex>"
+    //   where hmac is HMAC-SHA256(server_secret, ts || seq || client_ip ||
+    //   realm), ts and seq in binary and the strings length-prefixed.  seq
+    //   makes every issued nonce distinct.  The first 128 bits of the hmac
+    //   are the nonce's ID in the store.
+    //
+    // State is striped over SHARDS locks by ID; each entry is the ID, the
+    // last nc seen and the expiry, with no strings.  Expiries are filed in
+    // per-shard time buckets, so pruning touches only what has expired.
+    // Each thread keeps its own keyed HMAC_CTX.
     //
     // The server secret is regenerated on construction; on process restart
     // all outstanding nonces become invalid (clients re-auth automatically).
     class http_auth_nonce_store
     {
     public:
+        static constexpr size_t SHARDS         = 16;
+        static constexpr int    BUCKET_SECONDS = 8;
+
         http_auth_nonce_store();
 
+        http_auth_nonce_store(const http_auth_nonce_store &)             = delete;
+        http_auth_nonce_store & operator=(const http_auth_nonce_store &) = delete;
+
         // Issue a fresh nonce bound to (client_ip, realm).
         std::string issue(const std::string & client_ip,
                           const std::string & realm);
@@ -125,30 +260,68 @@ namespace minerva
 
         // Validate a client-supplied nonce. nc_hex may be empty if the client
         // did not send a qop/nc pair.
-        validate_result validate(const std::string & nonce,
-                                 const std::string & nc_hex,
+        validate_result validate(std::string_view nonce,
+                                 std::string_view nc_hex,
                                  const std::string & client_ip,
                                  const std::string & realm);
 
         void max_age_seconds(int seconds) { m_max_age = seconds; }
 
     private:
-        std::string compute_mac_hex(const std::string & ts_hex,
-                                    const std::string & client_ip,
-                                    const std::string & realm) const;
+        typedef std::array<unsigned char, 16> nonce_id;
+
+        struct nonce_id_hash
+        {
+            size_t operator()(const nonce_id & id) const
+            {
+                // The ID is MAC output, already uniformly distributed.
+                size_t h;
+                memcpy(&h, id.data(), sizeof(h));
+                return h;
+            }
+        };
+
+        struct nonce_state
+        {
+            unsigned long last_nc;  // 0: unused; 1 after a use without nc
+            std::time_t   expires;
+        };
+
+        // IDs whose nonces expire before `end`, oldest first.
+        struct bucket
+        {
+            std::time_t           end;
+            std::vector<nonce_id> ids;
+            size_t                head = 0;
+        };
+
+        struct shard
+        {
+            instrumented_mutex lock;
+            std::unordered_map<nonce_id, nonce_state, nonce_id_hash> state;
+            std::deque<bucket> buckets;
+        };
+
+        bool compute_mac(uint32_t ts, uint64_t seq,
+                         const std::string & client_ip,
+                         const std::string & realm,
+                         unsigned char mac[32]) const;
+
+        shard & shard_for(const nonce_id & id)
+        {
+            return m_shards[id[15] % SHARDS];
+        }
 
-        void prune_locked(std::time_t now);
+        void prune_locked(shard & s, std::time_t now);
 
         unsigned char m_secret[32];
+        // Distinguishes this store's keyed per-thread HMAC contexts from
+        // those of any other store, including one at the same address.
+        uint64_t m_key_id;
         int m_max_age = 300;          // 5 minutes
-        size_t m_max_entries = 4096;
-        std::mutex m_lock;
-        // nonce -> (last_nc_seen, expire_ts).  last_nc_seen == 0 means never
-        // used with a qop/nc; for nonces without qop, we set last_nc_seen=1
-        // on first use to flag the nonce as consumed.
-        std::unordered_map<std::string,
-                           std::pair<unsigned long, std::time_t>> m_state;
-        std::deque<std::string> m_order;
+        size_t m_max_entries = 4096;  // split evenly across the shards
+        std::atomic<uint64_t> m_seq{0};
+        std::unique_ptr<shard[]> m_shards;
     };
 
     constexpr const char * AUTH_HDR = "Authorization";
@@ -157,11 +330,14 @@ namespace minerva
     constexpr const char * AUTHENTICATE_HDR = "WWW-Authenticate";
     constexpr const char * AWS4_HDR = "AWS4-HMAC-SHA256";
 
+    // cache, if given, is consulted before and filled after a successful
+    // verification.
     bool authenticate_basic(http_context & ctx,
                             const std::string & authHdr,
                             const std::string & realm,
                             http_auth_db & db,
-                            std::string & user);
+                            std::string & user,
+                            http_auth_basic_cache * cache = nullptr);
 
     bool authenticate_digest(http_context & ctx,
                              const std::string & authHdr,
@@ -48,7 +48,7 @@ namespace minerva
         }
     }
 
-    http_content_type::code http_content_type::parse(const std::string & contentType)
+    http_content_type::code http_content_type::parse(std::string_view contentType)
     {
         if (contentType == CONTENT_TYPE_TEXT_PLAIN_TEXT)
         {
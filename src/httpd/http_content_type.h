@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 
 namespace minerva
 {
@@ -66,7 +67,7 @@ namespace minerva
         constexpr static char CONTENT_TYPE_APPLICATION_ZIP_TEXT [] = 
             "application/zip";
 
-        static code parse(const std::string & contentType);
+        static code parse(std::string_view contentType);
 
         static const char * get_content_type_string(code code);
 
@@ -1,12 +1,18 @@
 #pragma once
 
+#include <array>
+#include <chrono>
+#include <cstdint>
 #include <cstring>
 #include <functional>
 #include <memory>
 #include <sys/socket.h>
+#include <time.h>
 #include <netinet/in.h>
 #include <util/time_utils.h>
 #include <optional>
+#include <string_view>
+#include <vector>
 #include <util/connection.h>
 #include "http_request.h"
 #include "http_response.h"
@@ -17,6 +23,38 @@ namespace minerva
     {
     public:
 
+        // Phase boundaries of a request, in the order they are reached.
+        // ACCEPTED and HANDSHAKE are only set on a connection's first
+        // request; for a kept-alive connection ACCEPTED is when the idle
+        // socket turned readable.
+        enum PHASE
+        {
+            ACCEPTED,
+            HANDSHAKE,
+            DISPATCHED,
+            HEADER,
+            AUTHENTICATED,
+            HANDLED,
+            SENT,
+            PHASE_COUNT
+        };
+
+        // Name of the interval that ends at phase p.
+        static const char * phase_name(PHASE p)
+        {
+            static const char * names[PHASE_COUNT] = {
+                "accept", "handshake", "queue", "header",
+                "auth", "handler", "send"
+            };
+            return names[p];
+        }
+
+        static int64_t now_ns()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
         http_context(std::shared_ptr<connection> conn, std::function<bool()> sdCb)
         : m_request(*this), m_response(*this), m_conn(conn), m_timer(),
           m_sd_cb(sdCb)
@@ -32,7 +70,38 @@ namespace minerva
         http_context(http_context &&)                  = delete;
         http_context & operator=(http_context &&)      = delete;
 
-        std::optional<std::function<void()>> post_command() const
+        // Prepares a pooled context for the next request on conn; every
+        // per-request field returns to its default while the request and
+        // response keep their buffers.
+        void reset(std::shared_ptr<connection> conn)
+        {
+            m_request.reset();
+            m_response.reset();
+            m_conn = std::move(conn);
+            m_username.clear();
+            m_client_ip.clear();
+            std::memset(&m_client_addr, 0, sizeof(m_client_addr));
+            m_client_addr_len = 0;
+            m_timeout_msecs = DEFAULT_TIMEOUT;
+            m_timer.start();
+            m_post_command.reset();
+            m_phases.fill(0);
+            m_cpu_start_ns = -1;
+            m_routed_handler = nullptr;
+            m_routed_operation = nullptr;
+            m_cpu_us = -1;
+            m_header_buf.clear();
+        }
+
+        // Drops the connection once the request is done, so a pooled
+        // context does not keep the socket open.
+        void release()
+        {
+            m_conn.reset();
+            m_post_command.reset();
+        }
+
+        const std::optional<std::function<void()>> & post_command() const
         {
             return m_post_command;
         }
@@ -44,12 +113,17 @@ namespace minerva
             m_client_addr_len = addr_len;
         }
 
-        void client_ip(const std::string & ip)
+        const struct sockaddr_storage & client_addr() const
+        {
+            return m_client_addr;
+        }
+
+        void client_ip(std::string_view ip)
         {
-            m_client_ip = ip;
+            m_client_ip.assign(ip);
         }
 
-        std::string client_ip() const
+        const std::string & client_ip() const
         {
             return m_client_ip;
         }
@@ -66,6 +140,24 @@ namespace minerva
             return m_username;
         }
 
+        // Handler httpd resolved for this request, and the registered
+        // operation name it passes to controller::handle_request().
+        void route(const route_table::handler * fn, const std::string * operation)
+        {
+            m_routed_handler   = fn;
+            m_routed_operation = operation;
+        }
+
+        const route_table::handler * routed_handler() const
+        {
+            return m_routed_handler;
+        }
+
+        const std::string * routed_operation() const
+        {
+            return m_routed_operation;
+        }
+
         void post_command(const std::optional<std::function<void()>> & cmd)
         {
             m_post_command = cmd;
@@ -81,6 +173,12 @@ namespace minerva
             return m_response;
         }
 
+        // Receive buffer for the request header, reused across requests.
+        std::vector<char> & header_buffer()
+        {
+            return m_header_buf;
+        }
+
         connection * conn() const
         {
             return m_conn.get();
@@ -106,11 +204,85 @@ namespace minerva
             return m_timer.get_elapsed_milliseconds();
         }
 
+        long long get_elapsed_microseconds() const
+        {
+            return static_cast<long long>(m_timer.get_elapsed_time() * 1e6);
+        }
+
         bool timed_out() const
         {
             return m_timer.get_elapsed_milliseconds() > m_timeout_msecs;
         }
 
+        // Records a steady-clock timestamp for phase p.
+        void mark_phase(PHASE p)
+        {
+            m_phases[p] = now_ns();
+        }
+
+        void mark_phase(PHASE p, int64_t ns)
+        {
+            m_phases[p] = ns;
+        }
+
+        // Timestamp of phase p in steady-clock nanoseconds, 0 if unset.
+        int64_t phase_ns(PHASE p) const
+        {
+            return m_phases[p];
+        }
+
+        // Microseconds from DISPATCHED to phase p; -1 if either is unset.
+        long long phase_us(PHASE p) const
+        {
+            if (m_phases[p] == 0 || m_phases[DISPATCHED] == 0)
+            {
+                return -1;
+            }
+            return (m_phases[p] - m_phases[DISPATCHED]) / 1000;
+        }
+
+        // Microseconds from ACCEPTED to phase p, so accept, handshake and
+        // queue wait are included; falls back to DISPATCHED when the
+        // request was dispatched without an accept stamp.
+        long long elapsed_us(PHASE p) const
+        {
+            const int64_t start = m_phases[ACCEPTED] ? m_phases[ACCEPTED]
+                                                     : m_phases[DISPATCHED];
+            if (m_phases[p] == 0 || start == 0)
+            {
+                return -1;
+            }
+            return (m_phases[p] - start) / 1000;
+        }
+
+        // Per-request CPU accounting on the handler thread. cpu_us() is the
+        // thread CPU time from start_cpu_accounting() to its own first call,
+        // which fixes the value; -1 if accounting was not started.
+        void start_cpu_accounting()
+        {
+            m_cpu_start_ns = thread_cpu_ns();
+        }
+
+        long long cpu_us()
+        {
+            if (m_cpu_start_ns < 0)
+            {
+                return -1;
+            }
+            if (m_cpu_us < 0)
+            {
+                m_cpu_us = (thread_cpu_ns() - m_cpu_start_ns) / 1000;
+            }
+            return m_cpu_us;
+        }
+
+        static int64_t thread_cpu_ns()
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+            return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+        }
+
     private:
         const int DEFAULT_TIMEOUT = 60000;
         http_request m_request;
@@ -124,6 +296,12 @@ namespace minerva
         minerva::timer m_timer;
         std::function<bool()> m_sd_cb;
         std::optional<std::function<void()>> m_post_command;
+        std::array<int64_t, PHASE_COUNT> m_phases{};
+        int64_t m_cpu_start_ns = -1;
+        const route_table::handler * m_routed_handler = nullptr;
+        const std::string * m_routed_operation = nullptr;
+        long long m_cpu_us = -1;
+        std::vector<char> m_header_buf;
 
     };
 }
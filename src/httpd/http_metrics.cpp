@@ -0,0 +1,471 @@
+#include <sstream>
+#include <jsoncpp/json/json.h>
+#include <util/json_utils.h>
+#include "http_metrics.h"
+
+namespace minerva
+{
+    namespace
+    {
+        // Prometheus bucket bounds, in microseconds.
+        constexpr uint64_t BUCKET_BOUNDS_US[] = {
+            100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+            100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000
+        };
+
+        constexpr const char * STATUS_CLASSES[] = {
+            "other", "1xx", "2xx", "3xx", "4xx", "5xx"
+        };
+
+        size_t op_hash(std::string_view controller, std::string_view operation)
+        {
+            uint64_t h = 14695981039346656037ULL;
+            for (char c : controller)
+            {
+                h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+            }
+            h = (h ^ '/') * 1099511628211ULL;
+            for (char c : operation)
+            {
+                h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ULL;
+            }
+            return static_cast<size_t>(h);
+        }
+
+        bool op_matches(const http_metrics::op_stats * op,
+                        std::string_view controller,
+                        std::string_view operation)
+        {
+            return op->controller == controller && op->operation == operation;
+        }
+
+        void write_label_value(std::ostream & os, std::string_view v)
+        {
+            for (char c : v)
+            {
+                switch (c)
+                {
+                case '\\': os << "\\\\"; break;
+                case '"':  os << "\\\""; break;
+                case '\n': os << "\\n";  break;
+                default:   os << c;
+                }
+            }
+        }
+
+        void write_labels(std::ostream & os, const http_metrics::op_stats & op)
+        {
+            os << "controller=\"";
+            write_label_value(os, op.controller);
+            os << "\",operation=\"";
+            write_label_value(os, op.operation);
+            os << '"';
+        }
+
+        void write_histogram(std::ostream & os, const char * name,
+                             const std::string & labels,
+                             const latency_histogram::snapshot & snap)
+        {
+            const char * sep = labels.empty() ? "" : ",";
+            for (uint64_t bound : BUCKET_BOUNDS_US)
+            {
+                os << name << "_bucket{" << labels << sep << "le=\""
+                   << bound / 1e6 << "\"} " << snap.count_at_or_below(bound)
+                   << '\n';
+            }
+            os << name << "_bucket{" << labels << sep << "le=\"+Inf\"} "
+               << snap.count << '\n';
+            os << name << "_sum";
+            if (!labels.empty())
+            {
+                os << '{' << labels << '}';
+            }
+            os << ' ' << snap.sum / 1e6 << '\n';
+            os << name << "_count";
+            if (!labels.empty())
+            {
+                os << '{' << labels << '}';
+            }
+            os << ' ' << snap.count << '\n';
+        }
+
+        Json::Value histogram_json(const latency_histogram & h)
+        {
+            latency_histogram::snapshot snap;
+            h.take_snapshot(snap);
+
+            Json::Value v(Json::objectValue);
+            v["count"]   = Json::UInt64(snap.count);
+            v["mean_us"] = Json::UInt64(snap.count ? snap.sum / snap.count : 0);
+            v["p50_us"]  = Json::UInt64(snap.percentile(0.5));
+            v["p90_us"]  = Json::UInt64(snap.percentile(0.9));
+            v["p99_us"]  = Json::UInt64(snap.percentile(0.99));
+            v["p999_us"] = Json::UInt64(snap.percentile(0.999));
+            v["max_us"]  = Json::UInt64(snap.max);
+            return v;
+        }
+    }
+
+    http_metrics::http_metrics() : m_overflow("*", "*")
+    {
+    }
+
+    http_metrics::~http_metrics()
+    {
+        for (auto & slot : m_ops)
+        {
+            delete slot.load();
+        }
+    }
+
+    http_metrics::op_stats * http_metrics::op(std::string_view controller,
+                                              std::string_view operation)
+    {
+        const size_t start = op_hash(controller, operation);
+        for (size_t i = 0; i < OP_TABLE_SIZE; ++i)
+        {
+            const size_t slot = (start + i) % OP_TABLE_SIZE;
+            op_stats * cur = m_ops[slot].load(std::memory_order_acquire);
+            if (cur == nullptr)
+            {
+                cur = insert(slot, controller, operation);
+                if (cur == nullptr)
+                {
+                    // Lost the race to an unrelated pair; keep probing.
+                    continue;
+                }
+                return cur;
+            }
+            if (op_matches(cur, controller, operation))
+            {
+                return cur;
+            }
+        }
+        return &m_overflow;
+    }
+
+    http_metrics::op_stats * http_metrics::insert(size_t slot,
+                                                  std::string_view controller,
+                                                  std::string_view operation)
+    {
+        if (m_op_count.load(std::memory_order_relaxed) >= OP_TABLE_SIZE * 3 / 4)
+        {
+            return &m_overflow;
+        }
+
+        auto fresh = std::make_unique<op_stats>(controller, operation);
+        op_stats * expected = nullptr;
+        if (m_ops[slot].compare_exchange_strong(expected, fresh.get(),
+                                                std::memory_order_acq_rel))
+        {
+            m_op_count.fetch_add(1, std::memory_order_relaxed);
+            return fresh.release();
+        }
+        // Someone else filled the slot first; it may be the same pair.
+        return op_matches(expected, controller, operation) ? expected : nullptr;
+    }
+
+    void http_metrics::write_prometheus(std::ostream & os, const gauges & g) const
+    {
+        static const struct
+        {
+            const char * name;
+            const char * help;
+            latency_histogram op_stats::* hist;
+        } histograms[] = {
+            { "minerva_http_request_duration_seconds",
+              "Time from accept (or keep-alive readiness) until the response was sent.",
+              &op_stats::total },
+            { "minerva_http_request_service_seconds",
+              "Time from dispatch to a handler thread until the response was sent.",
+              &op_stats::service },
+            { "minerva_http_time_to_first_byte_seconds",
+              "Time from dispatch until the first response byte was written.",
+              &op_stats::first_byte },
+            { "minerva_http_header_read_seconds",
+              "Time spent reading and parsing the request header.",
+              &op_stats::header },
+            { "minerva_http_handler_seconds",
+              "Time spent inside the controller.",
+              &op_stats::handler },
+            { "minerva_http_request_cpu_seconds",
+              "Handler thread CPU time per request, when accounting is on.",
+              &op_stats::cpu },
+        };
+
+        latency_histogram::snapshot snap;
+        for (auto & h : histograms)
+        {
+            os << "# HELP " << h.name << ' ' << h.help << '\n'
+               << "# TYPE " << h.name << " histogram\n";
+            auto emit = [&](const op_stats & op)
+            {
+                if ((op.*h.hist).count() == 0)
+                {
+                    return;
+                }
+                (op.*h.hist).take_snapshot(snap);
+                std::ostringstream labels;
+                write_labels(labels, op);
+                write_histogram(os, h.name, labels.str(), snap);
+            };
+            for (auto & slot : m_ops)
+            {
+                const op_stats * op = slot.load(std::memory_order_acquire);
+                if (op)
+                {
+                    emit(*op);
+                }
+            }
+            emit(m_overflow);
+        }
+
+        os << "# HELP minerva_http_transport_calls_total Transport read, write and poll calls.\n"
+           << "# TYPE minerva_http_transport_calls_total counter\n";
+        auto emit_calls = [&](const op_stats & op)
+        {
+            if (op.total.count() == 0)
+            {
+                return;
+            }
+            const struct
+            {
+                const char *                  call;
+                const std::atomic<uint64_t> & value;
+            } calls[] = {
+                { "read", op.reads }, { "write", op.writes }, { "poll", op.polls }
+            };
+            for (auto & c : calls)
+            {
+                os << "minerva_http_transport_calls_total{";
+                write_labels(os, op);
+                os << ",call=\"" << c.call << "\"} "
+                   << c.value.load(std::memory_order_relaxed) << '\n';
+            }
+        };
+        for (auto & slot : m_ops)
+        {
+            const op_stats * op = slot.load(std::memory_order_acquire);
+            if (op)
+            {
+                emit_calls(*op);
+            }
+        }
+        emit_calls(m_overflow);
+
+        os << "# HELP minerva_http_responses_total Responses by status class.\n"
+           << "# TYPE minerva_http_responses_total counter\n";
+        for (size_t i = 0; i < m_status.size(); ++i)
+        {
+            os << "minerva_http_responses_total{class=\"" << STATUS_CLASSES[i]
+               << "\"} " << m_status[i].load(std::memory_order_relaxed) << '\n';
+        }
+
+        const struct
+        {
+            const char * name;
+            const char * help;
+            uint64_t     value;
+        } counters[] = {
+            { "minerva_http_received_bytes_total",
+              "Bytes read from clients, headers included.",
+              m_bytes_in.load(std::memory_order_relaxed) },
+            { "minerva_http_sent_bytes_total",
+              "Bytes written to clients, headers included.",
+              m_bytes_out.load(std::memory_order_relaxed) },
+            { "minerva_http_alloc_counted_requests_total",
+              "Requests whose heap allocations were counted.",
+              m_counted_requests.load(std::memory_order_relaxed) },
+            { "minerva_http_request_allocations_total",
+              "Heap allocations made by counted requests on their handler thread.",
+              m_allocations.load(std::memory_order_relaxed) },
+            { "minerva_http_allocating_requests_total",
+              "Counted requests that made at least one heap allocation.",
+              m_allocating_requests.load(std::memory_order_relaxed) },
+            { "minerva_http_connections_accepted_total",
+              "Connections accepted by the listeners.",
+              connections_accepted.load(std::memory_order_relaxed) },
+            { "minerva_http_keepalive_reused_total",
+              "Requests served on a kept-alive connection.",
+              keepalive_reused.load(std::memory_order_relaxed) },
+            { "minerva_http_tls_handshakes_total",
+              "Completed TLS handshakes.",
+              tls_handshakes.load(std::memory_order_relaxed) },
+            { "minerva_http_tls_handshake_failures_total",
+              "TLS handshakes that failed or timed out.",
+              tls_handshake_failures.load(std::memory_order_relaxed) },
+            { "minerva_http_aborted_total",
+              "Requests whose connection was aborted.",
+              aborted.load(std::memory_order_relaxed) },
+            { "minerva_http_shed_queue_total",
+              "Connections answered 503 because the handler queue was full.",
+              g.shed_queue },
+            { "minerva_http_shed_latency_total",
+              "Connections answered 503 because queueing delay stayed above target.",
+              g.shed_latency },
+            { "minerva_http_rate_limited_total",
+              "Requests answered 429 because a client or user rate limit was exhausted.",
+              g.rate_limited },
+            { "minerva_http_rate_limiter_evictions_total",
+              "Rate limiter buckets evicted to make room for another client.",
+              g.rate_limiter_evictions },
+            { "minerva_http_close_forced_total",
+              "Connections closed without linger because too many were closing.",
+              g.close_forced },
+            { "minerva_http_close_timeouts_total",
+              "Lingering closes ended by their time limit.",
+              g.close_timeouts },
+            { "minerva_http_auth_cache_hits_total",
+              "Basic credentials found in the verified-credential cache.",
+              g.auth_cache_hits },
+            { "minerva_http_auth_cache_misses_total",
+              "Basic credentials not in the verified-credential cache.",
+              g.auth_cache_misses },
+        };
+        for (auto & c : counters)
+        {
+            os << "# HELP " << c.name << ' ' << c.help << '\n'
+               << "# TYPE " << c.name << " counter\n"
+               << c.name << ' ' << c.value << '\n';
+        }
+
+        const struct
+        {
+            const char * name;
+            const char * help;
+            uint64_t     value;
+        } gauge_values[] = {
+            { "minerva_http_active_requests",
+              "Requests currently being handled.", g.active_requests },
+            { "minerva_http_pool_queue_depth",
+              "Connections waiting for a handler thread.", g.pool_queue_depth },
+            { "minerva_http_admission_queued",
+              "Admitted connections not yet on a handler thread.", g.admission_queued },
+            { "minerva_http_closing",
+              "Connections in TLS close_notify or lingering close.", g.closing },
+            { "minerva_http_pool_threads",
+              "Handler threads.", g.pool_threads },
+            { "minerva_http_keepalive_idle_connections",
+              "Idle kept-alive connections.", g.keepalive_idle },
+        };
+        for (auto & v : gauge_values)
+        {
+            os << "# HELP " << v.name << ' ' << v.help << '\n'
+               << "# TYPE " << v.name << " gauge\n"
+               << v.name << ' ' << v.value << '\n';
+        }
+
+        os << "# HELP minerva_http_tls_handshake_seconds TLS handshake time.\n"
+           << "# TYPE minerva_http_tls_handshake_seconds histogram\n";
+        tls_handshake_time.take_snapshot(snap);
+        write_histogram(os, "minerva_http_tls_handshake_seconds", "", snap);
+
+        if (g.scheduler_lag)
+        {
+            os << "# HELP minerva_scheduler_lag_seconds Delay between a job's due time and its dispatch.\n"
+               << "# TYPE minerva_scheduler_lag_seconds histogram\n";
+            g.scheduler_lag->take_snapshot(snap);
+            write_histogram(os, "minerva_scheduler_lag_seconds", "", snap);
+        }
+
+        if (g.close_time)
+        {
+            os << "# HELP minerva_http_close_seconds Time from starting a lingering close to releasing the socket.\n"
+               << "# TYPE minerva_http_close_seconds histogram\n";
+            g.close_time->take_snapshot(snap);
+            write_histogram(os, "minerva_http_close_seconds", "", snap);
+        }
+    }
+
+    void http_metrics::write_json(std::ostream & os, const gauges & g) const
+    {
+        Json::Value root(Json::objectValue);
+
+        Json::Value ops(Json::arrayValue);
+        auto add_op = [&](const op_stats & op)
+        {
+            if (op.total.count() == 0 && op.header.count() == 0)
+            {
+                return;
+            }
+            Json::Value v(Json::objectValue);
+            v["controller"] = op.controller;
+            v["operation"]  = op.operation;
+            v["total"]      = histogram_json(op.total);
+            v["service"]    = histogram_json(op.service);
+            v["first_byte"] = histogram_json(op.first_byte);
+            v["header"]     = histogram_json(op.header);
+            v["handler"]    = histogram_json(op.handler);
+            if (op.cpu.count() > 0)
+            {
+                v["cpu"] = histogram_json(op.cpu);
+            }
+            Json::Value calls(Json::objectValue);
+            calls["reads"]  = Json::UInt64(op.reads.load(std::memory_order_relaxed));
+            calls["writes"] = Json::UInt64(op.writes.load(std::memory_order_relaxed));
+            calls["polls"]  = Json::UInt64(op.polls.load(std::memory_order_relaxed));
+            v["transport_calls"] = calls;
+            ops.append(v);
+        };
+        for (auto & slot : m_ops)
+        {
+            const op_stats * op = slot.load(std::memory_order_acquire);
+            if (op)
+            {
+                add_op(*op);
+            }
+        }
+        add_op(m_overflow);
+        root["operations"] = ops;
+
+        Json::Value status(Json::objectValue);
+        for (size_t i = 0; i < m_status.size(); ++i)
+        {
+            status[STATUS_CLASSES[i]] =
+                Json::UInt64(m_status[i].load(std::memory_order_relaxed));
+        }
+        root["responses"] = status;
+
+        Json::Value counters(Json::objectValue);
+        counters["bytes_in"]  = Json::UInt64(m_bytes_in.load(std::memory_order_relaxed));
+        counters["bytes_out"] = Json::UInt64(m_bytes_out.load(std::memory_order_relaxed));
+        counters["alloc_counted_requests"] = Json::UInt64(m_counted_requests.load());
+        counters["request_allocations"]    = Json::UInt64(m_allocations.load());
+        counters["allocating_requests"]    = Json::UInt64(m_allocating_requests.load());
+        counters["connections_accepted"] = Json::UInt64(connections_accepted.load());
+        counters["keepalive_reused"]     = Json::UInt64(keepalive_reused.load());
+        counters["tls_handshakes"]       = Json::UInt64(tls_handshakes.load());
+        counters["tls_handshake_failures"] = Json::UInt64(tls_handshake_failures.load());
+        counters["aborted"]              = Json::UInt64(aborted.load());
+        counters["shed_queue"]           = Json::UInt64(g.shed_queue);
+        counters["shed_latency"]         = Json::UInt64(g.shed_latency);
+        counters["rate_limited"]         = Json::UInt64(g.rate_limited);
+        counters["rate_limiter_evictions"] = Json::UInt64(g.rate_limiter_evictions);
+        counters["close_forced"]         = Json::UInt64(g.close_forced);
+        counters["close_timeouts"]       = Json::UInt64(g.close_timeouts);
+        counters["auth_cache_hits"]      = Json::UInt64(g.auth_cache_hits);
+        counters["auth_cache_misses"]    = Json::UInt64(g.auth_cache_misses);
+        root["counters"] = counters;
+
+        Json::Value gv(Json::objectValue);
+        gv["active_requests"]  = Json::UInt64(g.active_requests);
+        gv["pool_queue_depth"] = Json::UInt64(g.pool_queue_depth);
+        gv["admission_queued"] = Json::UInt64(g.admission_queued);
+        gv["closing"]          = Json::UInt64(g.closing);
+        gv["pool_threads"]     = Json::UInt64(g.pool_threads);
+        gv["keepalive_idle"]   = Json::UInt64(g.keepalive_idle);
+        root["gauges"] = gv;
+
+        root["tls_handshake"] = histogram_json(tls_handshake_time);
+        if (g.scheduler_lag)
+        {
+            root["scheduler_lag"] = histogram_json(*g.scheduler_lag);
+        }
+        if (g.close_time)
+        {
+            root["close"] = histogram_json(*g.close_time);
+        }
+
+        os << to_json_string(root, true) << '\n';
+    }
+}
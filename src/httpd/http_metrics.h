@@ -0,0 +1,143 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <util/histogram.h>
+
+namespace minerva
+{
+    /*
+     * Request metrics for one httpd instance.
+     *
+     * Latencies are kept per controller/operation pair in a fixed-size
+     * open-addressing table that is filled with compare-and-swap, so the
+     * request path never takes a lock. Once the table is three quarters
+     * full, new pairs share a single overflow entry labelled "*". httpd
+     * keys only registered operations, with everything else under
+     * "unmatched", so client chosen paths never take a slot.
+     */
+    class http_metrics
+    {
+    public:
+        struct op_stats
+        {
+            op_stats(std::string_view c, std::string_view o) :
+                controller(c), operation(o)
+            {
+            }
+
+            const std::string controller;
+            const std::string operation;
+            latency_histogram total;        // accept or keep-alive ready .. response sent
+            latency_histogram service;      // dispatch to a handler .. response sent
+            latency_histogram first_byte;   // dispatch .. first response byte written
+            latency_histogram header;       // dispatch .. request header parsed
+            latency_histogram handler;      // inside the controller
+            latency_histogram cpu;          // handler thread CPU, if accounted
+
+            // Transport calls, summed over the operation's requests.
+            std::atomic<uint64_t> reads{0};
+            std::atomic<uint64_t> writes{0};
+            std::atomic<uint64_t> polls{0};
+
+            void transport(uint64_t r, uint64_t w, uint64_t p)
+            {
+                reads.fetch_add(r, std::memory_order_relaxed);
+                writes.fetch_add(w, std::memory_order_relaxed);
+                polls.fetch_add(p, std::memory_order_relaxed);
+            }
+        };
+
+        // Gauges sampled by the caller at export time.
+        struct gauges
+        {
+            uint64_t active_requests  = 0;
+            uint64_t pool_queue_depth = 0;
+            uint64_t pool_threads     = 0;
+            uint64_t keepalive_idle   = 0;
+            // Admission control: connections admitted but not yet on a
+            // handler thread, and those shed, cumulative, by reason.
+            uint64_t admission_queued = 0;
+            uint64_t shed_queue       = 0;
+            uint64_t shed_latency     = 0;
+            // Requests answered 429 by a controller's rate limit, and
+            // clients whose bucket was evicted to make room, cumulative.
+            uint64_t rate_limited           = 0;
+            uint64_t rate_limiter_evictions = 0;
+            // Connections lingering in close, and closes cut short by the
+            // cap or by their linger time, cumulative.
+            uint64_t closing        = 0;
+            uint64_t close_forced   = 0;
+            uint64_t close_timeouts = 0;
+            // Basic auth cache lookups, cumulative.
+            uint64_t auth_cache_hits   = 0;
+            uint64_t auth_cache_misses = 0;
+            const latency_histogram * scheduler_lag = nullptr;
+            const latency_histogram * close_time    = nullptr;
+        };
+
+        static constexpr size_t OP_TABLE_SIZE = 256;
+
+        http_metrics();
+        ~http_metrics();
+
+        http_metrics(const http_metrics &)             = delete;
+        http_metrics & operator=(const http_metrics &) = delete;
+
+        // Entry for the pair, created on first use.
+        op_stats * op(std::string_view controller, std::string_view operation);
+
+        void status(int code)
+        {
+            const size_t cls = code >= 100 && code < 600 ? code / 100 : 0;
+            m_status[cls].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void bytes(uint64_t in, uint64_t out)
+        {
+            m_bytes_in.fetch_add(in, std::memory_order_relaxed);
+            m_bytes_out.fetch_add(out, std::memory_order_relaxed);
+        }
+
+        // Heap allocations one request made on its handler thread.
+        void allocations(uint64_t n)
+        {
+            m_counted_requests.fetch_add(1, std::memory_order_relaxed);
+            if (n)
+            {
+                m_allocations.fetch_add(n, std::memory_order_relaxed);
+                m_allocating_requests.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        std::atomic<uint64_t> connections_accepted{0};
+        std::atomic<uint64_t> keepalive_reused{0};
+        std::atomic<uint64_t> tls_handshakes{0};
+        std::atomic<uint64_t> tls_handshake_failures{0};
+        std::atomic<uint64_t> aborted{0};
+        latency_histogram     tls_handshake_time;
+
+        void write_prometheus(std::ostream & os, const gauges & g) const;
+        void write_json(std::ostream & os, const gauges & g) const;
+
+    private:
+        op_stats * insert(size_t slot, std::string_view controller,
+                          std::string_view operation);
+
+        std::array<std::atomic<op_stats *>, OP_TABLE_SIZE> m_ops{};
+        std::atomic<size_t>   m_op_count{0};
+        op_stats              m_overflow;
+
+        std::array<std::atomic<uint64_t>, 6> m_status{};
+        std::atomic<uint64_t> m_bytes_in{0};
+        std::atomic<uint64_t> m_bytes_out{0};
+        std::atomic<uint64_t> m_counted_requests{0};
+        std::atomic<uint64_t> m_allocations{0};
+        std::atomic<uint64_t> m_allocating_requests{0};
+    };
+}
@@ -1,22 +1,22 @@
 #include <sstream>
 #include <iterator>
-#include <regex>
+#include <charconv>
 #include <cassert>
 #include <algorithm>
-#include <curl/curl.h>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
 #include <util/connection.h>
 #include <util/log.h>
 #include <util/time_utils.h>
 #include <util/string_utils.h>
+#include <util/unique_command.h>
 #include "http_context.h"
 #include "http_request.h"
 
 namespace minerva
 {
 
-    static const char* firstLineRegex = "^(\\S+)\\s+(\\S+)\\s+HTTP/(1\\.0|1\\.1)\r$";
-    static const std::regex kFirstLineRegex(firstLineRegex);
-    static const char* headerRegex = "^(.+):\\s+(.+)\r$";
     static const char* contentLength = "content-length";
     static const char* contentType = "content-type";
     static const char* connectionKey = "connection";
@@ -32,7 +32,7 @@ namespace minerva
     static const size_t MAX_TOTAL_HEADERS_SIZE = 64*1024; // Maximum total header size (64KB)
 
     // Case-insensitive search for the lowercase 'needle' inside 'hay'.
-    static size_t ci_find_lower(const std::string & hay, const char * needle)
+    static size_t ci_find_lower(std::string_view hay, const char * needle)
     {
         std::string lower(hay);
         std::transform(lower.begin(), lower.end(), lower.begin(),
@@ -48,7 +48,7 @@ namespace minerva
     {
         if (hex.empty() || hex.size() > 16)
         {
-            LOG_WARN("invalid chunk header: " << hex);
+            LOG_WARN_RATELIMITED(1000, "invalid chunk header: " << hex);
             throw http_exception("invalid chunk header");
         }
         // strip optional chunk extension after ';'
@@ -68,7 +68,7 @@ namespace minerva
             clean.find_first_not_of("0123456789abcdefABCDEF") !=
             std::string::npos)
         {
-            LOG_WARN("invalid chunk header: " << hex);
+            LOG_WARN_RATELIMITED(1000, "invalid chunk header: " << hex);
             throw http_exception("invalid chunk header");
         }
         unsigned long long val = 0;
@@ -78,7 +78,7 @@ namespace minerva
         }
         catch (const std::exception &)
         {
-            LOG_WARN("invalid chunk header: " << hex);
+            LOG_WARN_RATELIMITED(1000, "invalid chunk header: " << hex);
             throw http_exception("invalid chunk header");
         }
         if (val > http_request::MAX_CHUNK_SIZE)
@@ -99,20 +99,269 @@ namespace minerva
     {
     }
 
+    static int hex_value(char c)
+    {
+        if (c >= '0' && c <= '9')
+        {
+            return c - '0';
+        }
+        c |= 0x20;
+        if (c >= 'a' && c <= 'f')
+        {
+            return c - 'a' + 10;
+        }
+        return -1;
+    }
+
+    size_t http_request::url_decode(char * data, size_t len)
+    {
+        // memchr skips the runs between escapes a vector at a time; only
+        // the bytes after an escape need moving down.
+        const char * in  = data;
+        const char * end = data + len;
+        char * out = data;
+        while (in < end)
+        {
+            const char * pct = static_cast<const char *>(
+                std::memchr(in, '%', end - in));
+            if (!pct)
+            {
+                pct = end;
+            }
+            if (out != in)
+            {
+                std::memmove(out, in, pct - in);
+            }
+            out += pct - in;
+            in = pct;
+            if (in == end)
+            {
+                break;
+            }
+            int hi = -1;
+            int lo = -1;
+            if (end - in >= 3 &&
+                (hi = hex_value(in[1])) >= 0 &&
+                (lo = hex_value(in[2])) >= 0)
+            {
+                *out++ = static_cast<char>((hi << 4) | lo);
+                in += 3;
+            }
+            else
+            {
+                *out++ = *in++;
+            }
+        }
+        return out - data;
+    }
+
     std::string http_request::url_decode(const std::string & value)
     {
-        char* output = curl_unescape(value.c_str(), static_cast<int>(value.size()));
-        assert(output);
-        std::string res(output);
-        curl_free(output);
+        std::string res(value);
+        res.resize(url_decode(res.data(), res.size()));
         return res;
     }
 
-    static bool is_number(const std::string& s)
+    void http_request::parse_query() const
+    {
+        m_query_parsed = true;
+        m_query_params.clear();
+        m_query_arena.assign(m_query_string);
+
+        // Each name and value is decoded where it lies in the arena; a
+        // decoded escape is never longer than its encoding.
+        char * qs = m_query_arena.data();
+        const size_t len = m_query_arena.size();
+        size_t start = 0;
+        while (start < len)
+        {
+            const char * amp = static_cast<const char *>(
+                std::memchr(qs + start, '&', len - start));
+            const size_t amp_pos = amp ? amp - qs : len;
+            if (amp_pos > start) // Non-empty parameter
+            {
+                char * param = qs + start;
+                const size_t param_len = amp_pos - start;
+                const char * eq = static_cast<const char *>(
+                    std::memchr(param, '=', param_len));
+                const size_t name_len = eq ? eq - param : param_len;
+
+                query_param p;
+                p.name = std::string_view(param, url_decode(param, name_len));
+                if (eq)
+                {
+                    char * value = param + name_len + 1;
+                    p.value = std::string_view(
+                        value, url_decode(value, param_len - name_len - 1));
+                }
+                m_query_params.push_back(p);
+            }
+            start = amp_pos + 1;
+        }
+    }
+
+    const std::vector<http_request::query_param> &
+    http_request::query_parameters() const
+    {
+        if (!m_query_parsed)
+        {
+            parse_query();
+        }
+        return m_query_params;
+    }
+
+    std::string http_request::query_parameter(const char* key) const
+    {
+        const std::vector<query_param> & params = query_parameters();
+        for (auto it = params.rbegin(); it != params.rend(); ++it)
+        {
+            if (ci_equals(it->name, key))
+            {
+                return std::string(it->value);
+            }
+        }
+        return std::string();
+    }
+
+    // Next '\n'-terminated line of block from pos, without the '\n'; pos
+    // moves past it.
+    static bool next_line(std::string_view block, size_t & pos,
+                          std::string_view & line)
+    {
+        if (pos >= block.size())
+        {
+            return false;
+        }
+        size_t nl = block.find('\n', pos);
+        if (nl == std::string_view::npos)
+        {
+            nl = block.size();
+        }
+        line = block.substr(pos, nl - pos);
+        pos = nl + 1;
+        return true;
+    }
+
+    static bool is_space(char c)
+    {
+        return std::isspace(static_cast<unsigned char>(c)) != 0;
+    }
+
+    // Splits "METHOD SP target SP HTTP/1.x\r" into its three parts; any
+    // other shape is rejected.
+    static bool split_request_line(std::string_view line,
+                                   std::string_view & method,
+                                   std::string_view & target,
+                                   std::string_view & version)
+    {
+        if (line.empty() || line.back() != '\r')
+        {
+            return false;
+        }
+        line.remove_suffix(1);
+
+        std::string_view parts[3];
+        size_t pos = 0;
+        for (int i = 0; i < 3; ++i)
+        {
+            if (i > 0)
+            {
+                const size_t start = pos;
+                while (pos < line.size() && is_space(line[pos]))
+                {
+                    ++pos;
+                }
+                if (pos == start)
+                {
+                    return false;
+                }
+            }
+            const size_t start = pos;
+            while (pos < line.size() && !is_space(line[pos]))
+            {
+                ++pos;
+            }
+            if (pos == start)
+            {
+                return false;
+            }
+            parts[i] = line.substr(start, pos - start);
+        }
+        if (pos != line.size() ||
+            (parts[2] != "HTTP/1.0" && parts[2] != "HTTP/1.1"))
+        {
+            return false;
+        }
+        method  = parts[0];
+        target  = parts[1];
+        version = parts[2].substr(5);
+        return true;
+    }
+
+    void http_request::add_header_field(std::string_view name,
+                                        std::string_view value)
+    {
+        for (size_t i = 0; i < m_header_count; ++i)
+        {
+            if (ci_equals(m_headers[i].name, name))
+            {
+                m_headers[i].value.assign(value);
+                return;
+            }
+        }
+        if (m_header_count == m_headers.size())
+        {
+            m_headers.emplace_back();
+        }
+        header_field & f = m_headers[m_header_count++];
+        f.name.assign(name);
+        f.value.assign(value);
+    }
+
+    void http_request::reset()
     {
-        std::string::const_iterator it = s.begin();
-        while (it != s.end() && std::isdigit(*it)) ++it;
-        return !s.empty() && it == s.end();
+        m_chunk_state        = CHUNK_STATE::READING_CHUNK_HEADER;
+        m_chunk_size         = 0;
+        m_chunk_read         = 0;
+        m_chunked            = false;
+        m_full_read          = false;
+        m_partial_read       = false;
+        m_total_read         = 0;
+        m_offset             = 0;
+        m_header_count       = 0;
+        m_method             = METHOD::GET;
+        m_http11             = false;
+        m_content_length     = 0;
+        m_path.clear();
+        m_content_type       = http_content_type::code::CONTENT_TYPE_UNKNOWN;
+        m_query_string.clear();
+        m_query_params.clear();
+        m_query_parsed       = false;
+        m_overflow.clear();
+        m_ra_begin           = 0;
+        m_ra_end             = 0;
+        m_wire_left          = 0;
+        m_read_syscalls      = 0;
+        m_poll_syscalls      = 0;
+        m_bytes_received     = 0;
+        m_path_param_count   = 0;
+        m_fullbuf.reset();
+        m_keep_alive         = true;
+        m_continue_100       = false;
+        m_max_content_length = MAX_CONTENT_LENGTH;
+        m_mp_boundary.clear();
+        m_mp_delim.clear();
+        // A window grown for an over-long part header goes back to the
+        // allocator rather than staying with the context.
+        if (m_mp_buf.size() > MP_WINDOW_SIZE)
+        {
+            std::vector<char>().swap(m_mp_buf);
+        }
+        m_mp_begin           = 0;
+        m_mp_end             = 0;
+        m_mp_scan            = 0;
+        m_mp_state           = MP_STATE::MP_INIT;
+        m_multipart_active   = false;
     }
 
     bool http_request::parse_header(const std::vector<char> & buf,
@@ -127,11 +376,13 @@ namespace minerva
             return false;
         }
 
-        std::string header(buf.data(), offset);
-        std::stringstream ss(header);
-        std::string line;
+        // The header is parsed in place; only the fields kept on the
+        // request are copied, into strings reused across requests.
+        const std::string_view block(buf.data(), offset);
+        size_t pos = 0;
+        std::string_view line;
 
-        if (!std::getline(ss, line))
+        if (!next_line(block, pos, line))
         {
             return false;
         }
@@ -144,27 +395,20 @@ namespace minerva
         }
     
         // scan first line
-        std::smatch match;
-        std::regex_search(line, match, kFirstLineRegex);
-        if (match.size() != 4)
+        std::string_view method;
+        std::string_view path;
+        std::string_view version;
+        if (!split_request_line(line, method, path, version))
         {
-            LOG_WARN("Invalid http request header: " << line.c_str());
+            LOG_WARN("Invalid http request header: " << line);
             return false;
         }
-        std::string method = match[1];
-        std::string path = match[2];
-        std::string version = match[3];
 
         // handle the http://host::port prefix possibility
-        if (path.empty())
-        {
-            LOG_WARN("empty request path");
-            return false;
-        }
         if (path[0] != '/')
         {
             auto pos = path.find_first_of("/");
-            if (pos == std::string::npos)
+            if (pos == std::string_view::npos)
             {
                 return false;
             }
@@ -173,7 +417,7 @@ namespace minerva
                 return false;
             }
             pos = path.find_first_of("/", pos+1);
-            if (pos == std::string::npos)
+            if (pos == std::string_view::npos)
             {
                 return false;
             }
@@ -182,7 +426,7 @@ namespace minerva
                 return false;
             }
             pos = path.find_first_of("/", pos+1);
-            if (pos == std::string::npos)
+            if (pos == std::string_view::npos)
             {
                 return false;
             }
@@ -221,7 +465,7 @@ namespace minerva
         }
         else
         {
-            LOG_WARN("Invalid http method: " << method.c_str());
+            LOG_WARN("Invalid http method: " << method);
             return false;
         }
     
@@ -233,62 +477,29 @@ namespace minerva
 
         // get path and query string
         size_t index = path.find('?');
-        if (index != std::string::npos)
+        if (index != std::string_view::npos)
         {
             // set path
-            m_path = path.substr(0, index);
-            // parse query params
+            m_path.assign(path.substr(0, index));
+            // keep the raw query string
             if (index < path.size() - 1)
             {
-                std::string qs = path.substr(index + 1);
-                m_query_string = qs;
-                
-                // More efficient query parsing without stringstream
-                size_t start = 0;
-                while (start < qs.size())
-                {
-                    size_t amp_pos = qs.find('&', start);
-                    if (amp_pos == std::string::npos)
-                        amp_pos = qs.size();
-                    
-                    if (amp_pos > start) // Non-empty parameter
-                    {
-                        size_t eq_pos = qs.find('=', start);
-                        std::string key, value;
-                        
-                        if (eq_pos == std::string::npos || eq_pos >= amp_pos)
-                        {
-                            // No '=' found or '=' is beyond this parameter
-                            key = url_decode(qs.substr(start, amp_pos - start));
-                            value = "";
-                        }
-                        else
-                        {
-                            key = url_decode(qs.substr(start, eq_pos - start));
-                            value = url_decode(qs.substr(eq_pos + 1, amp_pos - eq_pos - 1));
-                        }
-                        m_query_params[key] = value;
-                    }
-                    
-                    start = amp_pos + 1;
-                }
+                // Split and decoded only if a handler asks for them.
+                m_query_string.assign(path.substr(index + 1));
             }
         }
         // no query params = just a path
         else
         {
-            m_path = path;
+            m_path.assign(path);
         }
 
-        std::string content_length(contentLength);
-        std::string content_type(contentType);
-
         bool has_content_length = false;
         size_t total_headers_size = 0;
         size_t header_count = 0;
 
         // read headers line by line
-        while (std::getline(ss, line))
+        while (next_line(block, pos, line))
         {
             // check for empty line
             if (line.size() == 1 && line[0] == '\r')
@@ -319,22 +530,24 @@ namespace minerva
                 return false;
             }
 
-            // Optimized header parsing without regex
             size_t colon_pos = line.find(':');
-            if (colon_pos == std::string::npos || colon_pos == 0)
+            if (colon_pos == std::string_view::npos || colon_pos == 0)
             {
-                LOG_WARN("Invalid http header: " << line.c_str());
+                LOG_WARN("Invalid http header: " << line);
                 return false;
             }
             
             // Extract key (before colon, trim right)
-            std::string key = line.substr(0, colon_pos);
-            rtrim(key);
+            std::string_view key = line.substr(0, colon_pos);
+            while (!key.empty() && is_space(key.back()))
+            {
+                key.remove_suffix(1);
+            }
             
             // Extract value (after colon, skip spaces, remove \r)
-            std::string value;
+            std::string_view value;
             size_t value_start = colon_pos + 1;
-            while (value_start < line.size() && std::isspace(line[value_start]))
+            while (value_start < line.size() && is_space(line[value_start]))
                 ++value_start;
             
             if (value_start < line.size())
@@ -342,68 +555,61 @@ namespace minerva
                 value = line.substr(value_start);
                 // Remove trailing \r if present
                 if (!value.empty() && value.back() == '\r')
-                    value.pop_back();
+                    value.remove_suffix(1);
             }
 
             LOG_DEBUG("header: " << key << "=" << value);
 
-            // add to map
-            m_headers[key] = value;
+            add_header_field(key, value);
         
             // for content length - set it here
-            if (minerva::ci_equals(key, content_length))
+            if (minerva::ci_equals(key, contentLength))
             {
-                if (!is_number(value))
+                long long length = 0;
+                const auto res = std::from_chars(value.data(),
+                                                 value.data() + value.size(),
+                                                 length);
+                if (value.empty() || value[0] == '-' || value[0] == '+' ||
+                    res.ptr != value.data() + value.size() ||
+                    res.ec == std::errc::invalid_argument)
                 {
                     LOG_WARN("Invalid content length on http request header: " <<
-                             value.c_str());
+                             value);
                     return false;
                 }
-                try
-                {
-                    m_content_length = std::stoll(value);
-                    if (m_content_length < 0)
-                    {
-                        LOG_WARN("Negative content length on http request header: " <<
-                                 value.c_str());
-                        return false;
-                    }
-                    if (m_content_length > static_cast<long long>(m_max_content_length))
-                    {
-                        LOG_WARN("Content length exceeds maximum: " <<
-                                 m_content_length);
-                        return false;
-                    }
-                    has_content_length = true;
-                }
-                catch (const std::invalid_argument)
+                if (res.ec == std::errc::result_out_of_range)
                 {
                     LOG_WARN("Invalid content length on http request header: " <<
-                             value.c_str());
+                             value);
                     return false;
                 }
-                catch (const std::out_of_range)
+                m_content_length = length;
+                if (m_content_length > static_cast<long long>(m_max_content_length))
                 {
-                    LOG_WARN("Invalid content length on http request header: " <<
-                             value.c_str());
+                    LOG_WARN("Content length exceeds maximum: " <<
+                             m_content_length);
                     return false;
                 }
+                has_content_length = true;
             }
         
             // for content type - set it here
-            else if (minerva::ci_equals(key, content_type))
+            else if (minerva::ci_equals(key, contentType))
             {
                 // Split the media type from any parameters (e.g.
                 // "multipart/form-data; boundary=----xyz").
-                std::string media = value;
-                std::string params;
+                std::string_view media = value;
+                std::string_view params;
                 size_t semi = value.find(';');
-                if (semi != std::string::npos)
+                if (semi != std::string_view::npos)
                 {
                     media = value.substr(0, semi);
                     params = value.substr(semi + 1);
                 }
-                rtrim(media);
+                while (!media.empty() && is_space(media.back()))
+                {
+                    media.remove_suffix(1);
+                }
                 m_content_type = http_content_type::parse(media);
 
                 if (m_content_type ==
@@ -416,7 +622,7 @@ namespace minerva
                         LOG_WARN("multipart/form-data missing boundary");
                         return false;
                     }
-                    std::string b = params.substr(bpos + 9);
+                    std::string_view b = params.substr(bpos + 9);
                     // trim leading whitespace
                     size_t s = 0;
                     while (s < b.size() && (b[s] == ' ' || b[s] == '\t'))
@@ -427,7 +633,7 @@ namespace minerva
                     if (!b.empty() && b[0] == '"')
                     {
                         size_t endq = b.find('"', 1);
-                        if (endq == std::string::npos)
+                        if (endq == std::string_view::npos)
                         {
                             LOG_WARN("multipart boundary missing closing quote");
                             return false;
@@ -437,14 +643,14 @@ namespace minerva
                     else
                     {
                         size_t semi2 = b.find(';');
-                        if (semi2 != std::string::npos)
+                        if (semi2 != std::string_view::npos)
                         {
                             b = b.substr(0, semi2);
                         }
                         while (!b.empty() &&
                                (b.back() == ' ' || b.back() == '\t'))
                         {
-                            b.pop_back();
+                            b.remove_suffix(1);
                         }
                     }
                     if (b.empty() ||
@@ -454,8 +660,9 @@ namespace minerva
                                  b.size());
                         return false;
                     }
-                    m_mp_boundary = b;
-                    m_mp_delim = "\r\n--" + b;
+                    m_mp_boundary.assign(b);
+                    m_mp_delim.assign("\r\n--");
+                    m_mp_delim.append(b);
                 }
             }
             // for connection - set it here
@@ -490,7 +697,7 @@ namespace minerva
         }
 
         // HTTP/1.1 requires Host header (RFC 7230 Section 5.4)
-        if (m_http11 && m_headers.find("host") == m_headers.end())
+        if (m_http11 && !find_header("host"))
         {
             LOG_WARN("HTTP/1.1 request missing required Host header");
             return false;
@@ -515,6 +722,7 @@ namespace minerva
             LOG_WARN("Invalid reuqest: more content then provided in content length");
             return false;
         }
+        m_wire_left = m_chunked ? 0 : m_content_length - m_overflow.size();
 
         return true;
     }            
@@ -941,7 +1149,7 @@ namespace minerva
 
     bool http_request::has_overflow()
     {
-        if (m_overflow.size() > 0)
+        if (m_overflow.size() > 0 || m_ra_begin < m_ra_end)
         {
             LOG_DEBUG("has overflow");
             return true;
@@ -970,14 +1178,15 @@ namespace minerva
         }
     }
 
-    size_t http_request::read_cl(char * buf, size_t len, int timeoutMs)
+    size_t http_request::read_cl(char * buf, size_t len, int timeoutMs,
+                                 std::string_view * view)
     {
         if (m_total_read >= m_content_length)
         {
             return 0;
         }
 
-        if (!m_overflow.empty())
+        if (!view && !m_overflow.empty())
         {
             auto it = m_overflow.cbegin();
             size_t to_copy = std::min(len, m_overflow.size());
@@ -999,14 +1208,22 @@ namespace minerva
             return 0;
         }
 
+        if (view)
+        {
+            overflow_to_read_ahead(to_read);
+        }
+
         minerva::timer _timer;
-        size_t read = read_from_socket(buf, to_read, _timer, timeoutMs);
+        size_t read = view
+            ? view_from_socket(*view, to_read, _timer, timeoutMs)
+            : read_from_socket(buf, to_read, _timer, timeoutMs);
         m_total_read += read;
     
         return read;
     }
 
-    size_t http_request::read_chunked(char * buf, size_t len, int timeoutMs)
+    size_t http_request::read_chunked(char * buf, size_t len, int timeoutMs,
+                                      std::string_view * view)
     {
         minerva::timer _timer;
 
@@ -1074,7 +1291,7 @@ namespace minerva
 
             case CHUNK_STATE::READING_CHUNK_BODY:
             {
-                if (!m_overflow.empty())
+                if (!view && !m_overflow.empty())
                 {
                     auto it = m_overflow.cbegin();
                     size_t to_copy = 
@@ -1105,7 +1322,15 @@ namespace minerva
                 size_t to_read = 
                     std::min(len, 
                              m_chunk_size - m_chunk_read);
-                size_t read = read_from_socket(buf, to_read, _timer, timeoutMs);
+                if (view)
+                {
+                    // Bytes read past the chunk header were parked in
+                    // m_overflow; put them back so the view covers them.
+                    overflow_to_read_ahead(to_read);
+                }
+                size_t read = view
+                    ? view_from_socket(*view, to_read, _timer, timeoutMs)
+                    : read_from_socket(buf, to_read, _timer, timeoutMs);
                 m_chunk_read += read;
                 m_total_read += read;
 
@@ -1208,6 +1433,200 @@ namespace minerva
         }
     }
 
+    size_t http_request::consume(const body_visitor & visitor, int timeoutMs)
+    {
+        if (m_multipart_active || m_full_read)
+        {
+            throw http_exception("protocol violation");
+        }
+        m_partial_read = true;
+
+        // Each run is a view straight into the read-ahead buffer the
+        // connection reads into, so the body is never copied out of it.
+        size_t total = 0;
+        size_t n;
+        std::string_view view;
+        while ((n = chunked()
+                ? read_chunked(nullptr, SIZE_MAX, timeoutMs, &view)
+                : read_cl(nullptr, SIZE_MAX, timeoutMs, &view)) > 0)
+        {
+            visitor(view);
+            total += n;
+        }
+        return total;
+    }
+
+    bool http_request::can_splice() const
+    {
+        return !m_chunked && !m_multipart_active && !m_full_read &&
+            !m_partial_read && !m_ctx.conn()->is_secure();
+    }
+
+    void http_request::write_fd(int fd, const char * buf, size_t len)
+    {
+        while (len > 0)
+        {
+            ssize_t w = ::write(fd, buf, len);
+            if (w < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                LOG_WARN_ERRNO("body write failed", errno);
+                throw http_exception("write error");
+            }
+            buf += w;
+            len -= w;
+        }
+    }
+
+    size_t http_request::splice_to_fd(int fd, int timeoutMs)
+    {
+        if (!can_splice())
+        {
+            throw http_exception("protocol violation");
+        }
+        m_partial_read = true;
+
+        size_t total = 0;
+
+        // Bytes that arrived with the header (and anything read ahead)
+        // are already in user space; write them out first.
+        // The deque keeps them in fixed-size blocks; write each contiguous
+        // run in place instead of gathering them into a copy.
+        for (auto it = m_overflow.begin(); it != m_overflow.end(); )
+        {
+            const char * run = &*it;
+            size_t len = 1;
+            for (++it; it != m_overflow.end() && &*it == run + len; ++it)
+            {
+                ++len;
+            }
+            write_fd(fd, run, len);
+            total += len;
+        }
+        m_overflow.clear();
+        if (m_ra_begin < m_ra_end)
+        {
+            write_fd(fd, m_ra_buf.data() + m_ra_begin, m_ra_end - m_ra_begin);
+            total += m_ra_end - m_ra_begin;
+            m_ra_begin = m_ra_end = 0;
+        }
+        m_total_read += total;
+
+        if (m_wire_left == 0)
+        {
+            return total;
+        }
+
+        int pipefd[2];
+        if (::pipe2(pipefd, O_CLOEXEC) != 0)
+        {
+            LOG_WARN_ERRNO("pipe2 failed", errno);
+            throw http_exception("pipe error");
+        }
+        unique_command close_pipe([&pipefd]()
+        {
+            ::close(pipefd[0]);
+            ::close(pipefd[1]);
+        });
+        // A larger pipe means fewer splice round trips; best-effort.
+        ::fcntl(pipefd[1], F_SETPIPE_SZ, static_cast<int>(READ_AHEAD_SIZE * 4));
+
+        const int sock = m_ctx.conn()->get_socket();
+        minerva::timer _timer;
+
+        while (m_wire_left > 0)
+        {
+            ssize_t in = ::splice(sock, nullptr, pipefd[1], nullptr,
+                                  m_wire_left,
+                                  SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            m_read_syscalls++;
+            if (in < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    wait_readable(_timer, timeoutMs);
+                    continue;
+                }
+                LOG_DEBUG_ERRNO("splice from socket failed", errno);
+                throw http_exception("read error");
+            }
+            if (in == 0)
+            {
+                LOG_DEBUG("Http client disconnected unexpectedly");
+                throw http_exception("connection closed");
+            }
+            m_wire_left -= in;
+            m_total_read += in;
+            m_bytes_received += in;
+            total += in;
+
+            // Drain the pipe into the file.
+            while (in > 0)
+            {
+                ssize_t out = ::splice(pipefd[0], nullptr, fd, nullptr, in,
+                                       SPLICE_F_MOVE);
+                if (out < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (out <= 0)
+                {
+                    LOG_WARN_ERRNO("splice to file failed", errno);
+                    throw http_exception("write error");
+                }
+                in -= out;
+            }
+        }
+        return total;
+    }
+
+    void http_request::wait_readable(minerva::timer & timer, int timeoutMs)
+    {
+        while (true)
+        {
+            if (m_ctx.should_shutdown())
+            {
+                throw http_exception("server shutdown");
+            }
+            if (m_ctx.timed_out())
+            {
+                throw http_exception("operation timeout");
+            }
+            if (timeoutMs > 0 && timer.get_elapsed_milliseconds() >= timeoutMs)
+            {
+                throw http_exception("read timeout");
+            }
+
+            bool read_flag = true;
+            bool write_flag = false;
+            bool error_flag = true;
+            m_poll_syscalls++;
+            int poll_status =
+                m_ctx.conn()->poll(read_flag, write_flag, error_flag, 100);
+            if (poll_status < 0)
+            {
+                LOG_WARN_ERRNO("Poll error", errno);
+                throw http_exception("poll error");
+            }
+            else if (poll_status > 0)
+            {
+                if (error_flag)
+                {
+                    LOG_WARN("Poll read socket error");
+                    throw http_exception("read error");
+                }
+                return;
+            }
+        }
+    }
+
     bool http_request::null_body_read_cl(int timeoutMs)
     {
         size_t left = m_content_length - m_total_read - m_overflow.size();
@@ -1419,8 +1838,8 @@ namespace minerva
         // request, including any unconsumed (or trailing) form data.  The
         // already-buffered multipart bytes were counted in m_total_read / the
         // chunk state, so the transport drain math stays correct; just drop the
-        // staging buffer.
-        m_mp_raw.clear();
+        // staging window.
+        m_mp_begin = m_mp_end = m_mp_scan = 0;
 
         if (chunked())
         {
@@ -1446,69 +1865,118 @@ namespace minerva
         }
     }
 
+    bool http_request::mp_fill(int timeoutMs)
+    {
+        if (m_mp_buf.empty())
+        {
+            m_mp_buf.resize(MP_WINDOW_SIZE);
+        }
+
+        // Slide the unconsumed bytes to the front once the free tail gets
+        // small.  Only a partial delimiter or header line is ever left
+        // behind, so this moves very little.
+        if (m_mp_buf.size() - m_mp_end < MP_WINDOW_SIZE / 4 && m_mp_begin > 0)
+        {
+            size_t used = m_mp_end - m_mp_begin;
+            std::memmove(m_mp_buf.data(), m_mp_buf.data() + m_mp_begin, used);
+            m_mp_scan -= std::min(m_mp_scan, m_mp_begin);
+            m_mp_begin = 0;
+            m_mp_end = used;
+        }
+        if (m_mp_end == m_mp_buf.size())
+        {
+            m_mp_buf.resize(m_mp_buf.size() * 2);
+        }
+
+        size_t r = read_raw_body(m_mp_buf.data() + m_mp_end,
+                                 m_mp_buf.size() - m_mp_end, timeoutMs);
+        m_mp_end += r;
+        return r > 0;
+    }
+
     bool http_request::mp_read_line(std::string & line, int timeoutMs)
     {
         line.clear();
+        size_t from = m_mp_begin;
         while (true)
         {
-            for (size_t i = 0; i + 1 < m_mp_raw.size(); i++)
+            const char * base = m_mp_buf.data();
+            while (from + 1 < m_mp_end)
             {
-                if (m_mp_raw[i] == '\r' && m_mp_raw[i + 1] == '\n')
+                const char * cr = static_cast<const char *>(
+                    std::memchr(base + from, '\r', m_mp_end - from - 1));
+                if (!cr)
                 {
-                    line.assign(m_mp_raw.begin(), m_mp_raw.begin() + i);
-                    m_mp_raw.erase(m_mp_raw.begin(), m_mp_raw.begin() + i + 2);
+                    from = m_mp_end - 1;
+                    break;
+                }
+                size_t i = cr - base;
+                if (base[i + 1] == '\n')
+                {
+                    line.assign(base + m_mp_begin, i - m_mp_begin);
+                    m_mp_begin = i + 2;
                     return true;
                 }
+                from = i + 1;
             }
-            if (m_mp_raw.size() > MAX_HEADER_SIZE)
+            if (m_mp_end - m_mp_begin > MAX_HEADER_SIZE)
             {
                 LOG_WARN("multipart header line too long");
                 throw http_exception("multipart header line too long");
             }
-            char buf[4096];
-            size_t r = read_raw_body(buf, sizeof(buf), timeoutMs);
-            if (r == 0)
+            // mp_fill() may slide the window; keep 'from' relative to it.
+            size_t rel = from - m_mp_begin;
+            if (!mp_fill(timeoutMs))
             {
                 return false;
             }
-            m_mp_raw.insert(m_mp_raw.end(), buf, buf + r);
+            from = m_mp_begin + rel;
         }
     }
 
-    size_t http_request::mp_find_delim() const
+    void http_request::mp_init_skip_table()
     {
-        const std::string & d = m_mp_delim;
-        if (m_mp_raw.size() < d.size())
+        // Horspool shift: how far the window may slide when the byte under
+        // its last position is c.  Bytes absent from the delimiter (all but
+        // its last) shift by the full delimiter length.
+        const size_t D = m_mp_delim.size();
+        m_mp_skip.fill(static_cast<uint16_t>(D));
+        for (size_t j = 0; j + 1 < D; j++)
         {
-            return m_mp_raw.size() + 1;
+            m_mp_skip[static_cast<unsigned char>(m_mp_delim[j])] =
+                static_cast<uint16_t>(D - 1 - j);
         }
-        size_t limit = m_mp_raw.size() - d.size();
-        for (size_t i = 0; i <= limit; i++)
+    }
+
+    size_t http_request::mp_find_delim()
+    {
+        const size_t D = m_mp_delim.size();
+        const char * d = m_mp_delim.data();
+        const char * base = m_mp_buf.data();
+
+        size_t i = std::max(m_mp_scan, m_mp_begin);
+        while (i + D <= m_mp_end)
         {
-            bool match = true;
-            for (size_t j = 0; j < d.size(); j++)
-            {
-                if (m_mp_raw[i + j] != d[j])
-                {
-                    match = false;
-                    break;
-                }
-            }
-            if (match)
+            unsigned char last = static_cast<unsigned char>(base[i + D - 1]);
+            if (last == static_cast<unsigned char>(d[D - 1]) &&
+                std::memcmp(base + i, d, D - 1) == 0)
             {
-                return i;
+                m_mp_scan = i;
+                return i - m_mp_begin;
             }
+            i += m_mp_skip[last];
         }
-        return m_mp_raw.size() + 1;
+        // No match can start before the last D-1 bytes; resume there once
+        // more data arrives.
+        m_mp_scan = std::max(m_mp_begin,
+                             m_mp_end >= D - 1 ? m_mp_end - (D - 1) : 0);
+        return std::string::npos;
     }
 
     void http_request::mp_consume_delimiter(int timeoutMs)
     {
-        // m_mp_raw begins with the delimiter "\r\n--<boundary>".
-        for (size_t i = 0; i < m_mp_delim.size(); i++)
-        {
-            m_mp_raw.pop_front();
-        }
+        // The window begins with the delimiter "\r\n--<boundary>".
+        m_mp_begin += m_mp_delim.size();
         // The remainder of the line is either empty (a normal delimiter) or
         // "--" (the closing delimiter), optionally followed by whitespace.
         std::string trailer;
@@ -1529,8 +1997,7 @@ namespace minerva
         }
     }
 
-    size_t http_request::mp_body_read(char * out, size_t maxlen, bool discard,
-                                      int timeoutMs)
+    size_t http_request::mp_body_avail(int timeoutMs)
     {
         if (m_mp_state != MP_STATE::MP_BODY)
         {
@@ -1542,42 +2009,27 @@ namespace minerva
         while (true)
         {
             size_t pos = mp_find_delim();
-            if (pos > m_mp_raw.size())
+            if (pos == std::string::npos)
             {
-                // No delimiter found yet.  Emit everything except the last
-                // (D-1) bytes, which could be the start of a delimiter.
-                size_t avail = m_mp_raw.size();
+                // No delimiter found yet.  Everything except the last (D-1)
+                // bytes, which could be the start of a delimiter, is body.
+                size_t avail = m_mp_end - m_mp_begin;
                 size_t safe = avail >= (D - 1) ? avail - (D - 1) : 0;
                 if (safe > 0)
                 {
-                    size_t n = std::min(maxlen, safe);
-                    if (!discard)
-                    {
-                        std::copy(m_mp_raw.begin(), m_mp_raw.begin() + n, out);
-                    }
-                    m_mp_raw.erase(m_mp_raw.begin(), m_mp_raw.begin() + n);
-                    return n;
+                    return safe;
                 }
-                char buf[16 * 1024];
-                size_t r = read_raw_body(buf, sizeof(buf), timeoutMs);
-                if (r == 0)
+                if (!mp_fill(timeoutMs))
                 {
                     LOG_WARN("malformed multipart: missing closing boundary");
                     throw http_exception("malformed multipart body");
                 }
-                m_mp_raw.insert(m_mp_raw.end(), buf, buf + r);
                 continue;
             }
 
             if (pos > 0)
             {
-                size_t n = std::min(maxlen, pos);
-                if (!discard)
-                {
-                    std::copy(m_mp_raw.begin(), m_mp_raw.begin() + n, out);
-                }
-                m_mp_raw.erase(m_mp_raw.begin(), m_mp_raw.begin() + n);
-                return n;
+                return pos;
             }
 
             // pos == 0: delimiter is at the front; consume it and stop.
@@ -1586,6 +2038,18 @@ namespace minerva
         }
     }
 
+    size_t http_request::mp_body_read(char * out, size_t maxlen, bool discard,
+                                      int timeoutMs)
+    {
+        size_t n = std::min(maxlen, mp_body_avail(timeoutMs));
+        if (n > 0 && !discard)
+        {
+            std::memcpy(out, m_mp_buf.data() + m_mp_begin, n);
+        }
+        m_mp_begin += n;
+        return n;
+    }
+
     void http_request::mp_init_first_boundary(int timeoutMs)
     {
         // Skip any preamble and locate the opening boundary line, which is
@@ -1724,15 +2188,17 @@ namespace minerva
         // Drain any unread bytes from the current part.
         if (m_mp_state == MP_STATE::MP_BODY)
         {
-            char buf[16 * 1024];
-            while (mp_body_read(buf, sizeof(buf), true, timeoutMs) > 0)
+            size_t n;
+            while ((n = mp_body_avail(timeoutMs)) > 0)
             {
+                m_mp_begin += n;
             }
         }
 
         // Position at the first boundary on the very first call.
         if (m_mp_state == MP_STATE::MP_INIT)
         {
+            mp_init_skip_table();
             mp_init_first_boundary(timeoutMs);
         }
 
@@ -1749,11 +2215,11 @@ namespace minerva
     std::istream & http_request::mp_read_fully(int timeoutMs)
     {
         m_fullbuf.emplace(); // fresh buffer for the current part
-        char buf[16 * 1024];
         size_t n;
-        while ((n = mp_body_read(buf, sizeof(buf), false, timeoutMs)) > 0)
+        while ((n = mp_body_avail(timeoutMs)) > 0)
         {
-            m_fullbuf->write(buf, n);
+            m_fullbuf->write(m_mp_buf.data() + m_mp_begin, n);
+            m_mp_begin += n;
         }
         return *m_fullbuf;
     }
@@ -1767,10 +2233,138 @@ namespace minerva
         return mp_body_read(buf, len, false, timeoutMs);
     }
 
+    size_t http_request::read_form_view(std::string_view & view, int timeoutMs)
+    {
+        if (!m_multipart_active)
+        {
+            throw http_exception("protocol violation");
+        }
+        size_t n = mp_body_avail(timeoutMs);
+        view = std::string_view(m_mp_buf.data() + m_mp_begin, n);
+        m_mp_begin += n;
+        return n;
+    }
+
+    void http_request::fill_read_ahead(minerva::timer & timer, int timeoutMs)
+    {
+        // Only a chunked body has an unknown length; otherwise never read
+        // past what is left of this request on the wire.
+        const size_t limit = m_chunked
+            ? READ_AHEAD_SIZE
+            : std::min(READ_AHEAD_SIZE, m_wire_left);
+        if (m_ra_buf.size() < READ_AHEAD_SIZE)
+        {
+            m_ra_buf.resize(READ_AHEAD_SIZE);
+        }
+        m_ra_begin = 0;
+        m_ra_end = socket_read(m_ra_buf.data(), limit, timer, timeoutMs);
+
+        // A TLS record may have left decrypted bytes behind; collect them
+        // now, as that costs no syscall.
+        while (m_ra_end < limit && m_ctx.conn()->pending())
+        {
+            m_ra_end += socket_read(m_ra_buf.data() + m_ra_end,
+                                    limit - m_ra_end, timer, timeoutMs);
+        }
+    }
+
     size_t http_request::read_from_socket(char * buf, size_t len,
                                           minerva::timer & timer,
                                           int timeoutMs)
     {
+        if (m_ra_begin == m_ra_end)
+        {
+            // Only a chunked body has an unknown length; otherwise never
+            // read past what is left of this request on the wire.
+            size_t limit = m_chunked
+                ? READ_AHEAD_SIZE
+                : std::min(READ_AHEAD_SIZE, m_wire_left);
+            if (len >= limit)
+            {
+                // Large reads gain nothing from staging.
+                return socket_read(buf, len, timer, timeoutMs);
+            }
+
+            fill_read_ahead(timer, timeoutMs);
+        }
+
+        size_t n = std::min(len, m_ra_end - m_ra_begin);
+        std::memcpy(buf, m_ra_buf.data() + m_ra_begin, n);
+        m_ra_begin += n;
+        return n;
+    }
+
+    size_t http_request::view_from_socket(std::string_view & view, size_t len,
+                                          minerva::timer & timer,
+                                          int timeoutMs)
+    {
+        if (m_ra_begin == m_ra_end)
+        {
+            fill_read_ahead(timer, timeoutMs);
+        }
+
+        size_t n = std::min(len, m_ra_end - m_ra_begin);
+        view = std::string_view(m_ra_buf.data() + m_ra_begin, n);
+        m_ra_begin += n;
+        return n;
+    }
+
+    void http_request::overflow_to_read_ahead(size_t max)
+    {
+        const size_t n = m_overflow.size();
+        if (n == 0)
+        {
+            return;
+        }
+        // They were usually just taken from the read-ahead buffer, so
+        // there is room in front of the unread bytes.
+        if (m_ra_begin >= n)
+        {
+            m_ra_begin -= n;
+            std::copy(m_overflow.begin(), m_overflow.end(),
+                      m_ra_buf.begin() + m_ra_begin);
+            m_overflow.clear();
+            return;
+        }
+
+        if (m_ra_buf.size() < READ_AHEAD_SIZE)
+        {
+            m_ra_buf.resize(READ_AHEAD_SIZE);
+        }
+        const size_t unread = m_ra_end - m_ra_begin;
+        if (n + unread <= READ_AHEAD_SIZE)
+        {
+            std::memmove(m_ra_buf.data() + n, m_ra_buf.data() + m_ra_begin,
+                         unread);
+            std::copy(m_overflow.begin(), m_overflow.end(), m_ra_buf.begin());
+            m_overflow.clear();
+            m_ra_begin = 0;
+            m_ra_end = n + unread;
+            return;
+        }
+
+        // Both together would not fit in READ_AHEAD_SIZE. Queue the unread
+        // bytes behind the overflow and stage only what the caller is about
+        // to take: the buffer is empty again once the view is handed out,
+        // so m_overflow still precedes it.
+        m_overflow.insert(m_overflow.end(), m_ra_buf.data() + m_ra_begin,
+                          m_ra_buf.data() + m_ra_end);
+        const size_t take = std::min({READ_AHEAD_SIZE, max, m_overflow.size()});
+        std::copy(m_overflow.begin(), m_overflow.begin() + take,
+                  m_ra_buf.begin());
+        m_overflow.erase(m_overflow.begin(), m_overflow.begin() + take);
+        m_ra_begin = 0;
+        m_ra_end = take;
+    }
+
+    size_t http_request::socket_read(char * buf, size_t len,
+                                     minerva::timer & timer,
+                                     int timeoutMs)
+    {
+        if (!m_chunked)
+        {
+            len = std::min(len, m_wire_left);
+        }
         bool reading = true;
         while (true)
         {
@@ -1810,6 +2404,7 @@ namespace minerva
                     continue;
                 }
 
+                m_poll_syscalls++;
                 int poll_status = 
                     m_ctx.conn()->poll(read_flag, write_flag, error_flag, 100);
                 if (poll_status < 0)
@@ -1836,7 +2431,11 @@ namespace minerva
             while (!done);    
     
             ssize_t read;
-    
+
+            if (!m_ctx.conn()->pending())
+            {
+                m_read_syscalls++;
+            }
             auto status = 
                 m_ctx.conn()->read(buf, len, read);
             switch (status)
@@ -1863,6 +2462,11 @@ namespace minerva
                 }
                 else
                 {
+                    if (!m_chunked)
+                    {
+                        m_wire_left -= read;
+                    }
+                    m_bytes_received += read;
                     return read;
                 }
                 break;
@@ -3,16 +3,19 @@
 #include <sstream>
 #include <vector>
 #include <string>
+#include <string_view>
+#include <array>
 #include <tuple>
-#include <map>
 #include <istream>
 #include <streambuf>
 #include <deque>
 #include <optional>
+#include <functional>
 #include <util/string_utils.h>
 #include <util/time_utils.h>
 #include "http_content_type.h"
 #include "http_exception.h"
+#include "route_table.h"
 
 namespace minerva
 {
@@ -24,6 +27,10 @@ namespace minerva
     class http_request
     {
     public:
+        // Receives successive slices of the decoded request body.  The view
+        // is only valid for the duration of the call.
+        typedef std::function<void(std::string_view)> body_visitor;
+
         enum METHOD : int
         {
             GET,
@@ -51,6 +58,14 @@ namespace minerva
         void max_content_length(size_t bytes) { m_max_content_length = bytes; }
         size_t max_content_length() const { return m_max_content_length; }
 
+        // A request header field. Names keep the spelling of their first
+        // occurrence; a repeated field keeps the last value.
+        struct header_field
+        {
+            std::string name;
+            std::string value;
+        };
+
         http_request(http_context & ctx);
         ~http_request() = default;
 
@@ -59,28 +74,54 @@ namespace minerva
         http_request(http_request &&)                  = delete;
         http_request & operator=(http_request &&)      = delete;
 
+        // Back to the state of a new request, keeping allocated buffers
+        // for the next request on this context.
+        void reset();
+
         bool parse_header(const std::vector<char> & buf,
                           size_t offset);
 
         bool header(const char* key, std::string & value) const
         {
-            auto it = m_headers.find(key);
-            if (it != m_headers.end())
+            if (const std::string * v = find_header(key))
             {
-                value = it->second;
+                value = *v;
                 return true;
             }
             return false;
         }
 
-        const std::map<std::string, std::string, minerva::ci_less> & headers() const
+        // Value of header key (any case), nullptr if absent.
+        const std::string * find_header(std::string_view key) const
+        {
+            for (size_t i = 0; i < m_header_count; ++i)
+            {
+                if (ci_equals(m_headers[i].name, key))
+                {
+                    return &m_headers[i].value;
+                }
+            }
+            return nullptr;
+        }
+
+        size_t header_count() const
+        {
+            return m_header_count;
+        }
+
+        const header_field & header_at(size_t i) const
         {
-            return m_headers;
+            return m_headers[i];
         }
 
         const char * method_as_string() const
         {
-            switch (m_method)
+            return method_as_string(m_method);
+        }
+
+        static const char * method_as_string(METHOD method)
+        {
+            switch (method)
             {
             case METHOD::GET:
                 return "GET";
@@ -124,6 +165,26 @@ namespace minerva
 
         bool has_overflow();
 
+        // Transport calls made while reading this request's body: socket
+        // read() calls that were not satisfied from TLS-buffered plaintext,
+        // and poll() calls.  Reads served from the read-ahead buffer cost
+        // neither.
+        unsigned long read_syscalls() const
+        {
+            return m_read_syscalls;
+        }
+
+        unsigned long poll_syscalls() const
+        {
+            return m_poll_syscalls;
+        }
+
+        // Bytes taken off the transport for this request, header included.
+        unsigned long long bytes_received() const
+        {
+            return m_bytes_received;
+        }
+
         long long content_length() const
         {
             return m_content_length;
@@ -134,28 +195,41 @@ namespace minerva
             return m_path;
         }
 
-        const std::string & query_string() const
+        // Value of path parameter {name} in the matched handler's route;
+        // empty if the route has no such parameter.
+        std::string_view path_param(std::string_view name) const
         {
-            return m_query_string;
+            for (size_t i = 0; i < m_path_param_count; ++i)
+            {
+                if (m_path_params[i].name == name)
+                {
+                    return m_path_params[i].value;
+                }
+            }
+            return {};
         }
 
-        const std::map<std::string, std::string, minerva::ci_less> & query_parameters() const
+        const std::string & query_string() const
         {
-            return m_query_params;
+            return m_query_string;
         }
 
-        std::string query_parameter(const char* key) const
+        // A decoded query parameter. The views stay valid until the next
+        // request on this context.
+        struct query_param
         {
-            auto it = m_query_params.find(key);
-            if (it != m_query_params.end())
-            {
-                return it->second;
-            }
-            else
-            {
-                return std::string();
-            }
-        }
+            std::string_view name;
+            std::string_view value;
+        };
+
+        // Query parameters in the order sent, duplicates included. The
+        // query string is split and decoded on the first call to this or
+        // query_parameter().
+        const std::vector<query_param> & query_parameters() const;
+
+        // Value of the last parameter named key (case-insensitive), or an
+        // empty string.
+        std::string query_parameter(const char* key) const;
 
         bool is_http11() const
         {
@@ -168,6 +242,25 @@ namespace minerva
 
         void read_chunk(std::vector<char> & buf, int timeoutMs = 0);
 
+        // Drain the remaining body (content-length or chunked), handing each
+        // decoded run of bytes to 'visitor' as a view into the request's
+        // receive buffer instead of copying it into caller storage.  Returns
+        // the number of bytes visited.  Throws http_exception on a transport
+        // or framing error.
+        size_t consume(const body_visitor & visitor, int timeoutMs = 0);
+
+        // True when the remaining body can be moved with splice_to_fd(): a
+        // content-length body on a plain (non-TLS) connection that has not
+        // been read through any other interface yet.
+        bool can_splice() const;
+
+        // Move the remaining content-length body into 'fd' socket -> pipe ->
+        // file with splice(2), never copying it through user space.  Bytes
+        // already buffered from the header read are written first.  Returns
+        // the number of body bytes written; throws http_exception on a
+        // transport or write error.
+        size_t splice_to_fd(int fd, int timeoutMs = 0);
+
         http_content_type::code content_type() const
         {
             return m_content_type;
@@ -175,6 +268,10 @@ namespace minerva
 
         static std::string url_decode(const std::string & url);
 
+        // Decodes %XX escapes in data in place and returns the decoded
+        // length; malformed escapes are kept as they are.
+        static size_t url_decode(char * data, size_t len);
+
         bool null_body_read(int timeoutMs = 0);
 
         bool chunked() const
@@ -217,6 +314,13 @@ namespace minerva
         // on a malformed stream.
         bool next_form(form_part & part, int timeoutMs = 0);
 
+        // Zero-copy variant of read() for the current multipart part.  Sets
+        // 'view' to the next run of part body bytes, pointing straight into
+        // the request's receive window, and returns its length (0 once the
+        // part is exhausted).  The view is only valid until the next call
+        // on this request.
+        size_t read_form_view(std::string_view & view, int timeoutMs = 0);
+
     private:
 
         enum CHUNK_STATE
@@ -239,6 +343,27 @@ namespace minerva
             m_chunked = value;
         }
 
+        void path_params(const route_table::match & m)
+        {
+            m_path_params      = m.params;
+            m_path_param_count = m.param_count;
+        }
+
+        // Folds in the transport calls and bytes httpd spent reading the
+        // header (and any body overflow that came with it).
+        void add_transport_stats(unsigned long reads, unsigned long polls,
+                                 size_t bytes)
+        {
+            m_read_syscalls += reads;
+            m_poll_syscalls += polls;
+            m_bytes_received += bytes;
+        }
+
+        void add_header_field(std::string_view name, std::string_view value);
+
+        // Splits and decodes m_query_string into m_query_params.
+        void parse_query() const;
+
         bool null_body_read_cl(int timeoutMs);
 
         bool null_body_read_chunked(int timeoutMs);
@@ -247,14 +372,52 @@ namespace minerva
 
         std::istream & read_fully_chunked(int timeoutMs);
 
-        size_t read_cl(char * buf, size_t len, int timeoutMs);
+        // With view set, body bytes are not copied to buf; *view is pointed
+        // at them in the read-ahead buffer instead (see consume()).
+        size_t read_cl(char * buf, size_t len, int timeoutMs,
+                       std::string_view * view = nullptr);
 
-        size_t read_chunked(char * buf, size_t len, int timeoutMs);
+        size_t read_chunked(char * buf, size_t len, int timeoutMs,
+                            std::string_view * view = nullptr);
 
+        // Size of the body read-ahead buffer.  Reads of at least this size
+        // bypass it and go straight to the connection.
+        static constexpr size_t READ_AHEAD_SIZE = 64 * 1024;
+
+        // Return up to len body bytes, serving from the read-ahead buffer
+        // and refilling it with one large transport read when empty.
         size_t read_from_socket(char * buf, size_t len,
                                 minerva::timer & timer,
                                 int timeoutMs);
 
+        // As read_from_socket(), but view is pointed at the bytes in the
+        // read-ahead buffer, which is refilled in place for any length.
+        size_t view_from_socket(std::string_view & view, size_t len,
+                                minerva::timer & timer,
+                                int timeoutMs);
+
+        // Refill the empty read-ahead buffer with one transport read.
+        void fill_read_ahead(minerva::timer & timer, int timeoutMs);
+
+        // Move unread m_overflow bytes back to the front of the read-ahead
+        // buffer, which they precede on the wire. The buffer never grows
+        // past READ_AHEAD_SIZE; when both do not fit, only the next max
+        // bytes are staged and the rest stays queued in m_overflow.
+        void overflow_to_read_ahead(size_t max);
+
+        // Poll until the connection is readable; throws on shutdown, error
+        // or timeout.
+        void wait_readable(minerva::timer & timer, int timeoutMs);
+
+        // Write all of [buf, buf+len) to fd; throws on error.
+        static void write_fd(int fd, const char * buf, size_t len);
+
+        // Poll and read once from the connection; never reads past the end
+        // of a content-length body.
+        size_t socket_read(char * buf, size_t len,
+                           minerva::timer & timer,
+                           int timeoutMs);
+
         // ---- multipart/form-data streaming engine ----
 
         enum MP_STATE
@@ -265,23 +428,43 @@ namespace minerva
             MP_DONE      // closing boundary consumed
         };
 
+        // Size of the contiguous multipart receive window.  The window only
+        // grows past this to hold an over-long part header line.
+        static constexpr size_t MP_WINDOW_SIZE = 64 * 1024;
+
         // Pull up to len decoded body bytes from the transport (content-length
         // or chunked), returning 0 at end of body.
         size_t read_raw_body(char * buf, size_t len, int timeoutMs);
 
+        // Append decoded body bytes to the tail of the multipart window,
+        // compacting or growing it first as needed.  Returns false at end of
+        // body.
+        bool mp_fill(int timeoutMs);
+
         // Read a single CRLF-terminated line from the decoded body into 'line'
         // (without the trailing CRLF).  Returns false at end of body.
         bool mp_read_line(std::string & line, int timeoutMs);
 
-        // Locate the boundary delimiter ("\r\n--<boundary>") in m_mp_raw.
-        // Returns the offset or m_mp_raw.size()+1 when not found.
-        size_t mp_find_delim() const;
+        // Build the Boyer-Moore-Horspool skip table for m_mp_delim.
+        void mp_init_skip_table();
+
+        // Locate the boundary delimiter ("\r\n--<boundary>") in the window
+        // using the skip table.  Returns the offset from the window start or
+        // std::string::npos when not found; bytes already ruled out are not
+        // rescanned on the next call.
+        size_t mp_find_delim();
 
-        // Consume the boundary delimiter at the front of m_mp_raw and move to
-        // MP_HEADERS or MP_DONE.
+        // Consume the boundary delimiter at the front of the window and move
+        // to MP_HEADERS or MP_DONE.
         void mp_consume_delimiter(int timeoutMs);
 
-        // Deliver (or discard) current part body bytes up to the delimiter.
+        // Length of the run of current part body bytes at the front of the
+        // window, filling from the transport as needed.  The bytes are not
+        // consumed.  Returns 0 (after consuming the delimiter) when the
+        // current part is exhausted.
+        size_t mp_body_avail(int timeoutMs);
+
+        // Copy (or discard) current part body bytes up to the delimiter.
         // Returns 0 when the current part is exhausted.
         size_t mp_body_read(char * out, size_t maxlen, bool discard,
                             int timeoutMs);
@@ -305,16 +488,35 @@ namespace minerva
         bool                                                 m_partial_read  = false;
         size_t                                               m_total_read    = 0;
         size_t                                               m_offset        = 0;
-        std::map<std::string, std::string, minerva::ci_less> m_headers;
+        // The first m_header_count entries are this request's; the rest
+        // keep their strings' capacity for later requests.
+        std::vector<header_field>                            m_headers;
+        size_t                                               m_header_count  = 0;
         METHOD                                               m_method        {METHOD::GET};
         bool                                                 m_http11        {false};
         long long                                            m_content_length{0};
         std::string                                          m_path;
-        std::map<std::string, std::string, minerva::ci_less> m_query_params;
         http_content_type::code                              m_content_type  {http_content_type::code::CONTENT_TYPE_UNKNOWN};
         std::string                                          m_query_string;
+        // Decoded copy of m_query_string that m_query_params points into;
+        // both are filled on first access.
+        mutable std::string                                  m_query_arena;
+        mutable std::vector<query_param>                     m_query_params;
+        mutable bool                                         m_query_parsed  = false;
         http_context &                                       m_ctx;
         std::deque<char>                                     m_overflow;
+        // Read-ahead buffer: unconsumed bytes live in [m_ra_begin, m_ra_end).
+        // m_wire_left counts content-length body bytes not yet pulled off
+        // the connection so the read-ahead never swallows the next request.
+        std::vector<char>                                    m_ra_buf;
+        size_t                                               m_ra_begin      = 0;
+        size_t                                               m_ra_end        = 0;
+        size_t                                               m_wire_left     = 0;
+        unsigned long                                        m_read_syscalls = 0;
+        unsigned long                                        m_poll_syscalls = 0;
+        unsigned long long                                   m_bytes_received = 0;
+        std::array<route_table::param, route_table::MAX_PARAMS> m_path_params{};
+        size_t                                               m_path_param_count = 0;
         std::optional<std::stringstream>                     m_fullbuf;
         bool                                                 m_keep_alive    = true;
         bool                                                 m_continue_100  = false;
@@ -323,7 +525,14 @@ namespace minerva
         // multipart/form-data parsing state
         std::string                                          m_mp_boundary;
         std::string                                          m_mp_delim;
-        std::deque<char>                                     m_mp_raw;
+        // Contiguous receive window: unconsumed bytes live in
+        // [m_mp_begin, m_mp_end) and the delimiter search resumes at
+        // m_mp_scan.
+        std::vector<char>                                    m_mp_buf;
+        size_t                                               m_mp_begin          = 0;
+        size_t                                               m_mp_end            = 0;
+        size_t                                               m_mp_scan           = 0;
+        std::array<uint16_t, 256>                            m_mp_skip           {};
         MP_STATE                                             m_mp_state          = MP_STATE::MP_INIT;
         bool                                                 m_multipart_active  = false;
     };
@@ -1,4 +1,6 @@
 #include <cassert>
+#include <algorithm>
+#include <charconv>
 #include "http_response.h"
 #include "http_context.h"
 #include "http_exception.h"
@@ -8,30 +10,100 @@
 namespace minerva
 {
 
-    std::string http_response::get_status_code_string(http_response_code code)
+    namespace
     {
-        switch (code)
-        {
-        case HTTP_RETCODE_SUCCESS:           return "Success";
-        case HTTP_RETCODE_CREATED:           return "Resource created";
-        case HTTP_RETCODE_NO_CONTENT:        return "No content";
-        case HTTP_RETCODE_NOT_MODIFIED:      return "Not modified";
-        case HTTP_RETCODE_BAD_REQUEST:       return "Bad request";
-        case HTTP_RETCODE_UNAUTHORIZED:      return "Unauthorized";
-        case HTTP_RETCODE_FORBIDDEN:         return "Forbidden";
-        case HTTP_RETCODE_NOT_FOUND:         return "Not Found";
-        case HTTP_RETCODE_METHOD_DENIED:     return "Method Not Allowed";
-        case HTTP_RETCODE_CONFLICT:          return "Conflict";
-        case HTTP_RETCODE_GONE:              return "Gone";
-        case HTTP_RETCODE_LENGTH_REQ:        return "Length Required";
-        case HTTP_RETCODE_REQ_TOO_LARGE:     return "Request Too Large";
-        case HTTP_RETCODE_URI_TOO_LONG:      return "Request URI Too Long";
-        case HTTP_RETCODE_INT_SERVER_ERR:    return "Internal Server Error";
-        case HTTP_RETCODE_NOT_IMPLEMENTED:   return "Not Implemented";
-        case HTTP_RETCODE_UNAVAILABLE:       return "Service Unavailable";
-        case HTTP_RETCODE_VER_NOT_SUPPORTED: return "HTTP Version Not Supported";
-        }
-        return "Internal Server Error";
+        struct status_entry
+        {
+            int              code;
+            std::string_view reason;
+            std::string_view line11;
+            std::string_view line10;
+        };
+
+#define MINERVA_STATUS(c, r)                            \
+        { c, r, "HTTP/1.1 " #c " " r "\r\n", "HTTP/1.0 " #c " " r "\r\n" }
+
+        // Codes missing from the table are rendered generically; the last
+        // entry stands in for values that are not a status code at all.
+        constexpr status_entry STATUS_TABLE[] = {
+            MINERVA_STATUS(200, "Success"),
+            MINERVA_STATUS(201, "Resource created"),
+            MINERVA_STATUS(204, "No content"),
+            MINERVA_STATUS(304, "Not modified"),
+            MINERVA_STATUS(400, "Bad request"),
+            MINERVA_STATUS(401, "Unauthorized"),
+            MINERVA_STATUS(403, "Forbidden"),
+            MINERVA_STATUS(404, "Not Found"),
+            MINERVA_STATUS(405, "Method Not Allowed"),
+            MINERVA_STATUS(409, "Conflict"),
+            MINERVA_STATUS(410, "Gone"),
+            MINERVA_STATUS(411, "Length Required"),
+            MINERVA_STATUS(413, "Request Too Large"),
+            MINERVA_STATUS(414, "Request URI Too Long"),
+            MINERVA_STATUS(429, "Too Many Requests"),
+            MINERVA_STATUS(501, "Not Implemented"),
+            MINERVA_STATUS(503, "Service Unavailable"),
+            MINERVA_STATUS(505, "HTTP Version Not Supported"),
+            MINERVA_STATUS(500, "Internal Server Error"),
+        };
+
+#undef MINERVA_STATUS
+
+        constexpr size_t STATUS_COUNT =
+            sizeof(STATUS_TABLE) / sizeof(STATUS_TABLE[0]);
+
+        constexpr const status_entry * find_status(int code)
+        {
+            for (size_t i = 0; i < STATUS_COUNT; i++)
+            {
+                if (STATUS_TABLE[i].code == code)
+                {
+                    return &STATUS_TABLE[i];
+                }
+            }
+            return nullptr;
+        }
+
+        constexpr const status_entry & INVALID_STATUS =
+            STATUS_TABLE[STATUS_COUNT - 1];
+
+        constexpr std::string_view UNKNOWN_REASON = "Unknown";
+
+        static_assert(find_status(404)->line11 == "HTTP/1.1 404 Not Found\r\n",
+                      "status table mismatch");
+        static_assert(INVALID_STATUS.line11 == "HTTP/1.1 500 Internal Server Error\r\n",
+                      "the last status entry must be the 500 line");
+
+        constexpr bool valid_status(int code)
+        {
+            return code >= 100 && code <= 999;
+        }
+
+        constexpr std::string_view HDR_CONTENT_TYPE      = "Content-Type: ";
+        constexpr std::string_view HDR_BOUNDARY          = "; boundary=";
+        constexpr std::string_view HDR_KEEP_ALIVE        = "Connection: keep-alive\r\n";
+        constexpr std::string_view HDR_CLOSE             = "Connection: close\r\n";
+        constexpr std::string_view HDR_CHUNKED           = "Transfer-Encoding: chunked\r\n";
+        constexpr std::string_view HDR_CONTENT_LENGTH    = "Content-Length: ";
+        constexpr std::string_view HDR_SEPARATOR         = ": ";
+        constexpr std::string_view HDR_CRLF              = "\r\n";
+    }
+
+    std::string_view http_response::get_status_code_string(http_response_code code)
+    {
+        const status_entry * e = find_status(code);
+        return e ? e->reason : UNKNOWN_REASON;
+    }
+
+    std::string_view http_response::get_status_line(http_response_code code,
+                                                    bool http11)
+    {
+        const status_entry * e = find_status(code);
+        if (!e)
+        {
+            return std::string_view();
+        }
+        return http11 ? e->line11 : e->line10;
     }
 
     constexpr static size_t BUFFER_SIZE = 15*1024;
@@ -43,6 +115,36 @@ namespace minerva
                v.find('\0') == std::string::npos;
     }
 
+    void http_response::reset()
+    {
+        m_status_code         = http_response_code::HTTP_RETCODE_INT_SERVER_ERR;
+        m_content_type        = http_content_type::code::CONTENT_TYPE_UNKNOWN;
+        // A buffer grown by a large body goes back to the allocator rather
+        // than staying with the context.
+        if (m_response_stream.tellp() > static_cast<std::streamoff>(KEEP_STREAM_SIZE))
+        {
+            m_response_stream = std::stringstream();
+        }
+        else
+        {
+            m_response_stream.str(std::string());
+            m_response_stream.clear();
+        }
+        m_status_message.clear();
+        m_http11              = true;
+        m_header_count        = 0;
+        m_chunked             = false;
+        m_nosize              = false;
+        m_should_write_header = true;
+        m_header_written      = false;
+        m_multipart_boundary.clear();
+        m_part_open           = false;
+        m_bytes_sent          = 0;
+        m_first_byte_us       = -1;
+        m_write_syscalls      = 0;
+        m_poll_syscalls       = 0;
+    }
+
     bool http_response::send_buffer(std::istream & is)
     {
         is.seekg(0, is.end);
@@ -57,91 +159,107 @@ namespace minerva
 
         char buf[BUFFER_SIZE];
 
-        bool writing = true;
-
         size_t to_read = std::min(length, BUFFER_SIZE);
         while (to_read > 0)
         {
             is.read(buf, to_read);
             length -= to_read;
 
-            ssize_t total = 0;
-            while (total < to_read)
+            if (!send_buffer(buf, to_read))
             {
-                ssize_t left = to_read - total;
-                ssize_t sent;
+                return false;
+            }
+            to_read = std::min(length, BUFFER_SIZE);
+        }
+        return true;
+    }
 
-                if (m_ctx.should_shutdown())
-                {
-                    return false;
-                }
+    bool http_response::send_buffer(const char * buf, size_t len)
+    {
+        bool writing = true;
 
-                // check for aggregate timeout
-                if (m_ctx.timed_out())
-                {
-                    LOG_DEBUG("Socket write timeout");
-                    return false;
-                }
+        size_t total = 0;
+        while (total < len)
+        {
+            ssize_t left = len - total;
+            ssize_t sent;
 
-                bool read_flag = !writing;
-                bool write_flag = true;
-                bool error_flag = writing;
+            if (m_ctx.should_shutdown())
+            {
+                return false;
+            }
 
-                int poll_status =
-                    m_ctx.conn()->poll(read_flag, write_flag, error_flag,
-                                       500);
+            // check for aggregate timeout
+            if (m_ctx.timed_out())
+            {
+                LOG_DEBUG("Socket write timeout");
+                return false;
+            }
 
-                if (poll_status < 0)
-                {
-                    LOG_WARN_ERRNO("Poll error", errno);
-                    return false;
-                }
-                else if (poll_status == 0)
-                {
-                    // timeout
-                    continue;
-                }
-                else if (error_flag)
-                {
-                    LOG_DEBUG("Poll write socket error");
-                    return false;
-                }
+            bool read_flag = !writing;
+            bool write_flag = true;
+            bool error_flag = writing;
 
-                auto status = m_ctx.conn()->write(buf + total, left, sent);
-                switch (status)
-                {
-                case connection::CONNECTION_ERROR:
-                {
-                    LOG_DEBUG_ERRNO("Http client timeout or socketwrite error",
-                                    errno);
-                    return false;
-                }
-                break;
-                case connection::CONNECTION_OK:
-                {
-                    writing = true;
-                    total += sent;
-                }
-                break;
-                case connection::CONNECTION_WANTS_WRITE:
-                {
-                    writing = true;
-                }
-                break;
-                case connection::CONNECTION_WANTS_READ:
-                {
-                    writing = false;
-                }
-                break;
-                case connection::CONNECTION_CLOSED:
+            int poll_status =
+                m_ctx.conn()->poll(read_flag, write_flag, error_flag,
+                                   500);
+            ++m_poll_syscalls;
+
+            if (poll_status < 0)
+            {
+                LOG_WARN_ERRNO("Poll error", errno);
+                return false;
+            }
+            else if (poll_status == 0)
+            {
+                // timeout
+                continue;
+            }
+            else if (error_flag)
+            {
+                LOG_DEBUG("Poll write socket error");
+                return false;
+            }
+
+            auto status = m_ctx.conn()->write(buf + total, left, sent);
+            ++m_write_syscalls;
+            switch (status)
+            {
+            case connection::CONNECTION_ERROR:
+            {
+                LOG_DEBUG_ERRNO("Http client timeout or socketwrite error",
+                                errno);
+                return false;
+            }
+            break;
+            case connection::CONNECTION_OK:
+            {
+                writing = true;
+                total += sent;
+                if (m_bytes_sent == 0 && sent > 0)
                 {
-                    LOG_DEBUG("Connection closed during write");
-                    return false;
-                }
-                break;
+                    m_first_byte_us = m_ctx.get_elapsed_microseconds();
                 }
+                m_bytes_sent += sent;
+            }
+            break;
+            case connection::CONNECTION_WANTS_WRITE:
+            {
+                writing = true;
+            }
+            break;
+            case connection::CONNECTION_WANTS_READ:
+            {
+                writing = false;
+            }
+            break;
+            case connection::CONNECTION_CLOSED:
+            {
+                LOG_DEBUG("Connection closed during write");
+                return false;
+            }
+            break;
             }
-            to_read = std::min(length, BUFFER_SIZE);
         }
         return true;
     }
@@ -153,8 +271,6 @@ namespace minerva
             return true;
         }
 
-        std::stringstream os;
-
         auto content_length = m_ctx.response().response_stream().tellp();
         // handle unwritten stream
         if (content_length < 0)
@@ -162,92 +278,125 @@ namespace minerva
             content_length = 0;
         }
 
-        // get status code and message
         http_response::http_response_code code = status_code();
-        std::string status_msg = status_message();
-        if (status_msg.size() == 0)
+        if (!valid_status(code))
         {
-            status_msg = http_response::get_status_code_string(code);
+            // Not something a status line can carry; send a 500 and make
+            // status_code() (and so the access log) agree with the wire.
+            LOG_WARN("invalid HTTP response code " << static_cast<int>(code));
+            code = static_cast<http_response_code>(INVALID_STATUS.code);
+            status_code(code);
         }
 
         LOG_DEBUG("HTTP response code: " << code);
 
-        // get content type
-        auto ct = content_type();
-        std::string content_type_str = 
-            http_content_type::get_content_type_string(ct);
+        std::string_view status_line = get_status_line(code, is_http11());
+        char status_buf[32];
+        if (status_line.empty())
+        {
+            // A well-formed code the table does not know goes out as is.
+            std::string_view version = is_http11() ? "HTTP/1.1 " : "HTTP/1.0 ";
+            char * p = std::copy(version.begin(), version.end(), status_buf);
+            p = std::to_chars(p, status_buf + sizeof(status_buf),
+                              static_cast<int>(code)).ptr;
+            *p++ = ' ';
+            p = std::copy(UNKNOWN_REASON.begin(), UNKNOWN_REASON.end(), p);
+            p = std::copy(HDR_CRLF.begin(), HDR_CRLF.end(), p);
+            status_line = std::string_view(status_buf, p - status_buf);
+        }
 
-        // write header
-        if (is_http11())
+        auto ct = content_type();
+        std::string_view content_type_str;
+        if (ct != http_content_type::CONTENT_TYPE_UNKNOWN)
         {
-            os << "HTTP/1.1 ";
+            content_type_str = http_content_type::get_content_type_string(ct);
         }
-        else
+        bool multipart = ct == http_content_type::CONTENT_TYPE_MULTIPART_FORM;
+
+        char length_buf[24];
+        std::string_view length_str;
+        if (!no_size() && !chunked())
         {
-            os << "HTTP/1.0 ";
+            auto res = std::to_chars(length_buf, length_buf + sizeof(length_buf),
+                                     static_cast<long long>(content_length));
+            length_str = std::string_view(length_buf, res.ptr - length_buf);
         }
-        os << code;
-        os << " ";
-        os << http_response::get_status_code_string(code);
-        os << CRLF;
-        if (ct != http_content_type::CONTENT_TYPE_UNKNOWN)
+
+        // Size the output exactly so the header is rendered with at most
+        // one allocation, none once the buffer has grown, and sent with a
+        // single write.
+        size_t size = status_line.size() + HDR_KEEP_ALIVE.size() +
+            HDR_CRLF.size();
+        if (!content_type_str.empty())
         {
-            os << "Content-Type: ";
-            os << content_type_str;
-            if (ct == http_content_type::CONTENT_TYPE_MULTIPART_FORM)
+            size += HDR_CONTENT_TYPE.size() + content_type_str.size() +
+                HDR_CRLF.size();
+            if (multipart)
             {
-                os << "; boundary=" << multipart_boundary();
+                size += HDR_BOUNDARY.size() + multipart_boundary().size();
             }
-            os << CRLF;
         }
-        if (m_ctx.request().keep_alive())
+        if (!no_size())
         {
-            os << "Connection: keep-alive";
+            size += chunked()
+                ? HDR_CHUNKED.size()
+                : HDR_CONTENT_LENGTH.size() + length_str.size() + HDR_CRLF.size();
         }
-        else
+        for (size_t i = 0; i < m_header_count; ++i)
+        {
+            size += m_headers[i].name.size() + HDR_SEPARATOR.size() +
+                m_headers[i].value.size() + HDR_CRLF.size();
+        }
+
+        std::string & os = m_header_buf;
+        os.clear();
+        os.reserve(size);
+
+        os.append(status_line);
+        if (!content_type_str.empty())
         {
-            os << "Connection: close";
+            os.append(HDR_CONTENT_TYPE);
+            os.append(content_type_str);
+            if (multipart)
+            {
+                os.append(HDR_BOUNDARY);
+                os.append(multipart_boundary());
+            }
+            os.append(HDR_CRLF);
         }
-        os << CRLF;
+        os.append(m_ctx.request().keep_alive() ? HDR_KEEP_ALIVE : HDR_CLOSE);
         if (!no_size())
         {
             if (chunked())
             {
-                os << "Transfer-Encoding: chunked";
-                os << CRLF;
+                os.append(HDR_CHUNKED);
             }
             else
             {
-                os << "Content-Length: ";
-                os << content_length;
-                os << CRLF;
+                os.append(HDR_CONTENT_LENGTH);
+                os.append(length_str);
+                os.append(HDR_CRLF);
             }
         }
-        for (auto & pair : headers())
+        for (size_t i = 0; i < m_header_count; ++i)
         {
-            const std::string & k = std::get<0>(pair);
-            const std::string & v = std::get<1>(pair);
+            const std::string & k = m_headers[i].name;
+            const std::string & v = m_headers[i].value;
             if (!header_value_safe(k) || !header_value_safe(v))
             {
                 LOG_WARN("refusing to write header with CR/LF/NUL: " << k);
                 continue;
             }
-            os << k;
-            os << ": ";
-            os << v;
-            os << CRLF;
-        }
-        os << CRLF;
-        os.flush();
-        // check for write failures
-        if (os.fail())
-        {
-            return false;
+            os.append(k);
+            os.append(HDR_SEPARATOR);
+            os.append(v);
+            os.append(HDR_CRLF);
         }
+        os.append(HDR_CRLF);
 
         LOG_DEBUG("sending HTTP response header");
 
-        return send_buffer(os);
+        return send_buffer(os.data(), os.size());
     }
 
     bool http_response::flush_final_chunk()
@@ -268,12 +417,9 @@ namespace minerva
         {
 
             LOG_DEBUG("flushing final chunk");
-            
-            std::stringstream ss;
-            
-            ss << std::hex << "0\r\n\r\n";
-            
-            if (!send_buffer(ss))
+
+            static constexpr std::string_view FINAL_CHUNK = "0\r\n\r\n";
+            if (!send_buffer(FINAL_CHUNK.data(), FINAL_CHUNK.size()))
             {
                 return false;
             }
@@ -305,14 +451,18 @@ namespace minerva
             if (!no_size())
             {
 
-                std::stringstream ss;
                 // write chunk size in hex
-                ss << std::hex << sz << "\r\n";
-                std::string hdr = ss.str();
-                
-                LOG_DEBUG("sending chunk header: " << hdr);
-                
-                if (!send_buffer(ss))
+                char hdr[24];
+                auto res = std::to_chars(hdr, hdr + sizeof(hdr) - 2,
+                                         static_cast<unsigned long long>(sz),
+                                         16);
+                *res.ptr++ = '\r';
+                *res.ptr++ = '\n';
+
+                LOG_DEBUG("sending chunk header: " <<
+                          std::string_view(hdr, res.ptr - hdr));
+
+                if (!send_buffer(hdr, res.ptr - hdr))
                 {
                     throw http_exception("failed to write chunk header to http client");
                 }
@@ -329,9 +479,7 @@ namespace minerva
             {
                 LOG_DEBUG("sending chunk terminator");
                 
-                std::stringstream ss;
-                ss << "\r\n";
-                if (!send_buffer(ss))
+                if (!send_buffer(HDR_CRLF.data(), HDR_CRLF.size()))
                 {
                     throw http_exception("failed to write chunk terminator to http client");
                 }
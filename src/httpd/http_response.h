@@ -2,9 +2,9 @@
 
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <vector>
-#include <tuple>
 #include <util/string_utils.h>
 #include "http_content_type.h"
 
@@ -42,6 +42,7 @@ namespace minerva
             HTTP_RETCODE_LENGTH_REQ        = 411, // Length Required
             HTTP_RETCODE_REQ_TOO_LARGE     = 413, // Request Too Large
             HTTP_RETCODE_URI_TOO_LONG      = 414, // Request URI Too Long
+            HTTP_RETCODE_TOO_MANY_REQUESTS = 429, // Too Many Requests
 
             // 5xx
             HTTP_RETCODE_INT_SERVER_ERR    = 500, // Internal Server Error
@@ -64,7 +65,15 @@ namespace minerva
         http_response(http_response &&)                  = delete;
         http_response & operator=(http_response &&)      = delete;
 
-        static std::string get_status_code_string(http_response_code code);
+        // Reason phrase for a status code; points into a static table.
+        // "Unknown" for codes the table does not list.
+        static std::string_view get_status_code_string(http_response_code code);
+
+        // Complete pre-rendered status line, including the trailing CRLF,
+        // e.g. "HTTP/1.1 200 Success\r\n". Empty for codes the table does
+        // not list; write_header() renders those generically.
+        static std::string_view get_status_line(http_response_code code,
+                                                bool http11);
 
         http_response_code status_code() const
         {
@@ -196,16 +205,38 @@ namespace minerva
             return m_response_stream;
         }
 
-        void add_header(const std::string & key, const std::string & value)
+        struct header_field
+        {
+            std::string name;
+            std::string value;
+        };
+
+        // Headers are written in the order added; a name may repeat.
+        void add_header(std::string_view key, std::string_view value)
         {
-            m_headers.push_back(std::make_tuple(key, value));
+            if (m_header_count == m_headers.size())
+            {
+                m_headers.emplace_back();
+            }
+            header_field & f = m_headers[m_header_count++];
+            f.name.assign(key);
+            f.value.assign(value);
         }
 
-        const std::vector<std::tuple<std::string, std::string>> & headers() const
+        size_t header_count() const
         {
-            return m_headers;
+            return m_header_count;
         }
 
+        const header_field & header_at(size_t i) const
+        {
+            return m_headers[i];
+        }
+
+        // Returns the response to its just-constructed state for the next
+        // request, keeping the header strings and the stream buffer.
+        void reset();
+
         void no_size(bool no)
         {
             m_nosize = no;
@@ -236,8 +267,34 @@ namespace minerva
             return m_header_written;
         }
 
+        // Bytes written to the transport for this response.
+        unsigned long long bytes_sent() const
+        {
+            return m_bytes_sent;
+        }
+
+        // Transport write() and poll() calls made sending this response.
+        unsigned long write_syscalls() const
+        {
+            return m_write_syscalls;
+        }
+
+        unsigned long poll_syscalls() const
+        {
+            return m_poll_syscalls;
+        }
+
+        // Request-relative time the first response byte was written, in
+        // microseconds; -1 if nothing has been sent.
+        long long first_byte_us() const
+        {
+            return m_first_byte_us;
+        }
+
         bool send_buffer(std::istream & is);
 
+        bool send_buffer(const char * data, size_t len);
+
         bool write_header();
 
         void flush();
@@ -302,18 +359,30 @@ namespace minerva
 
         constexpr static const char * CRLF = "\r\n";
 
+        // Largest response stream buffer reset() keeps.
+        constexpr static size_t KEEP_STREAM_SIZE = 64 * 1024;
+
         http_response_code                                m_status_code;
         http_content_type::code                           m_content_type;
         std::stringstream                                 m_response_stream;
         std::string                                       m_status_message;
         bool                                              m_http11;
         http_context &                                    m_ctx;
-        std::vector<std::tuple<std::string, std::string>> m_headers;
+        // The first m_header_count entries are this response's; the rest
+        // keep their strings' capacity for later responses.
+        std::vector<header_field>                         m_headers;
+        size_t                                            m_header_count       = 0;
+        // Rendered header, reused across responses.
+        std::string                                       m_header_buf;
         bool                                              m_chunked            = false;
         bool                                              m_nosize             = false;
         bool                                              m_should_write_header = true;
         bool                                              m_header_written     = false;
         std::string                                       m_multipart_boundary;
         bool                                              m_part_open          = false;
+        unsigned long long                                m_bytes_sent         = 0;
+        long long                                         m_first_byte_us      = -1;
+        unsigned long                                     m_write_syscalls     = 0;
+        unsigned long                                     m_poll_syscalls      = 0;
     };
 }
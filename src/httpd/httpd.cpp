@@ -2,6 +2,7 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <cassert>
+#include <cmath>
 #include <cstring>
 #include <thread>
 #include <sstream>
@@ -11,6 +12,8 @@
 #include <util/log.h>
 #include <util/string_utils.h>
 #include <util/ssl_connection.h>
+#include <util/alloc_counter.h>
+#include <util/unique_command.h>
 #include <owl/locks.h>
 #include "httpd.h"
 #include "http_auth.h"
@@ -24,8 +27,12 @@ namespace minerva
 {
 
     httpd::httpd() : m_active_count(0),
-                     m_request_count(0)
+                     m_request_count(0),
+                     m_read_syscall_count(0),
+                     m_poll_syscall_count(0)
     {
+        name_lock(lock, "httpd");
+        name_lock(m_controller_lock, "httpd.controllers");
     }
 
     std::shared_ptr<connection> httpd::create_connection(int socket, PROTOCOL protocol)
@@ -58,26 +65,72 @@ namespace minerva
                                     controller * controller)
     {
         LOG_DEBUG("Registering controller " << path.c_str());
-        std::unique_lock<std::shared_mutex> lk(m_controller_lock);
+        std::unique_lock<instrumented_shared_mutex> lk(m_controller_lock);
         controller_map[path] = controller;
+        if (m_routes_live)
+        {
+            compile_routes();
+        }
     }
 
     void httpd::register_default_controller(controller * controller)
     {
         LOG_DEBUG("Registering default controller");
-        std::unique_lock<std::shared_mutex> lk(m_controller_lock);
+        std::unique_lock<instrumented_shared_mutex> lk(m_controller_lock);
         m_default_controller = controller;
+        if (m_routes_live)
+        {
+            compile_routes();
+        }
+    }
+
+    namespace
+    {
+        // Generations are unique across httpd instances, so a thread's
+        // cached table can never be mistaken for another server's.
+        std::atomic<uint64_t> s_route_generation{0};
+
+        struct cached_routes
+        {
+            uint64_t                           generation = 0;
+            std::shared_ptr<const route_table> table;
+        };
+
+        thread_local cached_routes t_cached_routes;
+    }
+
+    void httpd::compile_routes()
+    {
+        m_routes = std::make_shared<const route_table>(controller_map,
+                                                       m_default_controller);
+        m_routes_live = true;
+        m_routes_generation.store(++s_route_generation,
+                                  std::memory_order_release);
+    }
+
+    const route_table * httpd::current_routes()
+    {
+        cached_routes & cache = t_cached_routes;
+        const uint64_t generation =
+            m_routes_generation.load(std::memory_order_acquire);
+        if (cache.generation != generation)
+        {
+            std::shared_lock<instrumented_shared_mutex> lk(m_controller_lock);
+            cache.table = m_routes;
+            cache.generation = m_routes_generation.load(std::memory_order_relaxed);
+        }
+        return cache.table.get();
     }
 
     controller * httpd::get_default_controller()
     {
-        std::shared_lock<std::shared_mutex> lk(m_controller_lock);
+        std::shared_lock<instrumented_shared_mutex> lk(m_controller_lock);
         return m_default_controller;
     }
 
     http_auth_db * httpd::get_auth_db()
     {
-        std::unique_lock<std::mutex> lk(lock);
+        std::unique_lock<instrumented_mutex> lk(lock);
         return m_auth_db;
     }
 
@@ -107,6 +160,9 @@ namespace minerva
 
         // create keep alive thread
         add_thread(std::bind(&httpd::persist_thread_fn, this));
+
+        // create closing thread
+        add_thread([this]() { m_closer.run(); });
     }
 
     void httpd::start_listeners()
@@ -182,9 +238,45 @@ namespace minerva
     {
         component::start();
 
+        {
+            // Picks up handlers registered after their controller was.
+            std::unique_lock<instrumented_shared_mutex> lk(m_controller_lock);
+            compile_routes();
+        }
+
+        {
+            std::unique_lock<std::mutex> lk(m_date_lock);
+            m_date_running = true;
+        }
+        schedule_date_refresh();
+
+        if (m_access_log)
+        {
+            m_access_log->start();
+        }
+
         start_listeners();
     }
 
+    void httpd::schedule_date_refresh()
+    {
+        http_date::refresh();
+
+        // Fire just after the next second boundary.
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        int delay = static_cast<int>(1000 - ms % 1000) + 1;
+
+        std::unique_lock<std::mutex> lk(m_date_lock);
+        if (m_date_running)
+        {
+            m_date_job = schedule_job([this]()
+            {
+                schedule_date_refresh();
+            }, delay);
+        }
+    }
+
     void httpd::stop()
     {
         // Wake any thread waiting on hup so it observes shutdown.
@@ -214,10 +306,18 @@ namespace minerva
         // shutdown condvar; do it explicitly here too so this method is
         // safe to call directly.
         {
-            std::unique_lock<std::mutex> lk(lock);
+            std::unique_lock<instrumented_mutex> lk(lock);
             cond.notify_all();
         }
 
+        {
+            std::unique_lock<std::mutex> lk(m_date_lock);
+            m_date_running = false;
+            cancel_job(m_date_job);
+        }
+
+        m_closer.stop();
+
         component::stop();
     }
 
@@ -240,7 +340,7 @@ namespace minerva
         }
 
         {
-            std::unique_lock<std::mutex> lk(lock);
+            std::unique_lock<instrumented_mutex> lk(lock);
             for (auto it = m_socket_map.begin();
                  it != m_socket_map.end();
                  it++)
@@ -252,6 +352,13 @@ namespace minerva
                 // Smart pointer automatically cleans up
             }
             m_socket_map.clear();
+            m_spare_nodes.clear();
+        }
+
+        // Handler threads are done; write out every buffered record.
+        if (m_access_log)
+        {
+            m_access_log->stop();
         }
 
         component::release();
@@ -284,71 +391,7 @@ namespace minerva
     }
     void httpd::shutdown_write_async(std::shared_ptr<connection> conn)
     {
-        schedule_job([this, conn]()
-                     {
-                         shutdown(conn);
-                         conn->shutdown_write();
-                         // Smart pointer automatically manages cleanup
-                     }, 0);
-    }
-
-    bool httpd::shutdown(std::shared_ptr<connection> conn)
-    {
-        timer t;
-
-        while (!should_shutdown() && t.get_elapsed_milliseconds() < 15000)
-        {
-            bool reading = false;
-
-            auto status = conn->shutdown();
-            switch (status)
-            {
-            case connection::CONNECTION_STATUS::CONNECTION_OK:
-            {
-                return true;
-            }
-            break;
-            case connection::CONNECTION_STATUS::CONNECTION_WANTS_READ:
-            {
-                reading = true;
-            }
-            break;
-            case connection::CONNECTION_STATUS::CONNECTION_WANTS_WRITE:
-            {
-                reading = false;
-            }
-            break;
-            case connection::CONNECTION_STATUS::CONNECTION_CLOSED:
-            {
-                return false;
-            }
-            break;
-            case connection::CONNECTION_STATUS::CONNECTION_ERROR:
-            {
-                LOG_DEBUG("failed to terminate connection");
-                return false;
-            }
-            break;
-            }
-
-            bool read_flag = reading;
-            bool write_flag = !reading;
-            bool error_flag = true;
-
-            int err = 0;
-            while (err == 0 && !should_shutdown() &&
-                   t.get_elapsed_milliseconds() < 15000)
-            {
-                err = conn->poll(read_flag, write_flag, error_flag, 100);
-            }
-            if (err < 0)
-            {
-                LOG_DEBUG_ERRNO("poll during terminate failed", errno);
-                return false;
-            }
-        }
-        LOG_DEBUG("timeout attempting to terminate connection");
-        return false;
+        m_closer.close(std::move(conn));
     }
 
     void httpd::persist_thread_fn()
@@ -365,11 +408,15 @@ namespace minerva
                                 socklen_t>> map;
             std::vector<connection::shared_poll_fd> fds;
             std::vector<std::shared_ptr<connection>> to_close;
+            std::vector<std::pair<std::tuple<std::shared_ptr<connection>,
+                                             struct sockaddr_storage,
+                                             socklen_t>,
+                                  int64_t>> to_dispatch;
             std::map<int, std::shared_ptr<connection>> fd_to_conn;
 
             // wait for sockets or a shutdown
             {
-                std::unique_lock<std::mutex> lk(lock);
+                std::unique_lock<instrumented_mutex> lk(lock);
                 while (!should_shutdown() && m_socket_map.size() == 0)
                 {
                     cond.wait(lk);
@@ -403,7 +450,7 @@ namespace minerva
 
                 for (auto & key : to_erase)
                 {
-                    m_socket_map.erase(key);
+                    release_idle(key);
                 }
 
                 map = m_socket_map;
@@ -443,7 +490,7 @@ namespace minerva
             }
 
             {
-                std::unique_lock<std::mutex> lk(lock);
+                std::unique_lock<instrumented_mutex> lk(lock);
 
                 // handle any poll notices
                 for (auto & it : fds)
@@ -463,14 +510,14 @@ namespace minerva
                     if (it.error)
                     {
                         to_close.push_back(std::get<0>(map_it->second));
-                        m_socket_map.erase(key);
+                        release_idle(key);
                     }
                     else if (it.read)
                     {
                         auto to_send = map_it->second;
                         auto socket = std::get<0>(to_send);
 
-                        m_socket_map.erase(key);
+                        release_idle(key);
 
                         bool available;
                         bool success =
@@ -480,14 +527,10 @@ namespace minerva
                             // queue up request
                             LOG_DEBUG("dispatching keep alive connection: " <<
                                       socket->get_socket());
+                            m_metrics.keepalive_reused++;
 
-                            handler_thread_pool->queue_work_item([this, to_send] () {
-                                    struct sockaddr_storage addr = std::get<1>(to_send);
-
-                                    this->handle_request(std::get<0>(to_send),
-                                                         addr,
-                                                         std::get<2>(to_send));
-                                });
+                            to_dispatch.emplace_back(std::move(to_send),
+                                                     http_context::now_ns());
                         }
                         else
                         {
@@ -496,17 +539,17 @@ namespace minerva
                     }
                 }
             }
-            schedule_job([to_close]()
-                         {
-                             for (auto it : to_close)
-                             {
-                                 it->shutdown();
-                                 it->shutdown_write();
-                                 it->shutdown_read();
-                                 // Smart pointer automatically cleans up
-                             }
-                         }, 0);
+            // Admission may shed, which writes; do it outside the lock.
+            for (auto & [item, ready_ns] : to_dispatch)
+            {
+                dispatch(std::get<0>(item), std::get<1>(item), std::get<2>(item),
+                         ready_ns, 0);
+            }
             // shutdown connections
+            for (auto & conn : to_close)
+            {
+                m_closer.close(std::move(conn));
+            }
         }
     }
     
@@ -516,12 +559,39 @@ namespace minerva
     {
         LOG_DEBUG("put back: " << conn->get_socket());
 
-        std::unique_lock<std::mutex> lk(lock);
-        m_socket_map[conn] =
-            std::make_tuple(conn, addr, addr_len);
+        std::unique_lock<instrumented_mutex> lk(lock);
+        if (m_spare_nodes.empty())
+        {
+            m_socket_map[conn] =
+                std::make_tuple(conn, addr, addr_len);
+        }
+        else
+        {
+            auto node = std::move(m_spare_nodes.back());
+            m_spare_nodes.pop_back();
+            node.mapped() = std::make_tuple(conn, addr, addr_len);
+            node.key() = std::move(conn);
+            auto res = m_socket_map.insert(std::move(node));
+            if (!res.inserted)
+            {
+                res.position->second = std::move(res.node.mapped());
+            }
+        }
         cond.notify_all();
     }
 
+    void httpd::release_idle(const std::shared_ptr<connection> & key)
+    {
+        auto node = m_socket_map.extract(key);
+        if (node && m_spare_nodes.size() < MAX_SPARE_NODES)
+        {
+            // The node must not keep the connection open.
+            node.key().reset();
+            std::get<0>(node.mapped()).reset();
+            m_spare_nodes.push_back(std::move(node));
+        }
+    }
+
     void httpd::listener_thread_fn()
     {
         LOG_DEBUG("listening for http(s) connections");
@@ -627,6 +697,7 @@ namespace minerva
                 }
 
                 LOG_DEBUG("Accept Successful: " << http);
+                m_metrics.connections_accepted++;
                 
                 // queue up request
                 auto conn = create_connection(s, http ? PROTOCOL::HTTP : PROTOCOL::HTTPS);
@@ -636,7 +707,14 @@ namespace minerva
                 // delayed-ACK timer.
                 conn->no_delay(true);
                 
-                schedule_job([this, conn, addr, addr_len]()
+                const int64_t accepted_ns = http_context::now_ns();
+                if (http)
+                {
+                    // No handshake to wait for: admit or shed right here.
+                    dispatch(conn, addr, addr_len, accepted_ns, 0);
+                    continue;
+                }
+                schedule_job([this, conn, addr, addr_len, accepted_ns]()
                              {
                                  if (!accept(conn))
                                  {
@@ -645,10 +723,8 @@ namespace minerva
                                  }
                                  else
                                  {
-                                     // queue up request
-                                     handler_thread_pool->queue_work_item([this, conn, addr, addr_len] () {
-                                             this->handle_request(conn, addr, addr_len);
-                                         });
+                                     dispatch(conn, addr, addr_len, accepted_ns,
+                                              http_context::now_ns());
                                  }
                              }, 0);
 					      }
@@ -657,6 +733,50 @@ namespace minerva
         
     }
 
+    void httpd::dispatch(std::shared_ptr<connection> conn,
+                         const sockaddr_storage & addr, socklen_t addr_len,
+                         int64_t accepted_ns, int64_t handshake_ns)
+    {
+        const auto verdict = m_admission.admit();
+        if (verdict != admission_control::verdict::ADMIT)
+        {
+            shed(conn, verdict);
+            return;
+        }
+
+        // queue up request
+        const int64_t queued_ns = http_context::now_ns();
+        if (!handler_thread_pool->queue_work_item([this, conn, addr, addr_len,
+                                                   accepted_ns, handshake_ns,
+                                                   queued_ns] () {
+                m_admission.dequeued(queued_ns, http_context::now_ns());
+                this->handle_request(conn, addr, addr_len,
+                                     accepted_ns, handshake_ns);
+            }))
+        {
+            // Stopping: it was never queued.
+            m_admission.dequeued(queued_ns, queued_ns);
+        }
+    }
+
+    void httpd::shed(std::shared_ptr<connection> conn,
+                     admission_control::verdict why)
+    {
+        LOG_WARN_RATELIMITED(1000, "shedding load: " <<
+                             (why == admission_control::verdict::SHED_QUEUE ?
+                              "handler queue full" :
+                              "queueing delay above target"));
+
+        // The socket is non-blocking and the response small, so one write
+        // either takes it whole or the client is not reading anyway. The
+        // closer then reads what the client still sends: closing a socket
+        // with unread data resets it, which can discard the 503 in flight.
+        const auto response = m_admission.response();
+        ssize_t written = 0;
+        conn->write(response->data(), response->size(), written);
+        m_closer.close(std::move(conn), shed_linger_ms);
+    }
+
     bool httpd::accept(std::shared_ptr<connection> conn)
     {
         timer t;
@@ -724,6 +844,20 @@ namespace minerva
         {
             LOG_DEBUG("accepted");
         }
+        if (conn->is_secure())
+        {
+            if (accepted)
+            {
+                m_metrics.tls_handshakes++;
+                m_metrics.tls_handshake_time.record(
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::duration<double>(t.get_elapsed_time())).count());
+            }
+            else
+            {
+                m_metrics.tls_handshake_failures++;
+            }
+        }
         return accepted;
     }
 
@@ -735,17 +869,22 @@ namespace minerva
             return true;
         }
 
-        // get auth header
-        std::string auth_header;
-        ctx.request().header(AUTH_HDR, auth_header);
+        // get auth header; referenced in place so it is not copied
+        static const std::string NO_HEADER;
+        const std::string * hdr = ctx.request().find_header(AUTH_HDR);
+        const std::string & auth_header = hdr ? *hdr : NO_HEADER;
 
-        // basic header check
-        bool success =
+        // basic header check; a Digest header skips it, which would only
+        // fail and leave a stray Basic challenge on the response
+        const bool digest_hdr =
+            auth_header.compare(0, strlen(DIGEST_HDR), DIGEST_HDR) == 0;
+        bool success = !digest_hdr &&
             authenticate_basic(ctx,
                                auth_header,
                                auth_db->realm(),
                                *auth_db,
-                               user);
+                               user,
+                               &m_basic_auth_cache);
 
         // digest header check
         if (!success)
@@ -773,15 +912,68 @@ namespace minerva
 
     constexpr static size_t BUFFER_SIZE = 100*1024;
 
+    namespace
+    {
+        struct pooled_context
+        {
+            std::unique_ptr<http_context> ctx;
+            const httpd *                 owner  = nullptr;
+            bool                          in_use = false;
+        };
+
+        thread_local pooled_context t_pooled_context;
+    }
+
     void httpd::handle_request(std::shared_ptr<connection> conn,
                                const struct sockaddr_storage & addr, 
-                               socklen_t addr_len)
+                               socklen_t addr_len,
+                               int64_t accepted_ns,
+                               int64_t handshake_ns)
     {
         LOG_DEBUG("Handling http request");
 
         m_active_count++;
 
-        std::string client_ip;
+        const bool count_allocs =
+            m_alloc_accounting.load(std::memory_order_relaxed);
+        const uint64_t allocs_start = count_allocs ? alloc_counter::thread_count() : 0;
+
+        // Each handler thread keeps one context and reuses it request after
+        // request; a nested call, or one for another server, gets its own.
+        std::unique_ptr<http_context> own_ctx;
+        http_context * pctx = nullptr;
+        pooled_context & pool = t_pooled_context;
+        const bool pooled = !pool.in_use;
+        if (pooled && pool.ctx && pool.owner == this)
+        {
+            pool.ctx->reset(conn);
+            pctx = pool.ctx.get();
+        }
+        else
+        {
+            own_ctx = std::make_unique<http_context>(conn, [this]() {
+                return should_shutdown();
+            });
+            pctx = own_ctx.get();
+            if (pooled)
+            {
+                pool.ctx   = std::move(own_ctx);
+                pool.owner = this;
+            }
+        }
+        http_context & ctx = *pctx;
+        if (pooled)
+        {
+            pool.in_use = true;
+        }
+        unique_command release_ctx([pctx, pooled]() {
+            pctx->release();
+            if (pooled)
+            {
+                t_pooled_context.in_use = false;
+            }
+        });
+
         char ip_buf[INET6_ADDRSTRLEN] = {0};
         const char * name = nullptr;
         if (addr.ss_family == AF_INET)
@@ -798,43 +990,36 @@ namespace minerva
         }
         if (name)
         {
-            client_ip = name;
+            ctx.client_ip(name);
         }
-
-        // allocate send and receive buffers on the stack
-
-        http_context ctx(conn, [this]() {
-            return should_shutdown();
-        });
-
-        ctx.client_ip(client_ip);
         ctx.client_addr(addr, addr_len);
 
-        std::string date;
-
-        // add date header
+        if (accepted_ns)
         {
-            time_t tt;
-            time(&tt);
-            struct tm tm = minerva::gmtime(tt);
-
-            char tmp_date[200];
-            strftime(tmp_date, sizeof(tmp_date),
-                     "%a, %d %b %Y %H:%M:%S GMT", &tm);
-            tmp_date[sizeof(tmp_date) - 1] = 0;
-
-            date = tmp_date;
-
-            ctx.response().add_header("Date", date);
+            ctx.mark_phase(http_context::ACCEPTED, accepted_ns);
+        }
+        if (handshake_ns)
+        {
+            ctx.mark_phase(http_context::HANDSHAKE, handshake_ns);
+        }
+        ctx.mark_phase(http_context::DISPATCHED);
+        if (m_cpu_accounting.load(std::memory_order_relaxed))
+        {
+            ctx.start_cpu_accounting();
         }
 
+        // add date header
+        ctx.response().add_header("Date", http_date::now());
+
         bool abrt = false;
         char* first = nullptr;
 
-        std::vector<char> buf;
+        std::vector<char> & buf = ctx.header_buffer();
         buf.reserve(BUFFER_SIZE);
 
         bool reading = true;
+        unsigned long header_reads = 0;
+        unsigned long header_polls = 0;
 
         while (true)
         {
@@ -866,6 +1051,7 @@ namespace minerva
             bool read_flag = reading;
             bool write_flag = !reading;
             bool error_flag = true;
+            header_polls++;
             int poll_status = 
                 conn->poll(read_flag, write_flag, error_flag, 100);
 
@@ -890,6 +1076,7 @@ namespace minerva
             {
                 char tmpbuf[10*1024];
 
+                header_reads++;
                 auto status = 
                     conn->read(tmpbuf,
                                std::min(static_cast<unsigned long>(remaining),
@@ -985,6 +1172,11 @@ namespace minerva
             }
         }
 
+        ctx.request().add_transport_stats(header_reads, header_polls,
+                                          buf.size());
+        ctx.mark_phase(http_context::HEADER);
+        http_metrics::op_stats * op_stats = nullptr;
+
         // Only respond if the connection was not aborted
         if (!abrt)
         {
@@ -993,26 +1185,13 @@ namespace minerva
             LOG_DEBUG("Request url: "<< ctx.request().path().c_str());
 
             // find the root path
-            std::stringstream ss(ctx.request().path());
-            std::string root;
+            // Resolve controller, handler and path parameters in one pass.
+            route_table::match route;
+            const route_table * routes = current_routes();
             controller * controller = nullptr;
-
-            if (controller::next_path_segment(ss, root))
+            if (routes && routes->resolve(ctx.request().path(), route))
             {
-                // find the controller
-                LOG_DEBUG("Looking for controller " << root);
-                std::shared_lock<std::shared_mutex> lk(m_controller_lock);
-                auto it = controller_map.find(root);
-                if (it != controller_map.end())
-                {
-                    controller = it->second;
-                }
-            }
-
-            // no controller found - try default controller
-            if (!controller)
-            {
-                controller = get_default_controller();
+                controller = route.ctrl;
             }
 
             if (!controller)
@@ -1031,15 +1210,42 @@ namespace minerva
                 }
             }
             
-            std::string operation;
-            controller::next_path_segment(ss, operation);
+            // Only an unmatched operation needs a string of its own.
+            std::string unrouted;
+            if (!route.operation)
+            {
+                unrouted.assign(route.segment);
+            }
+            const std::string & operation =
+                route.operation ? *route.operation : unrouted;
+            ctx.route(route.fn, route.operation);
+            ctx.request().path_params(route);
+
+            // Only registered operations get series of their own; keying
+            // by what the client sent would let anyone fill the table.
+            op_stats = route.operation
+                ? m_metrics.op(route.label, *route.operation)
+                : m_metrics.op(controller ? route.label : "none", "unmatched");
+            op_stats->header.record(ctx.phase_us(http_context::HEADER));
 
             // process request
             if (controller)
             {
                 std::string user;
 
-                if (controller->require_authorization() && 
+                // The address limit goes first so a flood costs neither a
+                // credential check nor a body read.
+                if (!rate_admit(ctx, controller, 'c', ctx.client_ip(),
+                                controller->client_rate_limit()))
+                {
+                    LOG_DEBUG("Client rate limit exceeded: " <<
+                              ctx.client_ip() << " " << ctx.request().path());
+                    if (!finalize_error_response(ctx, http_response::http_response_code::HTTP_RETCODE_TOO_MANY_REQUESTS))
+                    {
+                        abrt = true;
+                    }
+                }
+                else if (controller->require_authorization() && 
                     (!authenticate(ctx, user) || 
                      !controller->auth_callback(user, operation)))
                 {
@@ -1052,8 +1258,20 @@ namespace minerva
                         abrt = true;
                     }
                 }
+                else if (!user.empty() &&
+                         !rate_admit(ctx, controller, 'u', user,
+                                     controller->user_rate_limit()))
+                {
+                    LOG_DEBUG("User rate limit exceeded: " << user << " " <<
+                              ctx.request().path());
+                    if (!finalize_error_response(ctx, http_response::http_response_code::HTTP_RETCODE_TOO_MANY_REQUESTS))
+                    {
+                        abrt = true;
+                    }
+                }
                 else
                 {
+                    ctx.mark_phase(http_context::AUTHENTICATED);
                     ctx.username(user);
                     if (ctx.request().continue_100() && 
                         !ctx.request().has_overflow())
@@ -1073,6 +1291,7 @@ namespace minerva
                                  ctx.request().method_as_string() << " " <<
                                  ctx.request().path());
                         // execute request handler
+                        const int64_t handler_start = http_context::now_ns();
                         try
                         {
                             controller->handle_request(ctx, operation);
@@ -1095,6 +1314,9 @@ namespace minerva
                                 abrt = true;
                             }
                         }
+                        ctx.mark_phase(http_context::HANDLED);
+                        op_stats->handler.record(
+                            (ctx.phase_ns(http_context::HANDLED) - handler_start) / 1000);
                     }
                 }
             }
@@ -1140,8 +1362,6 @@ namespace minerva
                             }
                             else // full response sent - shut write
                             {
-                                log(ctx, date);
-
                                 LOG_DEBUG("handled request");
                                 if (ctx.request().keep_alive())
                                 {
@@ -1155,8 +1375,6 @@ namespace minerva
                         }
                         else // no response to send - shut write
                         {
-                            log(ctx, date);
-
                             LOG_DEBUG("handled request");
                             if (ctx.request().keep_alive())
                             {
@@ -1186,45 +1404,115 @@ namespace minerva
             // Smart pointer automatically cleans up
         }
 
+        ctx.mark_phase(http_context::SENT);
+
+        // One record per request however it ended; a connection that
+        // closed without sending anything is not a request.
+        if (op_stats || ctx.request().bytes_received() > 0)
+        {
+            log(ctx, abrt);
+        }
+
+        // op_stats is only set once a header was parsed, which keeps idle
+        // keep-alive connections closed by the client out of the figures.
+        if (op_stats)
+        {
+            op_stats->total.record(ctx.elapsed_us(http_context::SENT));
+            op_stats->service.record(ctx.phase_us(http_context::SENT));
+            op_stats->transport(ctx.request().read_syscalls(),
+                                ctx.response().write_syscalls(),
+                                ctx.request().poll_syscalls() +
+                                ctx.response().poll_syscalls());
+            const long long cpu = ctx.cpu_us();
+            if (cpu >= 0)
+            {
+                op_stats->cpu.record(cpu);
+            }
+            if (ctx.response().first_byte_us() >= 0)
+            {
+                op_stats->first_byte.record(ctx.response().first_byte_us());
+            }
+            if (abrt)
+            {
+                m_metrics.aborted++;
+            }
+            else
+            {
+                m_metrics.status(ctx.response().status_code());
+            }
+            if (count_allocs)
+            {
+                m_metrics.allocations(alloc_counter::thread_count() - allocs_start);
+            }
+            m_slow_requests.check(ctx, ctx.response().status_code(),
+                                  ctx.request().method_as_string(),
+                                  ctx.request().path());
+        }
+        m_metrics.bytes(ctx.request().bytes_received(),
+                        ctx.response().bytes_sent());
+
+        m_read_syscall_count += ctx.request().read_syscalls();
+        m_poll_syscall_count += ctx.request().poll_syscalls();
         m_active_count--;
         m_request_count++;
     }
 
-    void httpd::log(http_context & ctx, const std::string & date)
+    void httpd::access_log_file(const std::string & path,
+                                size_t max_bytes,
+                                int max_files)
     {
-        std::stringstream ss;
-        ss << 
-            ctx.response().status_code() << " " <<
-            ctx.request().method_as_string() << " " <<
-            ctx.request().path();
-        if (ctx.request().query_string().empty())
+        m_access_log = std::make_unique<access_log>(path, max_bytes, max_files);
+    }
+
+    void httpd::write_metrics(std::ostream & os, bool json)
+    {
+        http_metrics::gauges g;
+        g.active_requests = m_active_count;
+        if (handler_thread_pool)
         {
-            ss << " ";
+            g.pool_queue_depth = handler_thread_pool->get_queue_size();
+            g.pool_threads     = handler_thread_pool->get_thread_count();
         }
-        else
         {
-            ss << "?" << ctx.request().query_string() << " ";
+            std::unique_lock<instrumented_mutex> lk(lock);
+            g.keepalive_idle = m_socket_map.size();
         }
-        ss << "duration=" << ctx.get_elapsed_milliseconds() << "(ms) ";
-        ss << date;
-    
-        std::unique_lock<std::mutex> lk(m_log_lock);
-
-        m_cgi_log.push_back(ss.str());
-        if (m_cgi_log.size() > 1000)
+        g.admission_queued  = m_admission.queued();
+        g.shed_queue        = m_admission.shed_queue_count();
+        g.shed_latency      = m_admission.shed_latency_count();
+        g.rate_limited           = m_rate_limiter.limited_count();
+        g.rate_limiter_evictions = m_rate_limiter.eviction_count();
+        g.closing                = m_closer.closing();
+        g.close_forced           = m_closer.forced_count();
+        g.close_timeouts         = m_closer.timeout_count();
+        g.close_time             = &m_closer.close_time();
+        g.auth_cache_hits   = m_basic_auth_cache.hits();
+        g.auth_cache_misses = m_basic_auth_cache.misses();
+        g.scheduler_lag = &scheduler_lag();
+
+        if (json)
         {
-            m_cgi_log.pop_front();
+            m_metrics.write_json(os, g);
+        }
+        else
+        {
+            m_metrics.write_prometheus(os, g);
         }
-
     }
 
-    void httpd::get_cgi_log(std::ostream & os)
+    void httpd::log(http_context & ctx, bool aborted)
     {
-        std::unique_lock<std::mutex> lk(m_log_lock);
-        for (auto & i : m_cgi_log)
+        if (!m_access_log)
         {
-            os << i << std::endl;
+            return;
         }
+        access_record rec;
+        access_log::make_record(ctx, rec);
+        if (aborted)
+        {
+            rec.flags |= access_record::FLAG_ABORTED;
+        }
+        m_access_log->append(rec);
     }
 
     bool httpd::finalize_error_response(http_context & ctx,
@@ -1247,6 +1535,21 @@ namespace minerva
         return false;
     }
 
+    bool httpd::rate_admit(http_context & ctx, const controller * ctrl,
+                           char kind, std::string_view client,
+                           const rate_limiter::limit & l)
+    {
+        if (!l.enabled() || m_rate_limiter.acquire(m_rate_limiter.key(ctrl, kind, client), l))
+        {
+            return true;
+        }
+        // Time for one token to come back, in whole seconds.
+        const double wait = std::ceil(1.0 / l.per_second());
+        ctx.response().add_header("Retry-After",
+                                  std::to_string(static_cast<long>(std::max(wait, 1.0))));
+        return false;
+    }
+
     bool httpd::write_100_continue_header(http_context & ctx)
     {
         std::stringstream os;
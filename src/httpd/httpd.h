@@ -7,9 +7,9 @@
 #include <set>
 #include <atomic>
 #include <ostream>
-#include <deque>
 #include <unordered_set>
 #include <memory>
+#include <string_view>
 #include <owl/component.h>
 #include <util/connection.h>
 #include <util/time_utils.h>
@@ -17,6 +17,13 @@
 #include "http_request.h"
 #include "http_response.h"
 #include "http_auth.h"
+#include "access_log.h"
+#include "http_metrics.h"
+#include "slow_request_log.h"
+#include "route_table.h"
+#include "admission_control.h"
+#include "rate_limiter.h"
+#include "close_manager.h"
 
 namespace minerva
 {
@@ -43,6 +50,8 @@ namespace minerva
         const int handler_count = 5;
         const int max_queued_connections = 20;
         const int polling_period_ms = 500;
+        // How long a shed connection lingers to read a late request.
+        const int shed_linger_ms = 1000;
     
         void initialize() override;
         void start() override;
@@ -70,11 +79,92 @@ namespace minerva
         // instance. Pass nullptr to disable auth.
         void auth_db(http_auth_db * db)
         {
-            std::unique_lock<std::mutex> lk(lock);
+            std::unique_lock<instrumented_mutex> lk(lock);
             m_auth_db = db;
+            m_basic_auth_cache.clear();
         }
 
-        void get_cgi_log(std::ostream & db);
+        // Verified Basic credentials, valid until their TTL passes or the
+        // auth db changes.
+        http_auth_basic_cache & basic_auth_cache()
+        {
+            return m_basic_auth_cache;
+        }
+
+        // Writes a binary access record per completed request to path,
+        // rotating it at max_bytes. Call before start().
+        void access_log_file(const std::string & path,
+                             size_t max_bytes = 64 * 1024 * 1024,
+                             int max_files = 4);
+
+        access_log * get_access_log()
+        {
+            return m_access_log.get();
+        }
+
+        http_metrics & metrics()
+        {
+            return m_metrics;
+        }
+
+        // Requests slower than slow_requests().threshold_ms(), with their
+        // phase breakdown.
+        slow_request_log & slow_requests()
+        {
+            return m_slow_requests;
+        }
+
+        // Queue depth and queueing delay limits past which connections
+        // are answered with a 503 instead of waiting for a handler thread.
+        admission_control & admission()
+        {
+            return m_admission;
+        }
+
+        // Connections being closed: TLS close_notify and lingering reads,
+        // from one thread, up to closer().max_closing() at a time.
+        close_manager & closer()
+        {
+            return m_closer;
+        }
+
+        // Measures each request's handler thread CPU time (two
+        // clock_gettime(CLOCK_THREAD_CPUTIME_ID) calls) for the metrics and
+        // the access log. Off by default.
+        void cpu_accounting(bool enabled)
+        {
+            m_cpu_accounting = enabled;
+        }
+
+        // Counts each request's heap allocations on the handler thread for
+        // the metrics. Needs a counting operator new linked into the
+        // program (see util/alloc_counter.h); off by default.
+        void alloc_accounting(bool enabled)
+        {
+            m_alloc_accounting = enabled;
+        }
+
+        // Exports m_metrics plus the gauges sampled now, as Prometheus
+        // text or JSON.
+        void write_metrics(std::ostream & os, bool json);
+
+        // Handled request count and the transport read()/poll() calls they
+        // made, header and body included.  The ratios give syscalls per
+        // request.
+        unsigned long long request_count() const
+        {
+            return m_request_count;
+        }
+
+        unsigned long long read_syscall_count() const
+        {
+            return m_read_syscall_count;
+        }
+
+        unsigned long long poll_syscall_count() const
+        {
+            return m_poll_syscall_count;
+        }
 
     private:
         class http_listener
@@ -93,18 +183,36 @@ namespace minerva
 
         void start_listeners();
 
-        thread_pool * handler_thread_pool;
+        thread_pool * handler_thread_pool = nullptr;
         std::unordered_map<std::string, controller*> controller_map;
-        // Guards controller_map and m_default_controller. controller_map is
-        // populated only at initialization; the dispatch path takes a
-        // shared_lock while callbacks hold the unique_lock.
-        std::shared_mutex m_controller_lock;
+        // Guards controller_map, m_default_controller, m_routes and
+        // m_routes_live. start() compiles the route_table once, as does
+        // each registration after it, and bumps m_routes_generation.
+        // Dispatch keeps a per-thread reference that it refreshes only
+        // when the generation moved, so a superseded table is freed once
+        // every handler thread has moved on.
+        instrumented_shared_mutex m_controller_lock;
         controller* m_default_controller = nullptr;
+        std::shared_ptr<const route_table> m_routes;
+        std::atomic<uint64_t> m_routes_generation{0};
+        bool m_routes_live = false;
+
+        // Caller holds m_controller_lock exclusively.
+        void compile_routes();
+
+        // The calling thread's current route table, or null before
+        // start(). Valid until the thread's next call.
+        const route_table * current_routes();
         std::atomic<unsigned long long> m_active_count;
         std::atomic<unsigned long long> m_request_count;
+        std::atomic<unsigned long long> m_read_syscall_count;
+        std::atomic<unsigned long long> m_poll_syscall_count;
+        std::atomic<bool> m_cpu_accounting{false};
+        std::atomic<bool> m_alloc_accounting{false};
         // Non-owning. Owned by the caller of auth_db().
         http_auth_db * m_auth_db = nullptr;
         http_auth_nonce_store m_nonce_store;
+        http_auth_basic_cache m_basic_auth_cache;
 
         controller * get_default_controller();
         http_auth_db * get_auth_db();
@@ -116,8 +224,12 @@ namespace minerva
         std::atomic<bool> m_hup{false};
         std::atomic<bool> m_waiting_hup{false};
 
-        std::mutex m_log_lock;
-        std::deque<std::string> m_cgi_log;
+        std::unique_ptr<access_log> m_access_log;
+        http_metrics m_metrics;
+        slow_request_log m_slow_requests;
+        admission_control m_admission;
+        rate_limiter m_rate_limiter;
+        close_manager m_closer;
     
         // Map of currently-idle keep-alive connections, keyed by the
         // owning shared_ptr. Using shared_ptr (rather than a raw pointer
@@ -128,25 +240,52 @@ namespace minerva
                             struct sockaddr_storage,
                             socklen_t>> m_socket_map;
 
-        void log(http_context & ctx, const std::string & date);
+        // Emptied m_socket_map nodes, reused by put_back_connection() so a
+        // kept-alive request does not allocate one. Guarded by lock.
+        static constexpr size_t MAX_SPARE_NODES = 1024;
+        std::vector<decltype(m_socket_map)::node_type> m_spare_nodes;
+
+        // Removes key from m_socket_map, keeping the node; lock held.
+        void release_idle(const std::shared_ptr<connection> & key);
+
+        // Appends ctx's access record; aborted marks a request that ended
+        // without a complete response.
+        void log(http_context & ctx, bool aborted);
+
+        // Keeps http_date current while the server runs.
+        void schedule_date_refresh();
+        std::mutex m_date_lock;
+        scheduler::job_handle m_date_job;
+        bool m_date_running = false;
 
         // Factory method for creating connections with proper smart pointer management
         std::shared_ptr<connection> create_connection(int socket, PROTOCOL protocol);
         std::shared_ptr<connection> create_listener_connection(PROTOCOL protocol);
 
         bool accept(std::shared_ptr<connection> conn);
-        
-        bool shutdown(std::shared_ptr<connection> conn);
 
+        // Queues conn for a handler thread if admission control lets it
+        // in; otherwise answers it with the 503 and closes it.
+        void dispatch(std::shared_ptr<connection> conn,
+                      const sockaddr_storage & addr, socklen_t addr_len,
+                      int64_t accepted_ns, int64_t handshake_ns);
+
+        void shed(std::shared_ptr<connection> conn,
+                  admission_control::verdict why);
+        
         void shutdown_write_async(std::shared_ptr<connection> conn);
         
         void put_back_connection(std::shared_ptr<connection> conn,
                                  const sockaddr_storage & addr, 
                                  socklen_t addr_len);
 
+        // accepted_ns and handshake_ns are http_context::now_ns() stamps
+        // taken before the request reached a handler thread, 0 if unknown.
         void handle_request(std::shared_ptr<connection> conn, 
                             const struct sockaddr_storage & addr, 
-                            socklen_t addr_len);
+                            socklen_t addr_len,
+                            int64_t accepted_ns,
+                            int64_t handshake_ns);
     
         // Set ctx.response() status to `code`, draining the request body
         // if necessary. Returns false if the body could not be drained
@@ -156,6 +295,12 @@ namespace minerva
 
         bool write_100_continue_header(http_context & ctx);
 
+        // Takes a token from client's bucket under ctrl. When it is empty,
+        // sets Retry-After on ctx.response() and returns false.
+        bool rate_admit(http_context & ctx, const controller * ctrl,
+                        char kind, std::string_view client,
+                        const rate_limiter::limit & l);
+
         bool authenticate(http_context & ctx, std::string & user);
     
         void listener_thread_fn();
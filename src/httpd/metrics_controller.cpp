@@ -0,0 +1,44 @@
+#include <util/instrumented_mutex.h>
+#include "metrics_controller.h"
+#include "http_context.h"
+#include "httpd.h"
+
+namespace minerva
+{
+    metrics_controller::metrics_controller(httpd & server) : m_server(server)
+    {
+        REGISTER_HANDLER("", metrics_controller::handle_prometheus);
+        REGISTER_HANDLER("prometheus", metrics_controller::handle_prometheus);
+        REGISTER_HANDLER("json", metrics_controller::handle_json);
+        REGISTER_HANDLER("slow", metrics_controller::handle_slow);
+        REGISTER_HANDLER("locks", metrics_controller::handle_locks);
+    }
+
+    void metrics_controller::handle_prometheus(http_context & ctx)
+    {
+        ctx.response().status_code_success();
+        ctx.response().content_type_text();
+        m_server.write_metrics(ctx.response().response_stream(), false);
+    }
+
+    void metrics_controller::handle_json(http_context & ctx)
+    {
+        ctx.response().status_code_success();
+        ctx.response().content_type_json();
+        m_server.write_metrics(ctx.response().response_stream(), true);
+    }
+
+    void metrics_controller::handle_slow(http_context & ctx)
+    {
+        ctx.response().status_code_success();
+        ctx.response().content_type_json();
+        m_server.slow_requests().write_json(ctx.response().response_stream());
+    }
+
+    void metrics_controller::handle_locks(http_context & ctx)
+    {
+        ctx.response().status_code_success();
+        ctx.response().content_type_json();
+        write_lock_report(ctx.response().response_stream());
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "controller.h"
+
+namespace minerva
+{
+    class httpd;
+
+    // Serves an httpd instance's metrics: /<name>/prometheus (also the bare
+    // /<name>) in Prometheus text exposition format, /<name>/json as a
+    // JSON document with per-operation percentiles, /<name>/slow with the
+    // captured slow requests and their phase breakdown, and /<name>/locks
+    // with the contention report of the instrumented mutexes.
+    class metrics_controller : public controller
+    {
+    public:
+        explicit metrics_controller(httpd & server);
+        virtual ~metrics_controller() = default;
+
+    private:
+        void handle_prometheus(http_context & ctx);
+        void handle_json(http_context & ctx);
+        void handle_slow(http_context & ctx);
+        void handle_locks(http_context & ctx);
+
+        httpd & m_server;
+    };
+}
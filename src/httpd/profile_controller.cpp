@@ -0,0 +1,79 @@
+#include <chrono>
+#include <sstream>
+#include <thread>
+#include <owl/component_visor.h>
+#include <util/log.h>
+#include "profile_controller.h"
+#include "http_context.h"
+#include "httpd.h"
+
+namespace minerva
+{
+    namespace
+    {
+        // Empty -> fallback; anything but digits -> -1.
+        int int_parameter(const std::string & value, int fallback)
+        {
+            if (value.empty())
+            {
+                return fallback;
+            }
+            if (value.size() > 6 ||
+                value.find_first_not_of("0123456789") != std::string::npos)
+            {
+                return -1;
+            }
+            return std::stoi(value);
+        }
+    }
+
+    profile_controller::profile_controller(httpd & server) : m_server(server)
+    {
+        REGISTER_HANDLER("", profile_controller::handle_profile);
+    }
+
+    void profile_controller::handle_profile(http_context & ctx)
+    {
+        const int seconds = int_parameter(ctx.request().query_parameter("seconds"),
+                                          DEFAULT_SECONDS);
+        const int hz = int_parameter(ctx.request().query_parameter("hz"),
+                                     sampling_profiler::DEFAULT_HZ);
+        if (seconds < 1 || seconds > MAX_SECONDS ||
+            hz < 1 || hz > sampling_profiler::MAX_HZ)
+        {
+            ctx.response().status_code_bad_request();
+            return;
+        }
+
+        sampling_profiler & profiler = m_server.visor->get_profiler();
+        if (!profiler.start(hz))
+        {
+            ctx.response().status_code(
+                http_response::http_response_code::HTTP_RETCODE_CONFLICT);
+            return;
+        }
+
+        const auto deadline = std::chrono::steady_clock::now() +
+                              std::chrono::seconds(seconds);
+        while (std::chrono::steady_clock::now() < deadline &&
+               !m_server.should_shutdown())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+
+        std::ostringstream stacks;
+        profiler.collect(stacks);
+
+        ctx.response().status_code_success();
+        ctx.response().content_type_text();
+        ctx.response().add_header("X-Profile-Threads",
+                                  std::to_string(profiler.thread_count()));
+        ctx.response().add_header("X-Profile-Samples",
+                                  std::to_string(profiler.sample_count()));
+        ctx.response().add_header("X-Profile-Dropped",
+                                  std::to_string(profiler.dropped_count()));
+        ctx.response().add_header("X-Profile-Handler-Us",
+                                  std::to_string(profiler.handler_ns() / 1000));
+        ctx.response().response_stream() << stacks.str();
+    }
+}
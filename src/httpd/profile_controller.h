@@ -0,0 +1,28 @@
+#pragma once
+
+#include "controller.h"
+
+namespace minerva
+{
+    class httpd;
+
+    // Runs the visor's sampling profiler for /<name>?seconds=N&hz=M and
+    // returns the collapsed stacks as text for flamegraph.pl. The handler
+    // thread is held for the duration, so MAX_SECONDS is kept short; a
+    // second request while one is running gets 409. Sample, drop and
+    // handler-time totals are returned in X-Profile-* headers.
+    class profile_controller : public controller
+    {
+    public:
+        static constexpr int DEFAULT_SECONDS = 5;
+        static constexpr int MAX_SECONDS     = 10;
+
+        explicit profile_controller(httpd & server);
+        virtual ~profile_controller() = default;
+
+    private:
+        void handle_profile(http_context & ctx);
+
+        httpd & m_server;
+    };
+}
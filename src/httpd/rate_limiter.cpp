@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <time.h>
+#include "rate_limiter.h"
+
+namespace minerva
+{
+    namespace
+    {
+        int64_t monotonic_ns()
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+        }
+
+        void fnv1a(uint64_t & h, const void * data, size_t n)
+        {
+            const auto * p = static_cast<const unsigned char *>(data);
+            for (size_t i = 0; i < n; ++i)
+            {
+                h ^= p[i];
+                h *= 1099511628211ULL;
+            }
+        }
+
+        // Keeps the elapsed-time product below 2^64.
+        constexpr uint64_t MAX_ELAPSED_MS = 1ULL << 30;
+        constexpr uint64_t MAX_RATE_FP    = 1ULL << 32;
+    }
+
+    rate_limiter::limit::limit(double per_second, double burst) :
+        m_per_second(std::max(per_second, 0.0))
+    {
+        if (m_per_second > 0)
+        {
+            m_rate_fp = std::clamp<uint64_t>(
+                static_cast<uint64_t>(m_per_second * ONE_TOKEN), 1, MAX_RATE_FP);
+            m_burst_fp = static_cast<uint64_t>(std::clamp(burst, 1.0, 65535.0) *
+                                               ONE_TOKEN);
+        }
+    }
+
+    rate_limiter::rate_limiter(size_t capacity) :
+        m_set_count(std::max<size_t>(capacity / WAYS, 1)),
+        m_sets(new set[m_set_count]),
+        m_epoch_ns(monotonic_ns())
+    {
+        std::random_device rd;
+        m_seed = (static_cast<uint64_t>(rd()) << 32) ^ rd();
+    }
+
+    uint64_t rate_limiter::now_ms() const
+    {
+        return static_cast<uint64_t>(monotonic_ns() - m_epoch_ns) / 1000000;
+    }
+
+    uint64_t rate_limiter::key(const void * scope, char kind,
+                               std::string_view client) const
+    {
+        uint64_t h = 1469598103934665603ULL ^ m_seed;
+        fnv1a(h, &scope, sizeof(scope));
+        fnv1a(h, &kind, 1);
+        fnv1a(h, client.data(), client.size());
+        return h > CLAIMING ? h : h + 2;
+    }
+
+    rate_limiter::slot & rate_limiter::find(uint64_t key, uint64_t fresh)
+    {
+        set & s = m_sets[(key >> 8) % m_set_count];
+
+        for (slot & w : s.ways)
+        {
+            if (w.key.load(std::memory_order_acquire) == key)
+            {
+                w.referenced.store(true, std::memory_order_relaxed);
+                return w;
+            }
+        }
+
+        // Claim an empty way, or else the first one the CLOCK hand finds
+        // unreferenced. The key is published only once the fresh bucket
+        // is in place.
+        auto claim = [&](slot & w, uint64_t expected) {
+            if (!w.key.compare_exchange_strong(expected, CLAIMING,
+                                               std::memory_order_acq_rel))
+            {
+                return false;
+            }
+            w.state.store(fresh, std::memory_order_relaxed);
+            w.referenced.store(true, std::memory_order_relaxed);
+            w.key.store(key, std::memory_order_release);
+            return true;
+        };
+
+        for (slot & w : s.ways)
+        {
+            if (w.key.load(std::memory_order_relaxed) == EMPTY && claim(w, EMPTY))
+            {
+                return w;
+            }
+        }
+
+        for (size_t i = 0; i < 2 * WAYS; ++i)
+        {
+            slot & w = s.ways[s.hand.fetch_add(1, std::memory_order_relaxed) % WAYS];
+            if (w.referenced.exchange(false, std::memory_order_relaxed))
+            {
+                continue;
+            }
+            const uint64_t victim = w.key.load(std::memory_order_relaxed);
+            if (victim != CLAIMING && claim(w, victim))
+            {
+                m_evictions.fetch_add(1, std::memory_order_relaxed);
+                return w;
+            }
+        }
+
+        // Every way was in use or being claimed throughout: share the
+        // hand's way without taking it over.
+        return s.ways[s.hand.load(std::memory_order_relaxed) % WAYS];
+    }
+
+    bool rate_limiter::acquire(uint64_t key, const limit & l)
+    {
+        if (!l.enabled())
+        {
+            return true;
+        }
+
+        const uint64_t now = now_ms();
+        slot & w = find(key, (now << TOKEN_BITS) | l.m_burst_fp);
+
+        uint64_t state = w.state.load(std::memory_order_relaxed);
+        while (true)
+        {
+            const uint64_t last = state >> TOKEN_BITS;
+            uint64_t tokens = std::min(state & TOKEN_MASK, l.m_burst_fp);
+            uint64_t stamp = last;
+            if (now > last)
+            {
+                // Whole token units only; the stamp stays put until the
+                // elapsed time is worth at least one, so slow rates still
+                // refill.
+                const uint64_t elapsed = std::min(now - last, MAX_ELAPSED_MS);
+                const uint64_t add = elapsed * l.m_rate_fp / 1000;
+                if (add)
+                {
+                    tokens = std::min(tokens + add, l.m_burst_fp);
+                    stamp = now;
+                }
+            }
+            if (tokens < ONE_TOKEN)
+            {
+                m_limited.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            const uint64_t next = (stamp << TOKEN_BITS) | (tokens - ONE_TOKEN);
+            if (w.state.compare_exchange_weak(state, next,
+                                              std::memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+    }
+}
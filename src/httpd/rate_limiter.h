@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+namespace minerva
+{
+    /*
+     * Token buckets for many clients in a fixed-size table.
+     *
+     * The table is split into sets of WAYS slots; a key maps to one set.
+     * A slot holds the key and one 64-bit word packing the time of the
+     * last refill (ms) with the token count (1/256 token units), so taking
+     * a token is a single compare-and-swap. A key that is not present
+     * takes an empty way, else the set's CLOCK hand evicts the first way
+     * not used since the hand last passed it; an evicted client starts
+     * again with a full bucket.
+     *
+     * acquire() neither locks nor allocates. Keys are hashed with a
+     * per-process seed so clients cannot aim at one set.
+     */
+    class rate_limiter
+    {
+    public:
+        static constexpr size_t WAYS             = 8;
+        static constexpr size_t DEFAULT_CAPACITY = 16384;
+
+        // Refill rate and bucket size; per_second 0 means no limit.
+        // Bursts are capped at 65535 tokens.
+        class limit
+        {
+        public:
+            limit() = default;
+            limit(double per_second, double burst);
+
+            bool enabled() const
+            {
+                return m_rate_fp != 0;
+            }
+
+            double per_second() const
+            {
+                return m_per_second;
+            }
+
+        private:
+            friend class rate_limiter;
+
+            double   m_per_second = 0;
+            uint64_t m_rate_fp    = 0;   // token units per second
+            uint64_t m_burst_fp   = 0;   // token units
+        };
+
+        explicit rate_limiter(size_t capacity = DEFAULT_CAPACITY);
+
+        rate_limiter(const rate_limiter &)             = delete;
+        rate_limiter & operator=(const rate_limiter &) = delete;
+
+        // Key of the bucket for client under scope, e.g. a controller
+        // and whether client is an address or a user name.
+        uint64_t key(const void * scope, char kind, std::string_view client) const;
+
+        // Takes a token from key's bucket; false if it is empty.
+        bool acquire(uint64_t key, const limit & l);
+
+        uint64_t limited_count() const
+        {
+            return m_limited.load(std::memory_order_relaxed);
+        }
+
+        uint64_t eviction_count() const
+        {
+            return m_evictions.load(std::memory_order_relaxed);
+        }
+
+    private:
+        static constexpr int      TOKEN_BITS = 24;
+        static constexpr uint64_t TOKEN_MASK = (1ULL << TOKEN_BITS) - 1;
+        static constexpr uint64_t ONE_TOKEN  = 256;
+        // Keys 0 and 1 mark an empty slot and one being filled in.
+        static constexpr uint64_t EMPTY      = 0;
+        static constexpr uint64_t CLAIMING   = 1;
+
+        struct slot
+        {
+            std::atomic<uint64_t> key{EMPTY};
+            std::atomic<uint64_t> state{0};
+            std::atomic<bool>     referenced{false};
+        };
+
+        struct alignas(64) set
+        {
+            slot                 ways[WAYS];
+            std::atomic<uint8_t> hand{0};
+        };
+
+        slot & find(uint64_t key, uint64_t fresh);
+        uint64_t now_ms() const;
+
+        const size_t           m_set_count;
+        std::unique_ptr<set[]> m_sets;
+        uint64_t               m_seed;
+        const int64_t          m_epoch_ns;
+        std::atomic<uint64_t>  m_limited{0};
+        std::atomic<uint64_t>  m_evictions{0};
+    };
+}
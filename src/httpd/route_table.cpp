@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <cctype>
+#include <util/log.h>
+#include "route_table.h"
+#include "controller.h"
+
+namespace minerva
+{
+    namespace
+    {
+        // Next non-empty segment at or after pos, skipping runs of '/' the
+        // way controller::next_path_segment() does; pos moves past it.
+        std::string_view next_segment(std::string_view path, size_t & pos)
+        {
+            while (pos < path.size() && path[pos] == '/')
+            {
+                ++pos;
+            }
+            const size_t start = pos;
+            while (pos < path.size() && path[pos] != '/')
+            {
+                ++pos;
+            }
+            return path.substr(start, pos - start);
+        }
+
+        char lower(char c)
+        {
+            return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+
+        // Orders a lower-cased edge segment against a request segment,
+        // ignoring the request's case.
+        int compare_ci(std::string_view lowered, std::string_view s)
+        {
+            const size_t n = std::min(lowered.size(), s.size());
+            for (size_t i = 0; i < n; ++i)
+            {
+                const char c = lower(s[i]);
+                if (lowered[i] != c)
+                {
+                    return lowered[i] < c ? -1 : 1;
+                }
+            }
+            return lowered.size() == s.size() ? 0 :
+                   lowered.size() < s.size() ? -1 : 1;
+        }
+
+        bool is_param(std::string_view seg)
+        {
+            return seg.size() >= 2 && seg.front() == '{' && seg.back() == '}';
+        }
+    }
+
+    route_table::route_table(
+        const std::unordered_map<std::string, controller *> & controllers,
+        controller * default_controller)
+    {
+        add_node();
+        for (const auto & [path, ctrl] : controllers)
+        {
+            if (!ctrl)
+            {
+                continue;
+            }
+            const uint32_t n = add_controller(path, ctrl);
+            auto & edges = m_nodes[0].edges;
+            auto it = std::lower_bound(edges.begin(), edges.end(), path,
+                                       [](const edge & e, const std::string & s) {
+                                           return e.segment < s;
+                                       });
+            edges.insert(it, edge{path, n});
+        }
+        if (default_controller)
+        {
+            m_default = static_cast<int32_t>(add_controller("default",
+                                                            default_controller));
+        }
+    }
+
+    uint32_t route_table::add_node()
+    {
+        m_nodes.emplace_back();
+        return static_cast<uint32_t>(m_nodes.size() - 1);
+    }
+
+    uint32_t route_table::add_controller(std::string_view label, controller * ctrl)
+    {
+        const uint32_t n = add_node();
+        m_nodes[n].ctrl  = ctrl;
+        m_nodes[n].label = std::string(label);
+        for (const auto & [name, fn] : ctrl->m_handlers)
+        {
+            add_handler(n, name, fn);
+        }
+        return n;
+    }
+
+    void route_table::add_handler(uint32_t ctrl_node, const std::string & name,
+                                  const handler & fn)
+    {
+        uint32_t n = ctrl_node;
+        size_t pos = 0;
+        for (std::string_view seg = next_segment(name, pos); !seg.empty();
+             seg = next_segment(name, pos))
+        {
+            if (is_param(seg))
+            {
+                const std::string_view param = seg.substr(1, seg.size() - 2);
+                if (m_nodes[n].param_child < 0)
+                {
+                    const uint32_t child = add_node();
+                    m_nodes[n].param_child = static_cast<int32_t>(child);
+                    m_nodes[n].param_name  = std::string(param);
+                }
+                else if (m_nodes[n].param_name != param)
+                {
+                    LOG_WARN("route '" << name << "': parameter {" << param
+                             << "} shares a position with {"
+                             << m_nodes[n].param_name << "}; using the latter");
+                }
+                n = static_cast<uint32_t>(m_nodes[n].param_child);
+                continue;
+            }
+
+            std::string key(seg);
+            std::transform(key.begin(), key.end(), key.begin(), lower);
+            auto & edges = m_nodes[n].edges;
+            auto it = std::lower_bound(edges.begin(), edges.end(), key,
+                                       [](const edge & e, const std::string & s) {
+                                           return e.segment < s;
+                                       });
+            if (it != edges.end() && it->segment == key)
+            {
+                n = it->child;
+                continue;
+            }
+            const size_t at = it - edges.begin();
+            const uint32_t child = add_node();
+            auto & grown = m_nodes[n].edges;
+            grown.insert(grown.begin() + at, edge{std::move(key), child});
+            n = child;
+        }
+
+        if (m_nodes[n].route >= 0)
+        {
+            LOG_WARN("route '" << name << "' duplicates '"
+                     << *m_routes[m_nodes[n].route].operation << "'; ignored");
+            return;
+        }
+        m_nodes[n].route = static_cast<int32_t>(m_routes.size());
+        m_routes.push_back(route{&fn, &name});
+    }
+
+    bool route_table::resolve(std::string_view path, match & m) const
+    {
+        m.ctrl        = nullptr;
+        m.fn          = nullptr;
+        m.operation   = nullptr;
+        m.param_count = 0;
+
+        size_t pos = 0;
+        const std::string_view root = next_segment(path, pos);
+        int32_t n = -1;
+        if (!root.empty())
+        {
+            const auto & edges = m_nodes[0].edges;
+            auto it = std::lower_bound(edges.begin(), edges.end(), root,
+                                       [](const edge & e, std::string_view s) {
+                                           return std::string_view(e.segment) < s;
+                                       });
+            if (it != edges.end() && it->segment == root)
+            {
+                n = static_cast<int32_t>(it->child);
+            }
+        }
+        if (n < 0)
+        {
+            n = m_default;
+            if (n < 0)
+            {
+                return false;
+            }
+        }
+
+        const node & c = m_nodes[n];
+        m.ctrl  = c.ctrl;
+        m.label = c.label;
+        size_t op_pos = pos;
+        m.segment = next_segment(path, op_pos);
+
+        walk(static_cast<uint32_t>(n), path, pos, 0, m);
+        return true;
+    }
+
+    bool route_table::walk(uint32_t n, std::string_view path, size_t pos,
+                           int depth, match & m) const
+    {
+        const node & nd = m_nodes[n];
+        size_t next = pos;
+        const std::string_view seg = next_segment(path, next);
+
+        if (!seg.empty())
+        {
+            auto it = std::lower_bound(nd.edges.begin(), nd.edges.end(), seg,
+                                       [](const edge & e, std::string_view s) {
+                                           return compare_ci(e.segment, s) < 0;
+                                       });
+            if (it != nd.edges.end() && compare_ci(it->segment, seg) == 0 &&
+                walk(it->child, path, next, depth + 1, m))
+            {
+                return true;
+            }
+            if (nd.param_child >= 0 && m.param_count < MAX_PARAMS)
+            {
+                m.params[m.param_count++] = param{nd.param_name, seg};
+                if (walk(static_cast<uint32_t>(nd.param_child), path, next,
+                         depth + 1, m))
+                {
+                    return true;
+                }
+                --m.param_count;
+            }
+            // The controller's own ("") handler only takes paths without an
+            // operation segment; deeper handlers ignore trailing segments.
+            if (depth == 0)
+            {
+                return false;
+            }
+        }
+
+        if (nd.route < 0)
+        {
+            return false;
+        }
+        m.fn        = m_routes[nd.route].fn;
+        m.operation = m_routes[nd.route].operation;
+        return true;
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace minerva
+{
+    class controller;
+    class http_context;
+
+    /*
+     * Compiled routing trie from a request path to a controller and one of
+     * its registered handlers.
+     *
+     * The first path segment selects the controller, case-sensitively, as
+     * registered with httpd::register_controller(). If none matches, the
+     * default controller gets the path with that segment skipped. The
+     * remaining segments are matched case-insensitively against the
+     * controller's handler names, each split on '/'. A handler name
+     * segment of the form {name} matches any one segment and captures it
+     * as a path parameter. Static segments win over parameters, and
+     * segments past the deepest matching handler are ignored.
+     *
+     * resolve() walks string_views into the path: it neither allocates nor
+     * locks. A table is immutable once built; httpd publishes a new one
+     * when registrations change.
+     */
+    class route_table
+    {
+    public:
+        typedef std::function<void(http_context &)> handler;
+
+        static constexpr size_t MAX_PARAMS = 8;
+
+        struct param
+        {
+            std::string_view name;
+            std::string_view value;
+        };
+
+        struct match
+        {
+            controller *        ctrl      = nullptr;
+            std::string_view    label;              // registered path or "default"
+            const handler *     fn        = nullptr; // null if no handler matched
+            const std::string * operation = nullptr; // handler name, when fn is set
+            std::string_view    segment;            // the operation segment as sent
+            std::array<param, MAX_PARAMS> params{};
+            size_t              param_count = 0;
+        };
+
+        route_table(const std::unordered_map<std::string, controller *> & controllers,
+                    controller * default_controller);
+
+        route_table(const route_table &)             = delete;
+        route_table & operator=(const route_table &) = delete;
+
+        // False if no controller, default included, takes the path.
+        bool resolve(std::string_view path, match & m) const;
+
+    private:
+        struct edge
+        {
+            std::string segment;     // lower-cased below the controller level
+            uint32_t    child;
+        };
+
+        struct node
+        {
+            std::vector<edge> edges; // sorted by segment
+            int32_t     param_child = -1;
+            std::string param_name;
+            int32_t     route       = -1;
+            controller * ctrl       = nullptr;
+            std::string  label;
+        };
+
+        struct route
+        {
+            const handler *     fn;
+            const std::string * operation;
+        };
+
+        uint32_t add_node();
+        uint32_t add_controller(std::string_view label, controller * ctrl);
+        void add_handler(uint32_t ctrl_node, const std::string & name,
+                         const handler & fn);
+        bool walk(uint32_t n, std::string_view path, size_t pos, int depth,
+                  match & m) const;
+
+        std::vector<node>  m_nodes;
+        std::vector<route> m_routes;
+        int32_t            m_default = -1;
+    };
+}
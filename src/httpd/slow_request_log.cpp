@@ -0,0 +1,112 @@
+#include <chrono>
+#include <jsoncpp/json/json.h>
+#include <util/json_utils.h>
+#include "slow_request_log.h"
+
+namespace minerva
+{
+    slow_request_log::slow_request_log(size_t capacity) :
+        m_threshold_us(static_cast<long long>(DEFAULT_THRESHOLD_MS) * 1000),
+        m_capacity(capacity ? capacity : 1)
+    {
+        m_ring.reserve(m_capacity);
+    }
+
+    void slow_request_log::check(const http_context & ctx, int status,
+                                 const char * method, const std::string & path)
+    {
+        const long long threshold = m_threshold_us.load(std::memory_order_relaxed);
+        const int64_t end = ctx.phase_ns(http_context::SENT);
+        if (threshold <= 0 || end == 0)
+        {
+            return;
+        }
+
+        int64_t begin = 0;
+        for (int p = 0; p < http_context::SENT && begin == 0; ++p)
+        {
+            begin = ctx.phase_ns(static_cast<http_context::PHASE>(p));
+        }
+        const long long total_us = begin ? (end - begin) / 1000 : 0;
+        if (total_us < threshold)
+        {
+            return;
+        }
+
+        entry e;
+        e.wall_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        e.total_us = total_us;
+        e.status = status;
+        e.method = method;
+        e.path = path;
+        e.client_ip = ctx.client_ip();
+        e.user = ctx.username();
+
+        // Each interval runs from the previous recorded phase.
+        int64_t prev = 0;
+        for (int p = 0; p < http_context::PHASE_COUNT; ++p)
+        {
+            const int64_t ts = ctx.phase_ns(static_cast<http_context::PHASE>(p));
+            if (ts == 0)
+            {
+                e.phase_us[p] = -1;
+                continue;
+            }
+            e.phase_us[p] = prev ? (ts - prev) / 1000 : -1;
+            prev = ts;
+        }
+
+        m_captured++;
+        std::unique_lock<std::mutex> lk(m_lock);
+        if (m_ring.size() < m_capacity)
+        {
+            m_ring.push_back(std::move(e));
+        }
+        else
+        {
+            m_ring[m_next] = std::move(e);
+        }
+        m_next = (m_next + 1) % m_capacity;
+    }
+
+    void slow_request_log::write_json(std::ostream & os) const
+    {
+        Json::Value root(Json::objectValue);
+        root["threshold_ms"] = threshold_ms();
+        root["captured"] = Json::UInt64(m_captured.load());
+
+        Json::Value list(Json::arrayValue);
+        {
+            std::unique_lock<std::mutex> lk(m_lock);
+            const size_t n = m_ring.size();
+            for (size_t i = 0; i < n; ++i)
+            {
+                const entry & e = m_ring[(m_next + n - 1 - i) % n];
+                Json::Value v(Json::objectValue);
+                v["time_us"]   = Json::Int64(e.wall_us);
+                v["total_us"]  = Json::Int64(e.total_us);
+                v["status"]    = e.status;
+                v["method"]    = e.method;
+                v["path"]      = e.path;
+                v["client"]    = e.client_ip;
+                v["user"]      = e.user;
+                Json::Value phases(Json::objectValue);
+                for (int p = 0; p < http_context::PHASE_COUNT; ++p)
+                {
+                    if (e.phase_us[p] >= 0)
+                    {
+                        phases[http_context::phase_name(
+                            static_cast<http_context::PHASE>(p))] =
+                            Json::Int64(e.phase_us[p]);
+                    }
+                }
+                v["phases_us"] = phases;
+                list.append(v);
+            }
+        }
+        root["requests"] = list;
+
+        os << to_json_string(root, true) << '\n';
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "http_context.h"
+
+namespace minerva
+{
+    /*
+     * Bounded ring of recent requests that took longer than a threshold,
+     * each with its per-phase breakdown from http_context::mark_phase().
+     * Fast requests cost one comparison; only captured requests take the
+     * lock.
+     */
+    class slow_request_log
+    {
+    public:
+        struct entry
+        {
+            int64_t     wall_us = 0;     // completion, microseconds since epoch
+            long long   total_us = 0;    // first recorded phase .. SENT
+            long long   phase_us[http_context::PHASE_COUNT] = {};  // -1 if unset
+            int         status = 0;
+            std::string method;
+            std::string path;
+            std::string client_ip;
+            std::string user;
+        };
+
+        static constexpr size_t DEFAULT_CAPACITY     = 64;
+        static constexpr int    DEFAULT_THRESHOLD_MS = 500;
+
+        explicit slow_request_log(size_t capacity = DEFAULT_CAPACITY);
+
+        // 0 disables capture.
+        void threshold_ms(int ms)
+        {
+            m_threshold_us = static_cast<long long>(ms) * 1000;
+        }
+
+        int threshold_ms() const
+        {
+            return static_cast<int>(m_threshold_us / 1000);
+        }
+
+        // Captures ctx if it was slow. Call once the response has been sent.
+        void check(const http_context & ctx, int status,
+                   const char * method, const std::string & path);
+
+        unsigned long long captured_count() const
+        {
+            return m_captured;
+        }
+
+        // Newest first.
+        void write_json(std::ostream & os) const;
+
+    private:
+        std::atomic<long long>          m_threshold_us;
+        std::atomic<unsigned long long> m_captured{0};
+        const size_t                    m_capacity;
+        mutable std::mutex              m_lock;
+        std::vector<entry>              m_ring;
+        size_t                          m_next = 0;
+    };
+}
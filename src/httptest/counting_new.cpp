@@ -0,0 +1,54 @@
+#include <cstdlib>
+#include <new>
+#include <util/alloc_counter.h>
+
+// Global operator new replacements that count each allocation for the
+// per-request allocation figures (httpd::alloc_accounting()). libstdc++'s
+// nothrow forms call these; over-aligned allocations are not counted.
+
+void * operator new(std::size_t size)
+{
+    minerva::alloc_counter::count();
+    if (size == 0)
+    {
+        size = 1;
+    }
+    while (true)
+    {
+        if (void * p = std::malloc(size))
+        {
+            return p;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (!handler)
+        {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+void * operator new[](std::size_t size)
+{
+    return ::operator new(size);
+}
+
+void operator delete(void * p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void * p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void * p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void * p, std::size_t) noexcept
+{
+    std::free(p);
+}
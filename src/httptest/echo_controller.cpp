@@ -1,9 +1,11 @@
 #include <cstdint>
 #include <cstdlib>
 #include <string>
+#include <string_view>
 #include <istream>
 #include <iterator>
 
+#include <util/json_utils.h>
 #include <util/string_utils.h>
 #include <util/log.h>
 #include <httpd/http_request.h>
@@ -47,6 +49,7 @@ namespace minerva
         REGISTER_HANDLER("stream", echo_controller::handle_stream);
         REGISTER_HANDLER("form", echo_controller::handle_form);
         REGISTER_HANDLER("formgen", echo_controller::handle_formgen);
+        REGISTER_HANDLER("param/{name}/{id}", echo_controller::handle_param);
     }
 
     void echo_controller::handle_echo(http_context & ctx)
@@ -97,20 +100,14 @@ namespace minerva
 
     void echo_controller::handle_checksum(http_context & ctx)
     {
-        // Read the body in byte-array passes to exercise the streaming read path.
-        char buf[64 * 1024];
+        // Visit the body in place through the zero-copy consume() path.
         uint64_t h = 1469598103934665603ULL;
-        uint64_t total = 0;
-        size_t n;
-        while ((n = ctx.request().read(buf, sizeof(buf), BODY_TIMEOUT_MS)) > 0)
-        {
-            for (size_t i = 0; i < n; ++i)
+        uint64_t total = ctx.request().consume(
+            [&h](std::string_view v)
             {
-                h ^= static_cast<unsigned char>(buf[i]);
-                h *= 1099511628211ULL;
-            }
-            total += n;
-        }
+                fnv_update(h, v.data(), v.size());
+            },
+            BODY_TIMEOUT_MS);
 
         ctx.response().status_code_success();
         ctx.response().content_type_json();
@@ -120,8 +117,9 @@ namespace minerva
 
     void echo_controller::handle_sink(http_context & ctx)
     {
-        // The body is consumed by the server after the handler returns (httpd
-        // performs a null_body_read), so we simply report no content here.
+        // Discard the body through consume() so it is never copied out of
+        // the receive buffer, then report no content.
+        ctx.request().consume([](std::string_view) {}, BODY_TIMEOUT_MS);
         ctx.response().status_code_no_content();
     }
 
@@ -183,6 +181,7 @@ namespace minerva
         }
         bool stream = ci_equals(mode, "stream");
         bool partial = ci_equals(mode, "partial");
+        bool view = ci_equals(mode, "view");
 
         // Single combined FNV-1a folding each part's metadata and body so the
         // client can verify the whole traversal with one number.
@@ -198,7 +197,16 @@ namespace minerva
             fnv_update_field(h, part.filename);
             fnv_update_field(h, part.content_type);
 
-            if (stream || partial)
+            if (view)
+            {
+                std::string_view v;
+                while (req.read_form_view(v, BODY_TIMEOUT_MS) > 0)
+                {
+                    fnv_update(h, v.data(), v.size());
+                    total += v.size();
+                }
+            }
+            else if (stream || partial)
             {
                 char buf[STREAM_CHUNK];
                 size_t n;
@@ -299,4 +307,14 @@ namespace minerva
 
         ctx.response().end_multipart();
     }
+
+    void echo_controller::handle_param(http_context & ctx)
+    {
+        Json::Value root(Json::objectValue);
+        root["name"] = std::string(ctx.request().path_param("name"));
+        root["id"]   = std::string(ctx.request().path_param("id"));
+        ctx.response().status_code_success();
+        ctx.response().content_type_json();
+        ctx.response().response_stream() << to_json_string(root, false);
+    }
 }
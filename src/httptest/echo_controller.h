@@ -14,7 +14,7 @@ namespace minerva
     //                     response framing (chunked vs content-length) is
     //                     selected by the ?mode=chunked|cl query parameter and
     //                     defaults to mirroring the request framing.
-    //   /echo/checksum  - read the body as a stream of byte arrays and return a
+    //   /echo/checksum  - visit the body in place via consume() and return a
     //                     JSON object with the length and FNV-1a checksum.
     //   /echo/sink      - consume the body without buffering and return 204.
     //   /echo/stream    - generate a deterministic body of ?size= bytes seeded
@@ -22,9 +22,10 @@ namespace minerva
     //                     based on ?mode=.
     //   /echo/form      - parse a multipart/form-data request. The ?read=
     //                     query parameter selects how each part body is
-    //                     consumed: full (read_fully), stream (read loop) or
-    //                     partial (read only the first part, leaving the rest
-    //                     for the server's null-body drain). Returns a JSON
+    //                     consumed: full (read_fully), stream (read loop),
+    //                     view (read_form_view, zero-copy) or partial (read
+    //                     only the first part, leaving the rest for the
+    //                     server's null-body drain). Returns a JSON
     //                     summary with the part count, total body length and a
     //                     combined FNV-1a checksum folding part metadata and
     //                     bodies.
@@ -33,6 +34,9 @@ namespace minerva
     //                     deterministic set of parts (alternating file/field
     //                     parts with deterministic bodies). ?mode=chunked|cl
     //                     selects the response framing.
+    //   /echo/param/{name}/{id}
+    //                   - return the two captured path parameters as JSON,
+    //                     exercising route_table's parameter matching.
     class echo_controller : public controller
     {
     public:
@@ -46,5 +50,6 @@ namespace minerva
         void handle_stream(http_context & ctx);
         void handle_form(http_context & ctx);
         void handle_formgen(http_context & ctx);
+        void handle_param(http_context & ctx);
     };
 }
@@ -1,5 +1,6 @@
 #include <cstdlib>
 #include <cstring>
+#include <memory>
 #include <csignal>
 #include <string>
 #include <thread>
@@ -8,6 +9,9 @@
 #include <util/log.h>
 #include <util/ssl_connection.h>
 #include <httpd/httpd.h>
+#include <httpd/metrics_controller.h>
+#include <httpd/profile_controller.h>
+#include <authdb/auth_db.h>
 
 #include "echo_controller.h"
 #include "raw_controller.h"
@@ -36,11 +40,35 @@ static void print_usage()
             "  --cert FILE      TLS certificate file (required with --https-port)\n"
             "  --key FILE       TLS private key file (required with --https-port)\n"
             "  --log-level L    log level 0-6 (default 3)\n"
+            "  --async-log      write log lines from a background thread\n"
+            "  --log-off F[:L]  silence log statements in file F (or at line L)\n"
+            "  --access-log F   write binary access records to F (see aclog)\n"
+            "  --slow-ms N      capture requests slower than N ms (0 disables)\n"
+            "  --cpu-accounting measure handler thread CPU time per request\n"
+            "  --count-allocs   count heap allocations per request (metrics)\n"
+            "  --max-queue N    answer 503 once N connections wait for a handler\n"
+            "  --queue-target-ms N  answer 503 while queueing delay stays above N ms\n"
+            "  --retry-after S  Retry-After seconds on those 503s (default 1)\n"
+            "  --max-closing N  linger in close for at most N connections\n"
+            "  --rate-limit N[:B]  answer 429 past N requests/s per client\n"
+            "                   address on /echo and /secure (burst B, default N)\n"
+            "  --user-rate-limit N[:B]  likewise per user on /secure\n"
+            "  --webpass FILE   require auth for /metrics, /profile and /secure,\n"
+            "                   users from FILE (create with shield)\n"
+            "  --realm R        auth realm (default httptest)\n"
             "\n"
             "Generate a self-signed cert/key with tools/generate_cert.sh, then:\n"
             "  httptest --https-port 8443 --cert cert.pem --key key.pem\n");
 }
 
+// N[:B] into per_second and burst; the burst defaults to N.
+static void parse_rate(const char * arg, double & per_second, double & burst)
+{
+    per_second = std::atof(arg);
+    const char * colon = std::strchr(arg, ':');
+    burst = colon ? std::atof(colon + 1) : per_second;
+}
+
 int main(int argc, char ** argv)
 {
     signal(SIGPIPE, SIG_IGN);
@@ -48,8 +76,21 @@ int main(int argc, char ** argv)
     int port = 8080;
     int https_port = 0;
     int log_level = 3;
+    bool async_log = false;
+    std::string access_log_path;
+    int slow_ms = slow_request_log::DEFAULT_THRESHOLD_MS;
+    bool cpu_accounting = false;
+    bool count_allocs = false;
+    size_t max_queue = 0;
+    int queue_target_ms = 0;
+    int retry_after = admission_control::DEFAULT_RETRY_AFTER;
+    size_t max_closing = close_manager::DEFAULT_MAX_CLOSING;
+    double rate_limit = 0, rate_burst = 0;
+    double user_rate_limit = 0, user_rate_burst = 0;
     std::string cert_file;
     std::string key_file;
+    std::string webpass;
+    std::string realm = "httptest";
 
     for (int i = 1; i < argc; ++i)
     {
@@ -73,6 +114,66 @@ int main(int argc, char ** argv)
         {
             log_level = std::atoi(argv[++i]);
         }
+        else if (std::strcmp(argv[i], "--async-log") == 0)
+        {
+            async_log = true;
+        }
+        else if (std::strcmp(argv[i], "--slow-ms") == 0 && i + 1 < argc)
+        {
+            slow_ms = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--access-log") == 0 && i + 1 < argc)
+        {
+            access_log_path = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--cpu-accounting") == 0)
+        {
+            cpu_accounting = true;
+        }
+        else if (std::strcmp(argv[i], "--count-allocs") == 0)
+        {
+            count_allocs = true;
+        }
+        else if (std::strcmp(argv[i], "--max-queue") == 0 && i + 1 < argc)
+        {
+            max_queue = static_cast<size_t>(std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--queue-target-ms") == 0 && i + 1 < argc)
+        {
+            queue_target_ms = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--retry-after") == 0 && i + 1 < argc)
+        {
+            retry_after = std::atoi(argv[++i]);
+        }
+        else if (std::strcmp(argv[i], "--max-closing") == 0 && i + 1 < argc)
+        {
+            max_closing = static_cast<size_t>(std::atoi(argv[++i]));
+        }
+        else if (std::strcmp(argv[i], "--rate-limit") == 0 && i + 1 < argc)
+        {
+            parse_rate(argv[++i], rate_limit, rate_burst);
+        }
+        else if (std::strcmp(argv[i], "--user-rate-limit") == 0 && i + 1 < argc)
+        {
+            parse_rate(argv[++i], user_rate_limit, user_rate_burst);
+        }
+        else if (std::strcmp(argv[i], "--webpass") == 0 && i + 1 < argc)
+        {
+            webpass = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--realm") == 0 && i + 1 < argc)
+        {
+            realm = argv[++i];
+        }
+        else if (std::strcmp(argv[i], "--log-off") == 0 && i + 1 < argc)
+        {
+            std::string site = argv[++i];
+            size_t colon = site.find(':');
+            int line = colon == std::string::npos ?
+                0 : std::atoi(site.c_str() + colon + 1);
+            log::set_site_enabled(site.substr(0, colon), line, false);
+        }
         else
         {
             print_usage();
@@ -81,6 +182,7 @@ int main(int argc, char ** argv)
     }
 
     log::set_log_level(static_cast<log::LOG_LEVEL>(log_level));
+    log::set_async(async_log);
 
     if (https_port > 0 && (cert_file.empty() || key_file.empty()))
     {
@@ -107,9 +209,47 @@ int main(int argc, char ** argv)
 
     // Controllers are plain objects owned by main; they outlive the server.
     echo_controller echo;
+    // The echo handlers again, behind authorization, for timing auth.
+    echo_controller secure;
+    secure.require_authorization(true);
+    echo.client_rate_limit(rate_limit, rate_burst);
+    secure.client_rate_limit(rate_limit, rate_burst);
+    secure.user_rate_limit(user_rate_limit, user_rate_burst);
     raw_controller raw;
+    metrics_controller metrics(*server);
+    profile_controller profile(*server);
+
+    if (!access_log_path.empty())
+    {
+        server->access_log_file(access_log_path);
+    }
+    server->slow_requests().threshold_ms(slow_ms);
+    server->cpu_accounting(cpu_accounting);
+    server->alloc_accounting(count_allocs);
+    server->admission().max_queue(max_queue);
+    server->admission().target_ms(queue_target_ms);
+    server->admission().retry_after_seconds(retry_after);
+    server->closer().max_closing(max_closing);
+
+    // echo and raw stay public; the secure, metrics and profile
+    // controllers require authorization, which applies once an auth db is
+    // set.
+    std::unique_ptr<auth_db> users;
+    if (!webpass.empty())
+    {
+        users.reset(new auth_db(realm, webpass));
+        if (!users->initialize())
+        {
+            LOG_FATAL("failed to load auth db " << webpass);
+            return 1;
+        }
+        server->auth_db(users.get());
+    }
 
     server->register_controller("echo", &echo);
+    server->register_controller("secure", &secure);
+    server->register_controller("metrics", &metrics);
+    server->register_controller("profile", &profile);
     server->register_default_controller(&raw);
 
     if (port > 0)
@@ -139,5 +279,6 @@ int main(int argc, char ** argv)
     }
 
     LOG_INFO("httptest exiting");
+    log::set_async(false);
     return 0;
 }
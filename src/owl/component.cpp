@@ -72,4 +72,9 @@ namespace minerva
     {
         return visor->cancel_job(handle);
     }
+
+    const minerva::latency_histogram & component::scheduler_lag() const
+    {
+        return visor->scheduler_lag();
+    }
 }
@@ -5,6 +5,7 @@
 #include <mutex>
 #include <functional>
 #include <condition_variable>
+#include <util/instrumented_mutex.h>
 #include <util/thread_pool.h>
 #include <util/scheduler.h>
 
@@ -49,8 +50,8 @@ namespace minerva
 
     protected:
         
-        std::mutex lock;
-        std::condition_variable cond;
+        instrumented_mutex lock;
+        instrumented_condition_variable cond;
         
         minerva::thread_pool * add_thread_pool(int count);
 
@@ -60,6 +61,8 @@ namespace minerva
         
         bool cancel_job(const minerva::scheduler::job_handle & handle);
 
+        const minerva::latency_histogram & scheduler_lag() const;
+
     private:
         friend class component_visor;
         std::mutex m_shutdown_mutex;
@@ -96,6 +96,7 @@ namespace minerva
 
         m_should_shutdown = true;
 
+        profiler.stop();
         sched.stop();
 
         std::for_each(components.begin(), components.end(),
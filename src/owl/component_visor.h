@@ -10,6 +10,7 @@
 #include <util/thread_pool.h>
 #include <util/scheduler.h>
 #include "component.h"
+#include "profiler.h"
 
 namespace minerva
 {
@@ -25,6 +26,7 @@ namespace minerva
         std::set<std::thread*> threads;
         std::set<minerva::thread_pool *> thread_pools;
         minerva::scheduler sched;
+        minerva::sampling_profiler profiler;
         bool running;
         std::mutex lock;
         std::condition_variable cond;
@@ -54,6 +56,17 @@ namespace minerva
             return sched.cancel_job(handle);
         }
 
+        const minerva::latency_histogram & scheduler_lag() const
+        {
+            return sched.lag();
+        }
+
+        // Process-wide CPU profiler; stopped with the visor.
+        minerva::sampling_profiler & get_profiler()
+        {
+            return profiler;
+        }
+
         void add_thread(const std::function<void()> & routine);
 
         minerva::thread_pool * add_thread_pool(int count)
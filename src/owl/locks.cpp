@@ -2,7 +2,14 @@
 
 namespace minerva
 {
-    std::shared_mutex shared_lock;
+    instrumented_shared_mutex shared_lock;
     
-    std::mutex global_lock;
+    instrumented_mutex global_lock;
+
+    namespace
+    {
+        const bool s_named = (name_lock(shared_lock, "shared_lock"),
+                              name_lock(global_lock, "global_lock"),
+                              true);
+    }
 }
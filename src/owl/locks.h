@@ -3,12 +3,13 @@
 #include <mutex>
 #include <shared_mutex>
 #include <condition_variable>
+#include <util/instrumented_mutex.h>
 
 namespace minerva
 {
-   extern std::shared_mutex shared_lock;
+   extern instrumented_shared_mutex shared_lock;
 
-   extern std::mutex global_lock;
+   extern instrumented_mutex global_lock;
 
    class locks
    {
@@ -0,0 +1,289 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <dirent.h>
+#include <execinfo.h>
+#include <ucontext.h>
+#include <util/log.h>
+#include <util/symbols.h>
+#include "profiler.h"
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+namespace minerva
+{
+    namespace
+    {
+        std::atomic<sampling_profiler *> s_active{nullptr};
+        // Handlers between entry and exit; stop() waits for this to drain
+        // before the sample array may be read or freed.
+        std::atomic<int>                 s_in_handler{0};
+
+        // Linux encodes another thread's CPU-time clock as ~tid << 3 with
+        // the per-thread and CPUCLOCK_SCHED bits set; there is no libc call
+        // for it because pthread_getcpuclockid() needs a pthread_t.
+        clockid_t thread_cpu_clock(pid_t tid)
+        {
+            return static_cast<clockid_t>((~static_cast<unsigned>(tid) << 3) | 6u);
+        }
+
+        int64_t monotonic_ns()
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+        }
+
+        void * interrupted_pc(void * uctx)
+        {
+            auto * uc = static_cast<ucontext_t *>(uctx);
+#if defined(__x86_64__)
+            return reinterpret_cast<void *>(uc->uc_mcontext.gregs[REG_RIP]);
+#elif defined(__aarch64__)
+            return reinterpret_cast<void *>(uc->uc_mcontext.pc);
+#else
+            (void)uc;
+            return nullptr;
+#endif
+        }
+
+        std::vector<pid_t> list_threads()
+        {
+            std::vector<pid_t> tids;
+            DIR * dir = opendir("/proc/self/task");
+            if (!dir)
+            {
+                return tids;
+            }
+            while (struct dirent * ent = readdir(dir))
+            {
+                if (ent->d_name[0] >= '0' && ent->d_name[0] <= '9')
+                {
+                    tids.push_back(static_cast<pid_t>(std::atoi(ent->d_name)));
+                }
+            }
+            closedir(dir);
+            return tids;
+        }
+    }
+
+    sampling_profiler::~sampling_profiler()
+    {
+        stop();
+    }
+
+    bool sampling_profiler::start(int hz, size_t capacity)
+    {
+        std::unique_lock<std::mutex> lk(m_lock);
+        if (m_running || s_active.load() != nullptr)
+        {
+            return false;
+        }
+
+        // The handler stays installed for the life of the process: a
+        // SIGPROF still in flight after stop() must not hit the default
+        // action, which terminates.
+        static std::once_flag installed;
+        std::call_once(installed, [] {
+            struct sigaction sa;
+            memset(&sa, 0, sizeof(sa));
+            sa.sa_sigaction = &sampling_profiler::on_signal;
+            sa.sa_flags = SA_SIGINFO | SA_RESTART;
+            sigemptyset(&sa.sa_mask);
+            sigaction(SIGPROF, &sa, nullptr);
+            // The first backtrace() loads the unwinder, which allocates;
+            // do it here rather than in the handler.
+            void * warm[2];
+            backtrace(warm, 2);
+        });
+
+        hz = std::clamp(hz, 1, MAX_HZ);
+        m_capacity = std::max<size_t>(capacity, 1);
+        m_samples.reset(new sample[m_capacity]);
+        m_next = 0;
+        m_dropped = 0;
+        m_handler_ns = 0;
+
+        sampling_profiler * expected = nullptr;
+        if (!s_active.compare_exchange_strong(expected, this))
+        {
+            m_samples.reset();
+            return false;
+        }
+
+        struct itimerspec its;
+        memset(&its, 0, sizeof(its));
+        its.it_interval.tv_nsec = 1000000000L / hz;
+        its.it_value = its.it_interval;
+
+        for (pid_t tid : list_threads())
+        {
+            struct sigevent sev;
+            memset(&sev, 0, sizeof(sev));
+            sev.sigev_notify = SIGEV_THREAD_ID;
+            sev.sigev_signo = SIGPROF;
+            sev.sigev_notify_thread_id = tid;
+
+            timer_t timer;
+            if (timer_create(thread_cpu_clock(tid), &sev, &timer) != 0)
+            {
+                // The thread may have exited since the directory was read.
+                LOG_DEBUG("profiler: no timer for thread " << tid << ": "
+                          << strerror(errno));
+                continue;
+            }
+            if (timer_settime(timer, 0, &its, nullptr) != 0)
+            {
+                timer_delete(timer);
+                continue;
+            }
+            m_timers.push_back(timer);
+        }
+
+        if (m_timers.empty())
+        {
+            LOG_ERROR("profiler: could not arm any thread timer");
+            s_active = nullptr;
+            m_samples.reset();
+            return false;
+        }
+
+        m_thread_count = m_timers.size();
+        m_running = true;
+        LOG_INFO("profiler: sampling " << m_timers.size() << " threads at "
+                 << hz << " Hz");
+        return true;
+    }
+
+    void sampling_profiler::stop()
+    {
+        std::unique_lock<std::mutex> lk(m_lock);
+        stop_locked();
+    }
+
+    void sampling_profiler::stop_locked()
+    {
+        if (!m_running)
+        {
+            return;
+        }
+        for (timer_t timer : m_timers)
+        {
+            timer_delete(timer);
+        }
+        m_timers.clear();
+
+        s_active = nullptr;
+        while (s_in_handler.load() != 0)
+        {
+            std::this_thread::yield();
+        }
+        m_running = false;
+
+        LOG_INFO("profiler: stopped, " << sample_count() << " samples, "
+                 << dropped_count() << " dropped, "
+                 << handler_ns() / 1000 << " us in handler");
+    }
+
+    size_t sampling_profiler::sample_count() const
+    {
+        return std::min(m_next.load(std::memory_order_relaxed), m_capacity);
+    }
+
+    void sampling_profiler::on_signal(int, siginfo_t *, void * uctx)
+    {
+        const int saved_errno = errno;
+        s_in_handler.fetch_add(1);
+        if (sampling_profiler * p = s_active.load())
+        {
+            p->record(uctx);
+        }
+        s_in_handler.fetch_sub(1);
+        errno = saved_errno;
+    }
+
+    void sampling_profiler::record(void * uctx)
+    {
+        const int64_t begin = monotonic_ns();
+
+        const size_t idx = m_next.fetch_add(1, std::memory_order_relaxed);
+        if (idx >= m_capacity)
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        sample & s = m_samples[idx];
+        int depth = backtrace(s.pcs, MAX_DEPTH);
+
+        // Drop the handler and signal trampoline frames: the stack proper
+        // starts at the interrupted instruction.
+        void * pc = interrupted_pc(uctx);
+        int first = 0;
+        while (first < depth && s.pcs[first] != pc)
+        {
+            ++first;
+        }
+        if (first == depth)
+        {
+            first = std::min(depth, 2);
+        }
+        std::memmove(s.pcs, s.pcs + first, (depth - first) * sizeof(void *));
+        s.depth = depth - first;
+
+        m_handler_ns.fetch_add(static_cast<uint64_t>(monotonic_ns() - begin),
+                               std::memory_order_relaxed);
+    }
+
+    void sampling_profiler::collect(std::ostream & os)
+    {
+        std::unique_lock<std::mutex> lk(m_lock);
+        stop_locked();
+        if (!m_samples)
+        {
+            return;
+        }
+
+        std::unordered_map<void *, std::string> leaf_names;
+        std::unordered_map<void *, std::string> caller_names;
+        std::map<std::string, uint64_t> stacks;
+
+        const size_t count = sample_count();
+        for (size_t i = 0; i < count; ++i)
+        {
+            const sample & s = m_samples[i];
+            if (s.depth <= 0)
+            {
+                continue;
+            }
+            std::string key;
+            for (int f = s.depth - 1; f >= 0; --f)
+            {
+                auto & names = f == 0 ? leaf_names : caller_names;
+                auto it = names.find(s.pcs[f]);
+                if (it == names.end())
+                {
+                    it = names.emplace(s.pcs[f], symbol_name(s.pcs[f], f != 0)).first;
+                }
+                if (!key.empty())
+                {
+                    key += ';';
+                }
+                key += it->second;
+            }
+            ++stacks[key];
+        }
+
+        for (const auto & [stack, n] : stacks)
+        {
+            os << stack << ' ' << n << '\n';
+        }
+    }
+}
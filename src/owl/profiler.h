@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+#include <signal.h>
+#include <time.h>
+
+namespace minerva
+{
+    /*
+     * In-process sampling CPU profiler.
+     *
+     * start() arms one timer per thread that exists at that moment, each on
+     * the thread's own CPU-time clock, so a thread is sampled in proportion
+     * to the CPU it burns and an idle thread costs nothing. Each expiry
+     * delivers SIGPROF to that thread; the handler unwinds the interrupted
+     * stack with backtrace() into a slot claimed from a preallocated array
+     * by a single atomic increment. Nothing in the handler locks or
+     * allocates. Once the array is full further samples are counted as
+     * dropped. Threads created after start() are not sampled.
+     *
+     * Overhead budget: while stopped there are no timers and the (one-off)
+     * SIGPROF handler never runs, so the cost is zero. While running, each
+     * sample costs one unwind of at most MAX_DEPTH frames, 15-40 us on a
+     * release build; at DEFAULT_HZ that is about 0.3% of each busy core,
+     * and MAX_HZ bounds it to about 3%. The time actually spent in the
+     * handler is measured and reported by handler_ns().
+     *
+     * Only one profiler can run per process. start(), stop() and collect()
+     * may be called from any thread.
+     */
+    class sampling_profiler
+    {
+    public:
+        static constexpr int    DEFAULT_HZ       = 99;
+        static constexpr int    MAX_HZ           = 1000;
+        static constexpr int    MAX_DEPTH        = 32;
+        static constexpr size_t DEFAULT_CAPACITY = 32768;
+
+        sampling_profiler() = default;
+        ~sampling_profiler();
+
+        sampling_profiler(const sampling_profiler &)             = delete;
+        sampling_profiler & operator=(const sampling_profiler &) = delete;
+
+        // Discards any previous samples. Returns false if a profiler is
+        // already running in this process or no timer could be armed.
+        bool start(int hz = DEFAULT_HZ, size_t capacity = DEFAULT_CAPACITY);
+
+        // Disarms the timers and waits for in-flight handlers to finish.
+        // Samples are kept until the next start().
+        void stop();
+
+        bool running() const
+        {
+            return m_running;
+        }
+
+        // Threads armed by the last start().
+        size_t thread_count() const
+        {
+            return m_thread_count;
+        }
+
+        size_t sample_count() const;
+
+        uint64_t dropped_count() const
+        {
+            return m_dropped.load(std::memory_order_relaxed);
+        }
+
+        // Total time spent inside the signal handler.
+        uint64_t handler_ns() const
+        {
+            return m_handler_ns.load(std::memory_order_relaxed);
+        }
+
+        // Stops sampling if it is running and writes one line per distinct
+        // stack, "outer;...;inner count", the input format of flamegraph.pl.
+        void collect(std::ostream & os);
+
+    private:
+        struct sample
+        {
+            int    depth = 0;
+            void * pcs[MAX_DEPTH];
+        };
+
+        static void on_signal(int sig, siginfo_t * info, void * uctx);
+        void record(void * uctx);
+        void stop_locked();
+
+        std::mutex                m_lock;
+        std::atomic<bool>         m_running{false};
+        std::vector<timer_t>      m_timers;
+        size_t                    m_thread_count = 0;
+        std::unique_ptr<sample[]> m_samples;
+        size_t                    m_capacity = 0;
+        std::atomic<size_t>       m_next{0};
+        std::atomic<uint64_t>     m_dropped{0};
+        std::atomic<uint64_t>     m_handler_ns{0};
+    };
+}
@@ -1,4 +1,5 @@
 #include <string>
+#include <vector>
 #include <iostream>
 #include <cstring>
 #include <unistd.h>
@@ -122,6 +123,10 @@ static void print_usage(const char * bin)
         << bin << " -S <realm> <user> <password> <db_file>\n"
         "delete user:\n  "
         << bin << " -d <realm> <user> <db_file>\n"
+        "import users from stdin, one <user>:<password> per line:\n  "
+        << bin << " -i <realm> <db_file>\n"
+        "fold the change journal into the db file:\n  "
+        << bin << " -c <realm> <db_file>\n"
         "Note: <realm> must match the server's configured digest realm or\n"
         "the user will not be able to authenticate via digest auth.\n";
 }
@@ -245,6 +250,90 @@ int main(int argc, char ** argv)
         return 0;
     }
 
+    else if (cmd == "-i")
+    {
+        if (argc != 4)
+        {
+            print_usage(bin);
+            return 1;
+        }
+
+        std::string realm(argv[2]);
+        std::string file(argv[3]);
+
+        if (realm.empty() || file.empty())
+        {
+            LOG_ERROR("realm and db_file must be non-empty");
+            print_usage(bin);
+            return 1;
+        }
+
+        minerva::auth_db db(realm, file);
+        if (!db.initialize())
+        {
+            LOG_ERROR("failed to load auth db");
+            return 1;
+        }
+
+        std::vector<minerva::auth_db::credentials> batch;
+        std::string line;
+        size_t lineno = 0;
+        bool ok = true;
+        while (std::getline(std::cin, line))
+        {
+            ++lineno;
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+            auto pos = line.find(':');
+            if (pos == std::string::npos || pos == 0 || pos + 1 == line.size())
+            {
+                LOG_ERROR("expected <user>:<password> at line " << lineno);
+                ok = false;
+                break;
+            }
+            batch.push_back({ line.substr(0, pos), line.substr(pos + 1) });
+            secure_zero_string(line);
+        }
+        secure_zero_string(line);
+
+        // Imported in one journal append, then folded into the file.
+        ok = ok && db.set_users(batch, realm) && db.compact();
+        for (auto & c : batch)
+        {
+            secure_zero_string(c.password);
+        }
+        if (!ok)
+        {
+            LOG_ERROR("failed to import users into auth db");
+            return 1;
+        }
+
+        LOG_INFO("imported " << batch.size() << " users");
+        return 0;
+    }
+    else if (cmd == "-c")
+    {
+        if (argc != 4)
+        {
+            print_usage(bin);
+            return 1;
+        }
+
+        minerva::auth_db db(argv[2], argv[3]);
+        if (!db.initialize() || !db.compact())
+        {
+            LOG_ERROR("failed to compact auth db");
+            return 1;
+        }
+        return 0;
+    }
+
     print_usage(bin);
     return 1;
 }
@@ -0,0 +1,34 @@
+#include <atomic>
+#include "alloc_counter.h"
+
+namespace minerva
+{
+    namespace alloc_counter
+    {
+        namespace
+        {
+            // Constant-initialized, so access needs no TLS guard and never
+            // allocates itself.
+            thread_local uint64_t t_count = 0;
+            std::atomic<bool>     s_active{false};
+        }
+
+        uint64_t thread_count()
+        {
+            return t_count;
+        }
+
+        bool active()
+        {
+            return s_active.load(std::memory_order_relaxed);
+        }
+
+        void count()
+        {
+            if (++t_count == 1 && !s_active.load(std::memory_order_relaxed))
+            {
+                s_active.store(true, std::memory_order_relaxed);
+            }
+        }
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+namespace minerva
+{
+    /**
+     * Per-thread count of heap allocations.
+     *
+     * Nothing here replaces operator new: a program that wants the figures
+     * links a replacement that calls alloc_counter::count() (httptest's
+     * counting_new.cpp does). Without one, thread_count() stays 0 and
+     * active() is false.
+     */
+    namespace alloc_counter
+    {
+        // Allocations made so far by the calling thread.
+        uint64_t thread_count();
+
+        // True once a counting operator new has run.
+        bool active();
+
+        // For the replacement operator new.
+        void count();
+    }
+}
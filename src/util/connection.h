@@ -63,6 +63,13 @@ namespace minerva
             return false;
         }
 
+        // True when bytes on the socket are not application data (TLS), so
+        // the fd must not be read or spliced directly.
+        virtual bool is_secure() const
+        {
+            return false;
+        }
+
         class shared_poll_fd
         {
         public:
@@ -0,0 +1,52 @@
+#include <cmath>
+#include "histogram.h"
+
+namespace minerva
+{
+    void latency_histogram::take_snapshot(snapshot & snap) const
+    {
+        snap.count = 0;
+        for (size_t i = 0; i < BUCKETS; ++i)
+        {
+            snap.counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+            snap.count += snap.counts[i];
+        }
+        // Derive count from the buckets so quantiles are self-consistent.
+        snap.sum = m_sum.load(std::memory_order_relaxed);
+        snap.max = m_max.load(std::memory_order_relaxed);
+    }
+
+    uint64_t latency_histogram::snapshot::percentile(double q) const
+    {
+        if (count == 0)
+        {
+            return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(std::ceil(q * count));
+        if (rank == 0)
+        {
+            rank = 1;
+        }
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; ++i)
+        {
+            seen += counts[i];
+            if (seen >= rank)
+            {
+                const uint64_t upper = bucket_upper(i);
+                return upper < max ? upper : max;
+            }
+        }
+        return max;
+    }
+
+    uint64_t latency_histogram::snapshot::count_at_or_below(uint64_t limit) const
+    {
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS && bucket_upper(i) <= limit; ++i)
+        {
+            seen += counts[i];
+        }
+        return seen;
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace minerva
+{
+    /**
+     * Lock-free log-linear histogram for latencies in microseconds.
+     *
+     * Values below SUB_COUNT are counted exactly; above that each power of
+     * two is split into SUB_COUNT equal buckets, so a reported quantile is
+     * within 1/SUB_COUNT (6.25%) of the true value. Values beyond the top
+     * bucket (~19 hours) are clamped into it.
+     *
+     * record() is a handful of relaxed atomic adds and is safe to call from
+     * any number of threads. Readers take a snapshot(); counts recorded
+     * while a snapshot is being taken may or may not be included.
+     */
+    class latency_histogram
+    {
+    public:
+        static constexpr int    SUB_BITS  = 4;
+        static constexpr int    SUB_COUNT = 1 << SUB_BITS;
+        static constexpr int    MAX_EXP   = 36;
+        static constexpr size_t BUCKETS   = (MAX_EXP - SUB_BITS + 1) * SUB_COUNT;
+
+        struct snapshot
+        {
+            std::array<uint64_t, BUCKETS> counts{};
+            uint64_t count = 0;
+            uint64_t sum   = 0;
+            uint64_t max   = 0;
+
+            // Upper bound of the bucket holding quantile q (0..1).
+            uint64_t percentile(double q) const;
+
+            // Number of recorded values <= limit, to bucket precision.
+            uint64_t count_at_or_below(uint64_t limit) const;
+        };
+
+        void record(uint64_t value)
+        {
+            m_buckets[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+            m_count.fetch_add(1, std::memory_order_relaxed);
+            m_sum.fetch_add(value, std::memory_order_relaxed);
+            uint64_t prev = m_max.load(std::memory_order_relaxed);
+            while (value > prev &&
+                   !m_max.compare_exchange_weak(prev, value,
+                                                std::memory_order_relaxed))
+            {
+            }
+        }
+
+        void take_snapshot(snapshot & snap) const;
+
+        uint64_t count() const
+        {
+            return m_count.load(std::memory_order_relaxed);
+        }
+
+        static size_t bucket_index(uint64_t value)
+        {
+            if (value < SUB_COUNT)
+            {
+                return static_cast<size_t>(value);
+            }
+            int exp = 63 - __builtin_clzll(value);
+            if (exp >= MAX_EXP)
+            {
+                return BUCKETS - 1;
+            }
+            const int shift = exp - SUB_BITS;
+            const size_t sub = (value >> shift) & (SUB_COUNT - 1);
+            return static_cast<size_t>(shift + 1) * SUB_COUNT + sub;
+        }
+
+        // Largest value that maps to bucket i.
+        static uint64_t bucket_upper(size_t i)
+        {
+            if (i < SUB_COUNT)
+            {
+                return i;
+            }
+            const int shift = static_cast<int>(i / SUB_COUNT) - 1;
+            const uint64_t sub = i % SUB_COUNT;
+            return ((SUB_COUNT + sub + 1) << shift) - 1;
+        }
+
+    private:
+        std::array<std::atomic<uint64_t>, BUCKETS> m_buckets{};
+        std::atomic<uint64_t> m_count{0};
+        std::atomic<uint64_t> m_sum{0};
+        std::atomic<uint64_t> m_max{0};
+    };
+}
@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <execinfo.h>
+#include <time.h>
+#include "instrumented_mutex.h"
+#include "json_utils.h"
+#include "symbols.h"
+
+namespace minerva
+{
+#if MINERVA_LOCK_STATS
+
+    namespace
+    {
+        struct lock_registry
+        {
+            std::mutex              lock;
+            std::set<lock_stats *>  all;
+        };
+
+        // Function-local so locks with static storage in other translation
+        // units can register during their own initialization.
+        lock_registry & registry()
+        {
+            static lock_registry r;
+            return r;
+        }
+
+        // Frames inside the lock machinery; the holder site is the first
+        // frame past them.
+        bool is_lock_frame(const std::string & name)
+        {
+            return name.compare(0, 5, "std::") == 0 ||
+                   name.find("minerva::instrumented_") != std::string::npos ||
+                   name.find("minerva::lock_stats") != std::string::npos;
+        }
+
+        struct merged_lock
+        {
+            uint64_t instances       = 0;
+            uint64_t acquires        = 0;
+            uint64_t shared_acquires = 0;
+            uint64_t contended       = 0;
+            uint64_t site_overflow   = 0;
+            latency_histogram::snapshot wait;
+            std::map<std::string, uint64_t> holders;
+        };
+    }
+
+    lock_stats::lock_stats()
+    {
+        auto & r = registry();
+        std::lock_guard<std::mutex> lk(r.lock);
+        r.all.insert(this);
+    }
+
+    lock_stats::~lock_stats()
+    {
+        auto & r = registry();
+        std::lock_guard<std::mutex> lk(r.lock);
+        r.all.erase(this);
+    }
+
+    int64_t lock_stats::now_ns()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    }
+
+    void lock_stats::contended_release()
+    {
+        void * pcs[SITE_DEPTH + 1];
+        const int depth = backtrace(pcs, SITE_DEPTH + 1);
+        // Skip this frame.
+        void ** frames = pcs + 1;
+        const int frame_count = std::max(depth - 1, 0);
+
+        uint64_t key = 1469598103934665603ULL;
+        for (int i = 0; i < frame_count; ++i)
+        {
+            key = (key ^ reinterpret_cast<uintptr_t>(frames[i])) * 1099511628211ULL;
+        }
+        key |= 1;
+
+        for (int probe = 0; probe < SITE_SLOTS; ++probe)
+        {
+            site & s = m_sites[(key + probe) % SITE_SLOTS];
+            uint64_t current = s.key.load(std::memory_order_acquire);
+            if (current == 0 &&
+                s.key.compare_exchange_strong(current, key,
+                                              std::memory_order_acq_rel))
+            {
+                std::copy(frames, frames + frame_count, s.pcs);
+                s.depth = frame_count;
+                s.ready.store(true, std::memory_order_release);
+                s.count.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            if (current == key)
+            {
+                s.count.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+        m_site_overflow.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void write_lock_report(std::ostream & os)
+    {
+        std::map<std::string, merged_lock> merged;
+        std::unordered_map<void *, std::string> names;
+
+        {
+            auto & r = registry();
+            std::lock_guard<std::mutex> lk(r.lock);
+            for (const lock_stats * stats : r.all)
+            {
+                merged_lock & m = merged[stats->m_name.load(std::memory_order_relaxed)];
+                ++m.instances;
+                m.acquires        += stats->m_acquires.load(std::memory_order_relaxed);
+                m.shared_acquires += stats->m_shared_acquires.load(std::memory_order_relaxed);
+                m.contended       += stats->m_contended.load(std::memory_order_relaxed);
+                m.site_overflow   += stats->m_site_overflow.load(std::memory_order_relaxed);
+
+                latency_histogram::snapshot snap;
+                stats->m_wait_ns.take_snapshot(snap);
+                for (size_t i = 0; i < latency_histogram::BUCKETS; ++i)
+                {
+                    m.wait.counts[i] += snap.counts[i];
+                }
+                m.wait.count += snap.count;
+                m.wait.sum   += snap.sum;
+                m.wait.max    = std::max(m.wait.max, snap.max);
+
+                for (const auto & s : stats->m_sites)
+                {
+                    if (!s.ready.load(std::memory_order_acquire))
+                    {
+                        continue;
+                    }
+                    std::string holder = "?";
+                    for (int i = 0; i < s.depth; ++i)
+                    {
+                        auto it = names.find(s.pcs[i]);
+                        if (it == names.end())
+                        {
+                            it = names.emplace(s.pcs[i], symbol_name(s.pcs[i], true)).first;
+                        }
+                        if (!is_lock_frame(it->second))
+                        {
+                            holder = it->second;
+                            break;
+                        }
+                    }
+                    m.holders[holder] += s.count.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        std::vector<std::pair<std::string, const merged_lock *>> order;
+        for (const auto & entry : merged)
+        {
+            order.emplace_back(entry.first, &entry.second);
+        }
+        std::stable_sort(order.begin(), order.end(), [](const auto & a, const auto & b) {
+            return a.second->contended > b.second->contended;
+        });
+
+        Json::Value root(Json::objectValue);
+        root["enabled"] = true;
+        Json::Value locks(Json::arrayValue);
+        for (const auto & [name, m] : order)
+        {
+            Json::Value v(Json::objectValue);
+            v["name"]            = name;
+            v["instances"]       = Json::UInt64(m->instances);
+            v["acquires"]        = Json::UInt64(m->acquires);
+            v["shared_acquires"] = Json::UInt64(m->shared_acquires);
+            v["contended"]       = Json::UInt64(m->contended);
+
+            Json::Value wait(Json::objectValue);
+            wait["mean_ns"] = Json::UInt64(m->wait.count ? m->wait.sum / m->wait.count : 0);
+            wait["p50_ns"]  = Json::UInt64(m->wait.percentile(0.5));
+            wait["p99_ns"]  = Json::UInt64(m->wait.percentile(0.99));
+            wait["max_ns"]  = Json::UInt64(m->wait.max);
+            v["wait"] = wait;
+
+            std::vector<std::pair<uint64_t, std::string>> holders;
+            for (const auto & [site, count] : m->holders)
+            {
+                holders.emplace_back(count, site);
+            }
+            std::sort(holders.rbegin(), holders.rend());
+            Json::Value hv(Json::arrayValue);
+            for (const auto & [count, site] : holders)
+            {
+                Json::Value h(Json::objectValue);
+                h["site"]     = site;
+                h["releases"] = Json::UInt64(count);
+                hv.append(h);
+            }
+            v["holders"] = hv;
+            v["holder_sites_dropped"] = Json::UInt64(m->site_overflow);
+            locks.append(v);
+        }
+        root["locks"] = locks;
+        os << to_json_string(root, true) << '\n';
+    }
+
+#else
+
+    void write_lock_report(std::ostream & os)
+    {
+        Json::Value root(Json::objectValue);
+        root["enabled"] = false;
+        os << to_json_string(root, true) << '\n';
+    }
+
+#endif
+}
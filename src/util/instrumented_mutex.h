@@ -0,0 +1,256 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <shared_mutex>
+#include "histogram.h"
+
+// Set from CMake: on by default except in Release/MinSizeRel builds.
+#ifndef MINERVA_LOCK_STATS
+#define MINERVA_LOCK_STATS 0
+#endif
+
+namespace minerva
+{
+#if MINERVA_LOCK_STATS
+
+    /**
+     * Contention statistics for one instrumented lock.
+     *
+     * An uncontended acquire costs one relaxed increment. A contended one
+     * also reads the clock twice and records the wait in a histogram (in
+     * nanoseconds). A release that finds waiters captures its own call
+     * stack so the report can name the sites that held the lock while
+     * others queued; that backtrace() only runs under contention.
+     *
+     * Every live lock is registered for write_lock_report(). Statistics
+     * die with the lock, so short-lived objects should stay uninstrumented.
+     */
+    class lock_stats
+    {
+    public:
+        static constexpr int SITE_SLOTS = 32;
+        static constexpr int SITE_DEPTH = 8;
+
+        lock_stats();
+        ~lock_stats();
+
+        lock_stats(const lock_stats &)             = delete;
+        lock_stats & operator=(const lock_stats &) = delete;
+
+        void name(const char * name)
+        {
+            m_name.store(name, std::memory_order_relaxed);
+        }
+
+        void acquired(bool shared)
+        {
+            (shared ? m_shared_acquires : m_acquires).fetch_add(
+                1, std::memory_order_relaxed);
+        }
+
+        void waited(int64_t ns)
+        {
+            m_contended.fetch_add(1, std::memory_order_relaxed);
+            m_wait_ns.record(ns > 0 ? static_cast<uint64_t>(ns) : 0);
+        }
+
+        // Called after a release that found waiters.
+        void contended_release();
+
+        static int64_t now_ns();
+
+    private:
+        friend void write_lock_report(std::ostream & os);
+
+        struct site
+        {
+            std::atomic<uint64_t> key{0};
+            std::atomic<bool>     ready{false};
+            void *                pcs[SITE_DEPTH] = {};
+            int                   depth = 0;
+            std::atomic<uint64_t> count{0};
+        };
+
+        std::atomic<const char *>      m_name{"unnamed"};
+        std::atomic<uint64_t>          m_acquires{0};
+        std::atomic<uint64_t>          m_shared_acquires{0};
+        std::atomic<uint64_t>          m_contended{0};
+        std::atomic<uint64_t>          m_site_overflow{0};
+        std::array<site, SITE_SLOTS>   m_sites;
+        latency_histogram              m_wait_ns;
+    };
+
+    // Drop-in for std::mutex that feeds a lock_stats.
+    class instrumented_mutex
+    {
+    public:
+        instrumented_mutex() = default;
+
+        instrumented_mutex(const instrumented_mutex &)             = delete;
+        instrumented_mutex & operator=(const instrumented_mutex &) = delete;
+
+        void lock()
+        {
+            if (!m_mutex.try_lock())
+            {
+                m_waiting.fetch_add(1, std::memory_order_relaxed);
+                const int64_t begin = lock_stats::now_ns();
+                m_mutex.lock();
+                m_stats.waited(lock_stats::now_ns() - begin);
+                m_waiting.fetch_sub(1, std::memory_order_relaxed);
+            }
+            m_stats.acquired(false);
+        }
+
+        bool try_lock()
+        {
+            if (!m_mutex.try_lock())
+            {
+                return false;
+            }
+            m_stats.acquired(false);
+            return true;
+        }
+
+        void unlock()
+        {
+            const bool contended = m_waiting.load(std::memory_order_relaxed) != 0;
+            m_mutex.unlock();
+            if (contended)
+            {
+                m_stats.contended_release();
+            }
+        }
+
+        void name(const char * name)
+        {
+            m_stats.name(name);
+        }
+
+    private:
+        std::mutex       m_mutex;
+        std::atomic<int> m_waiting{0};
+        lock_stats       m_stats;
+    };
+
+    // Drop-in for std::shared_mutex; shared and exclusive acquires are
+    // counted separately, waits of both kinds share one histogram.
+    class instrumented_shared_mutex
+    {
+    public:
+        instrumented_shared_mutex() = default;
+
+        instrumented_shared_mutex(const instrumented_shared_mutex &)             = delete;
+        instrumented_shared_mutex & operator=(const instrumented_shared_mutex &) = delete;
+
+        void lock()
+        {
+            if (!m_mutex.try_lock())
+            {
+                m_waiting.fetch_add(1, std::memory_order_relaxed);
+                const int64_t begin = lock_stats::now_ns();
+                m_mutex.lock();
+                m_stats.waited(lock_stats::now_ns() - begin);
+                m_waiting.fetch_sub(1, std::memory_order_relaxed);
+            }
+            m_stats.acquired(false);
+        }
+
+        bool try_lock()
+        {
+            if (!m_mutex.try_lock())
+            {
+                return false;
+            }
+            m_stats.acquired(false);
+            return true;
+        }
+
+        void unlock()
+        {
+            const bool contended = m_waiting.load(std::memory_order_relaxed) != 0;
+            m_mutex.unlock();
+            if (contended)
+            {
+                m_stats.contended_release();
+            }
+        }
+
+        void lock_shared()
+        {
+            if (!m_mutex.try_lock_shared())
+            {
+                m_waiting.fetch_add(1, std::memory_order_relaxed);
+                const int64_t begin = lock_stats::now_ns();
+                m_mutex.lock_shared();
+                m_stats.waited(lock_stats::now_ns() - begin);
+                m_waiting.fetch_sub(1, std::memory_order_relaxed);
+            }
+            m_stats.acquired(true);
+        }
+
+        bool try_lock_shared()
+        {
+            if (!m_mutex.try_lock_shared())
+            {
+                return false;
+            }
+            m_stats.acquired(true);
+            return true;
+        }
+
+        void unlock_shared()
+        {
+            const bool contended = m_waiting.load(std::memory_order_relaxed) != 0;
+            m_mutex.unlock_shared();
+            if (contended)
+            {
+                m_stats.contended_release();
+            }
+        }
+
+        void name(const char * name)
+        {
+            m_stats.name(name);
+        }
+
+    private:
+        std::shared_mutex m_mutex;
+        std::atomic<int>  m_waiting{0};
+        lock_stats        m_stats;
+    };
+
+    // Works with any lockable, at the cost of an internal mutex per wait.
+    using instrumented_condition_variable = std::condition_variable_any;
+
+#else
+
+    using instrumented_mutex              = std::mutex;
+    using instrumented_shared_mutex       = std::shared_mutex;
+    using instrumented_condition_variable = std::condition_variable;
+
+#endif
+
+    // Labels m in the lock report. name must outlive the lock (use a
+    // literal). A no-op when lock statistics are compiled out.
+    template<class M>
+    inline void name_lock(M & m, const char * name)
+    {
+#if MINERVA_LOCK_STATS
+        m.name(name);
+#else
+        (void)m;
+        (void)name;
+#endif
+    }
+
+    // Writes every live instrumented lock, merged by name and sorted by
+    // contended acquires, as JSON. Reports {"enabled": false} when lock
+    // statistics are compiled out.
+    void write_lock_report(std::ostream & os);
+}
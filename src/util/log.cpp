@@ -1,10 +1,16 @@
 #include <unistd.h>
 #include <sys/syscall.h>
-#include <iomanip>
+#include <atomic>
+#include <charconv>
+#include <condition_variable>
+#include <cstring>
 #include <iostream>
 #include <fstream>
+#include <memory>
 #include <mutex>
 #include <system_error>
+#include <thread>
+#include <vector>
 #include "log.h"
 #include "time_utils.h"
 
@@ -12,6 +18,7 @@ namespace minerva
 {
 
     log::LOG_LEVEL log::log_level = log::INFO;
+    std::atomic<unsigned> log::s_site_generation{0};
 
     namespace
     {
@@ -43,6 +50,452 @@ namespace minerva
             static std::mutex m;
             return m;
         }
+
+        void write_sinks(const char* data, size_t len)
+        {
+            {
+                std::lock_guard<std::mutex> lk(cerr_mutex());
+                std::cerr.write(data, len);
+                std::cerr.flush();
+            }
+            console_sink& cs = console();
+            if (cs.out.is_open())
+            {
+                std::lock_guard<std::mutex> lk(cs.mtx);
+                cs.out.write(data, len);
+                cs.out.flush();
+            }
+        }
+
+        // Per-thread cache of the parts of the prefix that rarely change:
+        // the thread id and the local time rendered to the second.
+        struct prefix_cache
+        {
+            pid_t       tid = 0;
+            std::time_t second = -1;
+            char        time[24];
+            size_t      time_len = 0;
+        };
+
+        prefix_cache& thread_prefix()
+        {
+            thread_local prefix_cache cache;
+            return cache;
+        }
+
+        // Appends "YYYY/MM/DD HH:MM:SS (mmmms)".
+        void append_time(std::string& out)
+        {
+            const auto st = log::get_systime();
+            prefix_cache& pc = thread_prefix();
+            if (std::get<0>(st) != pc.second)
+            {
+                std::tm tm = minerva::localtime(std::get<0>(st));
+                pc.time_len = strftime(pc.time, sizeof(pc.time),
+                                       log::time_format_string, &tm);
+                pc.second = std::get<0>(st);
+            }
+            out.append(pc.time, pc.time_len);
+
+            const int ms = std::get<1>(st);
+            char buf[8] = { ' ', '(',
+                            static_cast<char>('0' + ms / 100),
+                            static_cast<char>('0' + ms / 10 % 10),
+                            static_cast<char>('0' + ms % 10),
+                            'm', 's', ')' };
+            out.append(buf, sizeof(buf));
+        }
+
+        template<typename T>
+        void append_int(std::string& out, T v)
+        {
+            char buf[24];
+            auto res = std::to_chars(buf, buf + sizeof(buf), v);
+            out.append(buf, res.ptr - buf);
+        }
+
+        // strerror_r is int-returning (XSI) or char*-returning (GNU)
+        // depending on feature macros; overloads pick the right reading.
+        [[maybe_unused]] const char* strerror_result(int rc, const char* buf)
+        {
+            return rc == 0 ? buf : "Unknown error";
+        }
+
+        [[maybe_unused]] const char* strerror_result(const char* rc, const char*)
+        {
+            return rc;
+        }
+
+        // Per-thread buffer the final line is assembled in.
+        std::string& thread_line()
+        {
+            thread_local std::string line;
+            return line;
+        }
+
+        // Buffers larger than this are released after the record instead
+        // of being kept for the thread's lifetime.
+        constexpr size_t MAX_RETAINED_RECORD = 64 * 1024;
+
+        void release_if_large(std::string& s)
+        {
+            if (s.capacity() > MAX_RETAINED_RECORD)
+            {
+                std::string().swap(s);
+            }
+        }
+
+        /*
+         * Single-producer / single-consumer byte ring owned by one logging
+         * thread and drained by the writer. Lines are copied in whole or
+         * not at all, so the consumer can hand out everything between
+         * tail and head without parsing record boundaries.
+         */
+        class log_ring
+        {
+        public:
+            static constexpr size_t SIZE = 256 * 1024;
+
+            bool push(const char* data, size_t len)
+            {
+                const size_t h = head.load(std::memory_order_relaxed);
+                const size_t t = tail.load(std::memory_order_acquire);
+                if (len > SIZE - (h - t))
+                {
+                    return false;
+                }
+                const size_t off = h % SIZE;
+                const size_t first = std::min(len, SIZE - off);
+                std::memcpy(buf + off, data, first);
+                std::memcpy(buf, data + first, len - first);
+                head.store(h + len, std::memory_order_release);
+                return true;
+            }
+
+            size_t used() const
+            {
+                return head.load(std::memory_order_relaxed) -
+                    tail.load(std::memory_order_acquire);
+            }
+
+            void drain(std::string& out)
+            {
+                const size_t t = tail.load(std::memory_order_relaxed);
+                const size_t h = head.load(std::memory_order_acquire);
+                const size_t len = h - t;
+                if (len == 0)
+                {
+                    return;
+                }
+                const size_t off = t % SIZE;
+                const size_t first = std::min(len, SIZE - off);
+                out.append(buf + off, first);
+                out.append(buf, len - first);
+                tail.store(h, std::memory_order_release);
+            }
+
+            bool empty() const
+            {
+                return head.load(std::memory_order_acquire) ==
+                    tail.load(std::memory_order_relaxed);
+            }
+
+            // Set when the owning thread exits; the writer frees the ring
+            // once it has been drained.
+            std::atomic<bool> orphaned{false};
+
+        private:
+            std::atomic<size_t> head{0};
+            std::atomic<size_t> tail{0};
+            char                buf[SIZE];
+        };
+
+        class async_backend
+        {
+        public:
+            ~async_backend()
+            {
+                stop();
+            }
+
+            void start()
+            {
+                std::lock_guard<std::mutex> lk(m_state_mtx);
+                if (m_writer.joinable())
+                {
+                    return;
+                }
+                m_running = true;
+                m_writer = std::thread([this]() { run(); });
+                m_enabled.store(true, std::memory_order_release);
+            }
+
+            void stop()
+            {
+                std::lock_guard<std::mutex> lk(m_state_mtx);
+                m_enabled.store(false, std::memory_order_release);
+                if (!m_writer.joinable())
+                {
+                    return;
+                }
+                {
+                    std::lock_guard<std::mutex> wl(m_wake_mtx);
+                    m_running = false;
+                }
+                m_wake.notify_all();
+                m_writer.join();
+                drain_all();
+            }
+
+            bool enabled() const
+            {
+                return m_enabled.load(std::memory_order_acquire);
+            }
+
+            // Queue a line from the calling thread. Returns false if the line
+            // must be written synchronously instead (too large for a ring).
+            bool push(const std::string& line)
+            {
+                if (line.size() > log_ring::SIZE / 2)
+                {
+                    return false;
+                }
+                log_ring* ring = thread_ring();
+                if (!ring->push(line.data(), line.size()))
+                {
+                    m_dropped.fetch_add(1, std::memory_order_relaxed);
+                }
+                // Wake the writer early rather than letting a busy thread
+                // run into the drop policy before the next period.
+                if (ring->used() > log_ring::SIZE / 2 &&
+                    !m_wake_pending.exchange(true, std::memory_order_acq_rel))
+                {
+                    m_wake.notify_one();
+                }
+                return true;
+            }
+
+            // Write everything queued so far. Serialized with the writer.
+            void drain_all()
+            {
+                std::lock_guard<std::mutex> lk(m_drain_mtx);
+                m_wake_pending.store(false, std::memory_order_release);
+
+                std::vector<std::shared_ptr<log_ring>> rings;
+                {
+                    std::lock_guard<std::mutex> rl(m_rings_mtx);
+                    rings = m_rings;
+                }
+
+                m_batch.clear();
+                for (auto& r : rings)
+                {
+                    r->drain(m_batch);
+                }
+
+                const unsigned long long dropped =
+                    m_dropped.load(std::memory_order_relaxed);
+                if (dropped != m_reported_drops)
+                {
+                    m_batch.append("WARN log: dropped ");
+                    append_int(m_batch, dropped - m_reported_drops);
+                    m_batch.append(" messages (ring full)\n");
+                    m_reported_drops = dropped;
+                }
+
+                if (!m_batch.empty())
+                {
+                    write_sinks(m_batch.data(), m_batch.size());
+                }
+
+                // Release rings of exited threads once they are empty.
+                std::lock_guard<std::mutex> rl(m_rings_mtx);
+                for (auto it = m_rings.begin(); it != m_rings.end(); )
+                {
+                    if ((*it)->orphaned.load(std::memory_order_acquire) &&
+                        (*it)->empty())
+                    {
+                        it = m_rings.erase(it);
+                    }
+                    else
+                    {
+                        ++it;
+                    }
+                }
+            }
+
+            unsigned long long dropped() const
+            {
+                return m_dropped.load(std::memory_order_relaxed);
+            }
+
+        private:
+            static constexpr std::chrono::milliseconds WRITE_PERIOD{20};
+
+            // Owns the calling thread's ring; marks it orphaned on exit.
+            struct ring_holder
+            {
+                std::shared_ptr<log_ring> ring;
+
+                ~ring_holder()
+                {
+                    if (ring)
+                    {
+                        ring->orphaned.store(true, std::memory_order_release);
+                    }
+                }
+            };
+
+            log_ring* thread_ring()
+            {
+                thread_local ring_holder holder;
+                if (!holder.ring)
+                {
+                    holder.ring = std::make_shared<log_ring>();
+                    std::lock_guard<std::mutex> lk(m_rings_mtx);
+                    m_rings.push_back(holder.ring);
+                }
+                return holder.ring.get();
+            }
+
+            void run()
+            {
+                std::unique_lock<std::mutex> lk(m_wake_mtx);
+                while (m_running)
+                {
+                    m_wake.wait_for(lk, WRITE_PERIOD);
+                    lk.unlock();
+                    drain_all();
+                    lk.lock();
+                }
+            }
+
+            std::atomic<bool>                      m_enabled{false};
+            std::atomic<unsigned long long>        m_dropped{0};
+            std::atomic<bool>                      m_wake_pending{false};
+            unsigned long long                     m_reported_drops = 0;
+            std::mutex                             m_state_mtx;
+            std::mutex                             m_wake_mtx;
+            std::condition_variable                m_wake;
+            bool                                   m_running = false;
+            std::thread                            m_writer;
+            std::mutex                             m_drain_mtx;
+            std::string                            m_batch;
+            std::mutex                             m_rings_mtx;
+            std::vector<std::shared_ptr<log_ring>> m_rings;
+        };
+
+        async_backend& backend()
+        {
+            static async_backend instance;
+            return instance;
+        }
+
+        struct site_rule_entry
+        {
+            std::string file;
+            int         line;
+            bool        enabled;
+        };
+
+        struct site_rules
+        {
+            std::mutex                   mtx;
+            std::vector<site_rule_entry> rules;
+        };
+
+        site_rules& rules()
+        {
+            static site_rules instance;
+            return instance;
+        }
+    }
+
+    struct log_record::slot
+    {
+        // Appends to a std::string that keeps its capacity between records.
+        class buffer : public std::streambuf
+        {
+        public:
+            std::string text;
+
+        protected:
+            int_type overflow(int_type ch) override
+            {
+                if (!traits_type::eq_int_type(ch, traits_type::eof()))
+                {
+                    text.push_back(traits_type::to_char_type(ch));
+                }
+                return traits_type::not_eof(ch);
+            }
+
+            std::streamsize xsputn(const char* s, std::streamsize n) override
+            {
+                text.append(s, static_cast<size_t>(n));
+                return n;
+            }
+        };
+
+        buffer       buf;
+        std::ostream os{&buf};
+
+        // Undo whatever the previous record left behind: text, error
+        // state and manipulators such as std::hex or std::setprecision.
+        void reset()
+        {
+            buf.text.clear();
+            os.clear();
+            os.flags(std::ios_base::skipws | std::ios_base::dec);
+            os.width(0);
+            os.precision(6);
+            os.fill(' ');
+        }
+    };
+
+    namespace
+    {
+        struct record_slots
+        {
+            static constexpr unsigned DEPTH = 4;
+
+            log_record::slot slots[DEPTH];
+            unsigned         depth = 0;
+        };
+
+        thread_local record_slots t_records;
+    }
+
+    log_record::log_record()
+    {
+        record_slots& rs = t_records;
+        m_slot = rs.depth < record_slots::DEPTH ? &rs.slots[rs.depth]
+                                                : new slot;
+        ++rs.depth;
+        m_slot->reset();
+    }
+
+    log_record::~log_record()
+    {
+        record_slots& rs = t_records;
+        --rs.depth;
+        if (rs.depth >= record_slots::DEPTH)
+        {
+            delete m_slot;
+        }
+        else
+        {
+            release_if_large(m_slot->buf.text);
+        }
+    }
+
+    std::ostream& log_record::stream()
+    {
+        return m_slot->os;
+    }
+
+    std::string_view log_record::str() const
+    {
+        return m_slot->buf.text;
     }
 
     void log::set_log_level(log::LOG_LEVEL level)
@@ -52,7 +505,12 @@ namespace minerva
 
     pid_t log::gettid()
     {
-        return syscall(SYS_gettid);
+        prefix_cache& pc = thread_prefix();
+        if (pc.tid == 0)
+        {
+            pc.tid = syscall(SYS_gettid);
+        }
+        return pc.tid;
     }
 
     std::string log::strerror_string(int err)
@@ -73,74 +531,93 @@ namespace minerva
 
     std::string log::format_current_time()
     {
-        const auto st = log::get_systime();
-        std::tm tm = minerva::localtime(std::get<0>(st));
-        std::stringstream ss;
-        ss << std::put_time(&tm, log::time_format_string)
-           << " (" << std::setw(3) << std::setfill('0')
-           << std::get<1>(st) << "ms)";
-        return ss.str();
+        std::string s;
+        append_time(s);
+        return s;
     }
 
-    static std::string format_prefix(const char* level_string,
-                                     const char* pretty_name,
-                                     const char* file_name,
-                                     int line_no)
+    static void format_prefix(std::string& out,
+                              const char* level_string,
+                              const char* pretty_name,
+                              const char* file_name,
+                              int line_no)
     {
-        std::stringstream ss;
-        ss << level_string << ' '
-           << log::format_current_time() << ' '
-           << log::gettid() << ' ';
+        out.append(level_string);
+        out.push_back(' ');
+        append_time(out);
+        out.push_back(' ');
+        append_int(out, log::gettid());
+        out.push_back(' ');
         if (file_name)
         {
-            ss << file_name << ':' << line_no << ' ';
+            out.append(file_name);
+            out.push_back(':');
+            append_int(out, line_no);
+            out.push_back(' ');
         }
-        ss << pretty_name << ": ";
-        return ss.str();
+        out.append(pretty_name);
+        out.append(": ");
     }
 
-    static void emit(const std::string& line)
+    static void emit(const std::string& line, const char* level_string)
     {
+        async_backend& be = backend();
+        if (be.enabled())
         {
-            std::lock_guard<std::mutex> lk(cerr_mutex());
-            std::cerr << line;
-            std::cerr.flush();
-        }
-        console_sink& cs = console();
-        if (cs.out.is_open())
-        {
-            std::lock_guard<std::mutex> lk(cs.mtx);
-            cs.out << line;
-            cs.out.flush();
+            if (level_string != log::FATAL_STRING && be.push(line))
+            {
+                return;
+            }
+            // FATAL (or oversized): drain what is queued so ordering is
+            // kept, then write through.
+            be.drain_all();
         }
+        write_sinks(line.data(), line.size());
     }
 
-    void log::log_message(const std::string& msg,
+    void log::log_message(std::string_view msg,
                           const char* level_string,
                           const char* pretty_name,
                           const char* file_name,
                           const int line_no)
     {
-        emit(format_prefix(level_string, pretty_name, file_name, line_no)
-             + msg + '\n');
+        std::string& line = thread_line();
+        line.clear();
+        format_prefix(line, level_string, pretty_name, file_name, line_no);
+        line.append(msg);
+        line.push_back('\n');
+        emit(line, level_string);
+        release_if_large(line);
     }
 
-    void log::log_errno_message(const std::string& msg,
+    void log::log_errno_message(std::string_view msg,
                                 const char* level_string,
                                 const char* pretty_name,
                                 const char* file_name,
                                 const int line_no,
                                 int err)
     {
-        std::stringstream ss;
-        ss << format_prefix(level_string, pretty_name, file_name, line_no)
-           << msg << " errno=" << err
-           << " (" << log::strerror_string(err) << ")\n";
-        emit(ss.str());
+        std::string& line = thread_line();
+        line.clear();
+        format_prefix(line, level_string, pretty_name, file_name, line_no);
+        line.append(msg);
+        line.append(" errno=");
+        append_int(line, err);
+        line.append(" (");
+        char buf[128];
+        line.append(strerror_result(strerror_r(err, buf, sizeof(buf)), buf));
+        line.append(")\n");
+        emit(line, level_string);
+        release_if_large(line);
     }
 
     void log::flush()
     {
+        async_backend& be = backend();
+        if (be.enabled())
+        {
+            be.drain_all();
+        }
         {
             std::lock_guard<std::mutex> lk(cerr_mutex());
             std::cerr.flush();
@@ -153,4 +630,81 @@ namespace minerva
         }
     }
 
+    void log::set_site_enabled(const std::string& file, int line, bool enabled)
+    {
+        site_rules& sr = rules();
+        std::lock_guard<std::mutex> lk(sr.mtx);
+        sr.rules.push_back({ file, line, enabled });
+        s_site_generation.fetch_add(1, std::memory_order_release);
+    }
+
+    void log::clear_site_rules()
+    {
+        site_rules& sr = rules();
+        std::lock_guard<std::mutex> lk(sr.mtx);
+        sr.rules.clear();
+        s_site_generation.fetch_add(1, std::memory_order_release);
+    }
+
+    bool log::site_rule(const char* file, int line, bool& enabled)
+    {
+        site_rules& sr = rules();
+        std::lock_guard<std::mutex> lk(sr.mtx);
+        for (auto it = sr.rules.rbegin(); it != sr.rules.rend(); ++it)
+        {
+            if ((it->line == 0 || it->line == line) && it->file == file)
+            {
+                enabled = it->enabled;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void log_site::refresh(unsigned gen)
+    {
+        bool enabled = true;
+        log::site_rule(m_file, m_line, enabled);
+        m_enabled.store(enabled, std::memory_order_relaxed);
+        m_generation.store(gen, std::memory_order_relaxed);
+    }
+
+    bool log_site::rate_allow(int interval_ms, unsigned& suppressed)
+    {
+        const long long now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        long long next = m_next_ms.load(std::memory_order_relaxed);
+        if (now < next ||
+            !m_next_ms.compare_exchange_strong(next, now + interval_ms,
+                                               std::memory_order_relaxed))
+        {
+            m_suppressed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        suppressed = m_suppressed.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+    void log::set_async(bool async)
+    {
+        if (async)
+        {
+            backend().start();
+        }
+        else
+        {
+            backend().stop();
+        }
+    }
+
+    bool log::is_async()
+    {
+        return backend().enabled();
+    }
+
+    unsigned long long log::dropped_count()
+    {
+        return backend().dropped();
+    }
+
 }
@@ -2,15 +2,28 @@
 
 #include <stdlib.h>
 #include <sys/types.h>
+#include <atomic>
+#include <ostream>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <chrono>
 #include <tuple>
 #include "file_utils.h"
 
+/*
+ * Statements below this level are compiled out entirely. The build sets
+ * it to INFO for Release/MinSizeRel; 0 (TRACE) keeps everything.
+ */
+#ifndef MINERVA_LOG_MIN_LEVEL
+#define MINERVA_LOG_MIN_LEVEL 0
+#endif
+
 namespace minerva
 {
 
+class log_site;
+
 class log
 {
 public:
@@ -53,13 +66,13 @@ public:
 
     static std::string format_current_time();
 
-    static void log_message(const std::string& msg,
+    static void log_message(std::string_view msg,
                             const char* level_string,
                             const char* pretty_name,
                             const char* file_name,
                             const int line_no);
 
-    static void log_errno_message(const std::string& msg,
+    static void log_errno_message(std::string_view msg,
                                   const char* level_string,
                                   const char* pretty_name,
                                   const char* file_name,
@@ -69,35 +82,180 @@ public:
     /* Flushes all log sinks. Safe to call from a fatal-error handler. */
     static void flush();
 
+    /*
+     * Asynchronous mode. Each logging thread appends pre-formatted lines
+     * to its own lock-free ring; a background writer drains the rings and
+     * hands them to the sinks in large batches. A line that does not fit
+     * in its thread's ring is dropped and counted rather than blocking the
+     * caller. FATAL messages and flush() always drain synchronously.
+     */
+    static void set_async(bool async);
+
+    static bool is_async();
+
+    /* Lines discarded because a thread's ring was full. */
+    static unsigned long long dropped_count();
+
+    /*
+     * Per-call-site switches. A rule matches every statement in the file
+     * with the given short name, or a single statement when line > 0.
+     * Later rules override earlier ones. Sites pick up changes lazily the
+     * next time they pass the level check.
+     */
+    static void set_site_enabled(const std::string& file, int line, bool enabled);
+
+    static void clear_site_rules();
+
+    inline static unsigned site_generation()
+    {
+        return s_site_generation.load(std::memory_order_relaxed);
+    }
+
 private:
+    friend class log_site;
+
+    static bool site_rule(const char* file, int line, bool& enabled);
+
     static LOG_LEVEL log_level;
+    static std::atomic<unsigned> s_site_generation;
+};
+
+/*
+ * State of one LOG statement. Instances are function-local statics with
+ * a constexpr constructor, so they are constant-initialized and cost no
+ * guard check on the hot path.
+ */
+class log_site
+{
+public:
+    constexpr log_site(const char* file, int line)
+        : m_file(file), m_line(line)
+    {
+    }
+
+    inline bool enabled()
+    {
+        const unsigned gen = log::site_generation();
+        if (m_generation.load(std::memory_order_relaxed) != gen)
+        {
+            refresh(gen);
+        }
+        return m_enabled.load(std::memory_order_relaxed);
+    }
+
+    /*
+     * Allows at most one message per interval. When a message is allowed,
+     * suppressed receives the number of messages dropped since the last one.
+     */
+    bool rate_allow(int interval_ms, unsigned& suppressed);
+
+private:
+    void refresh(unsigned gen);
+
+    const char*               m_file;
+    int                       m_line;
+    std::atomic<unsigned>     m_generation{0};
+    std::atomic<bool>         m_enabled{true};
+    std::atomic<long long>    m_next_ms{0};
+    std::atomic<unsigned>     m_suppressed{0};
+};
+
+/*
+ * Formats the message of one LOG statement. The stream and its buffer
+ * belong to the calling thread and are reused from record to record, so
+ * a statement that gets past its checks allocates only while the buffer
+ * grows to the thread's longest message. Records nest (an argument's
+ * operator<< may log) up to a few levels before falling back to a
+ * buffer of their own.
+ */
+class log_record
+{
+public:
+    log_record();
+    ~log_record();
+
+    log_record(const log_record&) = delete;
+    log_record& operator=(const log_record&) = delete;
+
+    std::ostream& stream();
+
+    std::string_view str() const;
+
+    struct slot;
+
+private:
+    slot* m_slot;
 };
 
 }
 
+#define MINERVA_LOG_ENABLED(level)                                      \
+    ((level) >= MINERVA_LOG_MIN_LEVEL &&                                \
+     (level) >= minerva::log::get_log_level())
+
 #define LOG(level, level_string, filename, line, args)                  \
     do                                                                  \
     {                                                                   \
-        if (level >= minerva::log::get_log_level())                     \
+        if (MINERVA_LOG_ENABLED(level))                                 \
         {                                                               \
-            std::stringstream _mlog_ss_;                                \
-            _mlog_ss_ << args;                                          \
-            minerva::log::log_message(_mlog_ss_.str(),                  \
-                                      level_string, __func__,           \
-                                      filename, line);                  \
+            static constexpr const char* _mlog_file_ = filename;        \
+            static minerva::log_site _mlog_site_(_mlog_file_, line);    \
+            if (_mlog_site_.enabled())                                  \
+            {                                                           \
+                minerva::log_record _mlog_rec_;                         \
+                _mlog_rec_.stream() << args;                            \
+                minerva::log::log_message(_mlog_rec_.str(),             \
+                                          level_string, __func__,       \
+                                          _mlog_file_, line);           \
+            }                                                           \
         }                                                               \
     } while (0)
 
 #define LOG_ERRNO(level, level_string, filename, line, args, err)       \
     do                                                                  \
     {                                                                   \
-        if (level >= minerva::log::get_log_level())                     \
+        if (MINERVA_LOG_ENABLED(level))                                 \
+        {                                                               \
+            static constexpr const char* _mlog_file_ = filename;        \
+            static minerva::log_site _mlog_site_(_mlog_file_, line);    \
+            if (_mlog_site_.enabled())                                  \
+            {                                                           \
+                minerva::log_record _mlog_rec_;                         \
+                _mlog_rec_.stream() << args;                            \
+                minerva::log::log_errno_message(_mlog_rec_.str(),       \
+                                                level_string,           \
+                                                __func__, _mlog_file_,  \
+                                                line, err);             \
+            }                                                           \
+        }                                                               \
+    } while (0)
+
+/*
+ * Emits at most one message per interval_ms from this statement; the
+ * next message that gets through reports how many were suppressed.
+ */
+#define LOG_RATELIMITED(level, level_string, filename, line, interval_ms, args) \
+    do                                                                  \
+    {                                                                   \
+        if (MINERVA_LOG_ENABLED(level))                                 \
         {                                                               \
-            std::stringstream _mlog_ss_;                                \
-            _mlog_ss_ << args;                                          \
-            minerva::log::log_errno_message(_mlog_ss_.str(),            \
-                                            level_string, __func__,     \
-                                            filename, line, err);       \
+            static constexpr const char* _mlog_file_ = filename;        \
+            static minerva::log_site _mlog_site_(_mlog_file_, line);    \
+            unsigned _mlog_suppressed_ = 0;                             \
+            if (_mlog_site_.enabled() &&                                \
+                _mlog_site_.rate_allow(interval_ms, _mlog_suppressed_)) \
+            {                                                           \
+                minerva::log_record _mlog_rec_;                         \
+                _mlog_rec_.stream() << args;                            \
+                if (_mlog_suppressed_ > 0)                              \
+                {                                                       \
+                    _mlog_rec_.stream() << " (" << _mlog_suppressed_    \
+                              << " similar messages suppressed)";       \
+                }                                                       \
+                minerva::log::log_message(_mlog_rec_.str(),             \
+                                          level_string, __func__,       \
+                                          _mlog_file_, line);           \
+            }                                                           \
         }                                                               \
     } while (0)
 
@@ -137,6 +295,22 @@ private:
 #define LOG_FATAL_ERRNO(args, err)                                      \
     LOG_ERRNO(minerva::log::FATAL, minerva::log::FATAL_STRING, __SHORT_FILE__, __LINE__, args, err)
 
+#define LOG_DEBUG_RATELIMITED(interval_ms, args)                       \
+    LOG_RATELIMITED(minerva::log::DEBUG, minerva::log::DEBUG_STRING,    \
+                    __SHORT_FILE__, __LINE__, interval_ms, args)
+
+#define LOG_INFO_RATELIMITED(interval_ms, args)                        \
+    LOG_RATELIMITED(minerva::log::INFO, minerva::log::INFO_STRING,      \
+                    __SHORT_FILE__, __LINE__, interval_ms, args)
+
+#define LOG_WARN_RATELIMITED(interval_ms, args)                        \
+    LOG_RATELIMITED(minerva::log::WARN, minerva::log::WARN_STRING,      \
+                    __SHORT_FILE__, __LINE__, interval_ms, args)
+
+#define LOG_ERROR_RATELIMITED(interval_ms, args)                       \
+    LOG_RATELIMITED(minerva::log::ERROR, minerva::log::ERROR_STRING,    \
+                    __SHORT_FILE__, __LINE__, interval_ms, args)
+
 #define FATAL(args)                                                     \
     do                                                                  \
     {                                                                   \
@@ -186,6 +186,29 @@ namespace minerva
         return m_impl && m_impl->ostream ? *m_impl->ostream : null_stream;
     }
 
+    bool safe_ofstream::preallocate(off_t length)
+    {
+        if (m_fd < 0 || length <= 0)
+        {
+            return false;
+        }
+        if (::fallocate(m_fd, FALLOC_FL_KEEP_SIZE, 0, length) != 0)
+        {
+            if (errno == EOPNOTSUPP || errno == ENOSYS)
+            {
+                LOG_DEBUG("safe_ofstream: fallocate unsupported for "
+                          << m_fakepath);
+            }
+            else
+            {
+                LOG_WARN_ERRNO("safe_ofstream: fallocate(" << m_fakepath
+                               << ", " << length << ") failed", errno);
+            }
+            return false;
+        }
+        return true;
+    }
+
     bool safe_ofstream::fail() const
     {
         return !m_impl || !m_impl->ostream || m_impl->ostream->fail();
@@ -3,6 +3,7 @@
 #include <iosfwd>
 #include <memory>
 #include <string>
+#include <sys/types.h>
 
 namespace minerva
 {
@@ -62,6 +63,21 @@ namespace minerva
 
         std::ostream& stream();
 
+        /**
+         * Raw descriptor of the temp file, for writers that bypass the
+         * ostream (e.g. splice(2)). Do not mix with stream() writes without
+         * flushing it first; commit() fsync's the data either way. Returns
+         * -1 once committed or closed.
+         */
+        int native_handle() const { return m_fd; }
+
+        /**
+         * Reserve disk space for @p length bytes up front with fallocate(2),
+         * without changing the file size. Returns false if the filesystem
+         * does not support it or the space is unavailable.
+         */
+        bool preallocate(off_t length);
+
     private:
         void cleanup_temp() noexcept;
 
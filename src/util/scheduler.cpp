@@ -80,9 +80,13 @@ namespace minerva
                 next = jobs.begin()->first;
             }
 
+            // A job scheduled ahead of 'next' while we sleep must also wake
+            // us, otherwise it would wait for the old deadline; returning
+            // with nothing due makes run() recompute the deadline.
             cond.wait_until(lk, next, [&] {
                 return should_shutdown.load() ||
-                       (!jobs.empty() && jobs.begin()->first <= clock::now());
+                       (!jobs.empty() && (jobs.begin()->first <= clock::now() ||
+                                          jobs.begin()->first < next));
             });
 
             if (should_shutdown.load())
@@ -96,6 +100,8 @@ namespace minerva
             for (auto it = jobs.begin();
                  it != jobs.end() && it->first <= cutoff; )
             {
+                m_lag.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                                 cutoff - it->first).count());
                 batch.emplace_back(std::move(it->second->job));
                 it = jobs.erase(it);
             }
@@ -9,6 +9,7 @@
 #include <functional>
 #include <atomic>
 #include "thread_pool.h"
+#include "histogram.h"
 
 namespace minerva
 {
@@ -49,6 +50,7 @@ namespace minerva
         thread_pool                  tp;
         std::atomic<bool>            should_shutdown{false};
         std::atomic<state_t>         state{STOPPED};
+        latency_histogram            m_lag;
 
         void run();
         void run_jobs(std::vector<job_element>& batch);
@@ -84,6 +86,13 @@ namespace minerva
 
         bool cancel_job(const job_handle& handle);
 
+        // How late jobs were dispatched relative to their due time, in
+        // microseconds.
+        const latency_histogram& lag() const
+        {
+            return m_lag;
+        }
+
         void start();
         void stop();
         void wait();
@@ -37,6 +37,11 @@ namespace minerva
 
         bool pending() const override;
 
+        bool is_secure() const override
+        {
+            return true;
+        }
+
     private:
         static SSL_CTX *m_ssl_ctx;
         SSL *m_ssl;
@@ -8,6 +8,7 @@
 #include <cstdlib>
 #include <limits>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace minerva
@@ -251,7 +252,7 @@ namespace minerva
                s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
     }
 
-    inline bool ci_equals(const std::string& s1, const std::string& s2) noexcept
+    inline bool ci_equals(std::string_view s1, std::string_view s2) noexcept
     {
         return s1.size() == s2.size() &&
                std::equal(s1.begin(), s1.end(), s2.begin(),
@@ -0,0 +1,69 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include "symbols.h"
+
+namespace minerva
+{
+    namespace
+    {
+        // Drops the parameter list (and cv-qualifiers) from a demangled
+        // name; frames are wide enough with templates alone.
+        void strip_parameters(std::string & name)
+        {
+            size_t end = name.find_last_of(')');
+            if (end == std::string::npos)
+            {
+                return;
+            }
+            int depth = 0;
+            for (size_t i = end + 1; i-- > 0;)
+            {
+                if (name[i] == ')')
+                {
+                    ++depth;
+                }
+                else if (name[i] == '(' && --depth == 0)
+                {
+                    if (i > 0)
+                    {
+                        name.resize(i);
+                    }
+                    return;
+                }
+            }
+        }
+    }
+
+    std::string symbol_name(const void * pc, bool return_address)
+    {
+        const auto addr = reinterpret_cast<uintptr_t>(pc) - (return_address ? 1 : 0);
+        Dl_info info;
+        if (dladdr(reinterpret_cast<void *>(addr), &info) == 0)
+        {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "0x%lx", static_cast<unsigned long>(addr));
+            return buf;
+        }
+        if (info.dli_sname)
+        {
+            int status = 0;
+            char * demangled = abi::__cxa_demangle(info.dli_sname, nullptr,
+                                                   nullptr, &status);
+            std::string name = status == 0 && demangled ? demangled
+                                                        : info.dli_sname;
+            free(demangled);
+            strip_parameters(name);
+            return name;
+        }
+        const char * module = info.dli_fname ? info.dli_fname : "?";
+        const char * slash = strrchr(module, '/');
+        char buf[32];
+        snprintf(buf, sizeof(buf), "+0x%lx", static_cast<unsigned long>(
+                     addr - reinterpret_cast<uintptr_t>(info.dli_fbase)));
+        return std::string(slash ? slash + 1 : module) + buf;
+    }
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <string>
+
+namespace minerva
+{
+    /**
+     * Name of the function containing pc, demangled and without its
+     * parameter list, or "module+0xoffset" when the symbol is not exported
+     * (link with ENABLE_EXPORTS to name functions in the executable).
+     *
+     * Pass return_address = true for addresses taken from a backtrace other
+     * than the innermost frame: they point just past the call and are
+     * looked up at pc - 1. Not async-signal-safe.
+     */
+    std::string symbol_name(const void * pc, bool return_address);
+}
@@ -7,6 +7,7 @@ namespace minerva
     thread_pool::thread_pool(int count)
         : thread_count(count)
     {
+        name_lock(work_mutex, "thread_pool.work");
         if (count <= 0)
         {
             throw std::invalid_argument("Thread pool size must be positive");
@@ -25,7 +26,7 @@ namespace minerva
         {
             work_element work;
             {
-                std::unique_lock<std::mutex> lock(work_mutex);
+                std::unique_lock<instrumented_mutex> lock(work_mutex);
                 work_condition.wait(lock, [this] {
                     return should_shutdown.load() || !work_items.empty();
                 });
@@ -118,7 +119,7 @@ namespace minerva
 
     bool thread_pool::queue_work_item(work_element work)
     {
-        std::lock_guard<std::mutex> lock(work_mutex);
+        std::lock_guard<instrumented_mutex> lock(work_mutex);
         if (state.load() != RUNNING || should_shutdown.load())
         {
             return false;
@@ -157,7 +158,7 @@ namespace minerva
 
     size_t thread_pool::get_queue_size() const
     {
-        std::lock_guard<std::mutex> lock(work_mutex);
+        std::lock_guard<instrumented_mutex> lock(work_mutex);
         return work_items.size();
     }
 }
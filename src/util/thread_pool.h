@@ -10,6 +10,7 @@
 #include <thread>
 #include <type_traits>
 #include <vector>
+#include "instrumented_mutex.h"
 
 namespace minerva
 {
@@ -88,8 +89,8 @@ namespace minerva
         std::queue<work_element>  work_items;
         std::vector<std::thread>  threads;
 
-        mutable std::mutex        work_mutex;
-        std::condition_variable   work_condition;
+        mutable instrumented_mutex      work_mutex;
+        instrumented_condition_variable work_condition;
 
         void worker_thread();
     };
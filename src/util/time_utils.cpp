@@ -39,6 +39,90 @@ namespace minerva
         return tm;
     }
 
+    http_date::slot               http_date::s_slots[http_date::SLOTS];
+    std::atomic<size_t>           http_date::s_current{0};
+    std::atomic<std::time_t>      http_date::s_second{-1};
+
+    namespace
+    {
+        // Render the initial value before anything can call now().
+        struct http_date_init
+        {
+            http_date_init()
+            {
+                http_date::refresh();
+            }
+        } s_http_date_init;
+
+        inline char * put2(char * p, int v)
+        {
+            *p++ = static_cast<char>('0' + v / 10);
+            *p++ = static_cast<char>('0' + v % 10);
+            return p;
+        }
+    }
+
+    std::string_view http_date::format(std::time_t time, char * buf)
+    {
+        static const char days[7][4] = {
+            "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"
+        };
+        static const char months[12][4] = {
+            "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+            "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+        };
+
+        std::tm tm = minerva::gmtime(time);
+        int year = tm.tm_year + 1900;
+
+        char * p = buf;
+        std::memcpy(p, days[tm.tm_wday % 7], 3);
+        p += 3;
+        *p++ = ',';
+        *p++ = ' ';
+        p = put2(p, tm.tm_mday);
+        *p++ = ' ';
+        std::memcpy(p, months[tm.tm_mon % 12], 3);
+        p += 3;
+        *p++ = ' ';
+        p = put2(p, (year / 100) % 100);
+        p = put2(p, year % 100);
+        *p++ = ' ';
+        p = put2(p, tm.tm_hour);
+        *p++ = ':';
+        p = put2(p, tm.tm_min);
+        *p++ = ':';
+        p = put2(p, tm.tm_sec);
+        std::memcpy(p, " GMT", 4);
+        p += 4;
+        return std::string_view(buf, p - buf);
+    }
+
+    std::string_view http_date::now()
+    {
+        const slot & s = s_slots[s_current.load(std::memory_order_acquire)];
+        return std::string_view(s.text, LENGTH);
+    }
+
+    void http_date::refresh()
+    {
+        // Not time(): it reads the coarse clock, which can still report the
+        // previous second just after a boundary.
+        std::time_t t = std::chrono::system_clock::to_time_t(
+            std::chrono::system_clock::now());
+        std::time_t last = s_second.load(std::memory_order_relaxed);
+        // Only one caller renders a given second.
+        if (t == last ||
+            !s_second.compare_exchange_strong(last, t,
+                                              std::memory_order_relaxed))
+        {
+            return;
+        }
+        size_t next = (s_current.load(std::memory_order_relaxed) + 1) % SLOTS;
+        format(t, s_slots[next].text);
+        s_current.store(next, std::memory_order_release);
+    }
+
     timer::timer()
         : start_time(get_time_now()), m_is_running(true)
     {
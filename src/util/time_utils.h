@@ -1,8 +1,10 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <ctime>
 #include <string>
+#include <string_view>
 
 namespace minerva
 {
@@ -16,6 +18,42 @@ namespace minerva
     std::tm     localtime(const std::time_t& time);
     std::tm     gmtime(const std::time_t& time);
 
+    /**
+     * Process-wide cache of the wall-clock time rendered as an HTTP
+     * IMF-fixdate ("Sun, 06 Nov 1994 08:49:37 GMT").
+     *
+     * refresh() re-renders the value when the second has changed and is
+     * meant to be driven from a timer; now() is a lock-free read of the
+     * last rendered value. Values rotate through a ring of slots, so a
+     * view returned by now() stays intact for about a minute of refreshes,
+     * which is ample time to copy it.
+     */
+    class http_date
+    {
+    public:
+        static constexpr size_t LENGTH = 29;
+
+        static std::string_view now();
+
+        static void refresh();
+
+        // Render any time_t (e.g. for Last-Modified / Expires) into buf,
+        // which must hold at least LENGTH bytes. Locale independent.
+        static std::string_view format(std::time_t time, char * buf);
+
+    private:
+        static constexpr size_t SLOTS = 64;
+
+        struct slot
+        {
+            char text[32];
+        };
+
+        static slot               s_slots[SLOTS];
+        static std::atomic<size_t> s_current;
+        static std::atomic<std::time_t> s_second;
+    };
+
     /**
      * Steady-clock stopwatch.
      *
@@ -27,6 +27,7 @@ component_visor & kv()
 
 static std::string config_file;
 static std::mutex hup_mutex;
+static auth_db * web_auth_db = nullptr;
 
 #define WWW_VERSION "1.0.0.55"
 
@@ -101,6 +102,12 @@ static void hup_handler(int signal)
             ws->add_listener(httpd::PROTOCOL::HTTPS, port);
         }
         
+        // A failed reload keeps the current users.
+        if (web_auth_db && !web_auth_db->initialize())
+        {
+            LOG_ERROR("failed to reload the auth db");
+        }
+
         kv().hup();
     });
     t.detach();
@@ -201,6 +208,7 @@ int main(int argc, char** argv)
             FATAL("failed to initialize auth db");
         }
         k1->auth_db(adb);
+        web_auth_db = adb;
     }
 
     k2->require_authorization(false);
@@ -247,6 +255,10 @@ int main(int argc, char** argv)
 
     if (adb)
     {
+        {
+            std::unique_lock<std::mutex> lk(hup_mutex);
+            web_auth_db = nullptr;
+        }
         delete(adb);
     }
 